@@ -41,6 +41,7 @@ void coap_end_block1_stream(lwm2m_block1_data_t ** pBlock1Data,
     {
         lwm2m_free(block1Data->block1buffer);
     }
+    lwm2m_free(block1Data->recordsBuffer);
 
     if (block1Data != NULL)
     {
@@ -111,6 +112,8 @@ uint8_t coap_block1_stream_handler(lwm2m_block1_data_t ** pBlock1Data,
             if ((message->mid > block1Data->lastmid) && (message->mid != 0))
             {
                 lwm2m_free(block1Data->block1buffer);
+                lwm2m_free(block1Data->recordsBuffer);
+                memset(block1Data, 0, sizeof(lwm2m_block1_data_t));
             }
             else
             {
@@ -138,6 +141,7 @@ uint8_t coap_block1_stream_handler(lwm2m_block1_data_t ** pBlock1Data,
 
                return COAP_500_INTERNAL_SERVER_ERROR;
             }
+            memset(block1Data, 0, sizeof(lwm2m_block1_data_t));
         }
 
         block1Data->block1buffer = lwm2m_malloc(MAX_BLOCK1_SIZE);
@@ -65,6 +65,7 @@ uint8_t coap_block1_handler(lwm2m_block1_data_t ** pBlock1Data,
        if (block1Data != NULL)
        {
            lwm2m_free(block1Data->block1buffer);
+           lwm2m_free(block1Data->recordsBuffer);
        }
        else
        {
@@ -72,6 +73,7 @@ uint8_t coap_block1_handler(lwm2m_block1_data_t ** pBlock1Data,
            *pBlock1Data = block1Data;
            if (NULL == block1Data) return COAP_500_INTERNAL_SERVER_ERROR;
        }
+       memset(block1Data, 0, sizeof(lwm2m_block1_data_t));
 
        block1Data->block1buffer = lwm2m_malloc(length);
        block1Data->block1bufferSize = length;
@@ -136,12 +138,188 @@ uint8_t coap_block1_handler(lwm2m_block1_data_t ** pBlock1Data,
     }
 }
 
+// Keep the start of the record split over blocks, room is made for all of it once its header is complete
+static uint8_t prv_keepRecord(lwm2m_block1_data_t * block1Data,
+                              uint8_t * buffer,
+                              size_t length,
+                              size_t recordSize)
+{
+    // is it too large?
+    if (recordSize >= COAP_BLOCK1_SIZE) return COAP_413_ENTITY_TOO_LARGE;
+
+    block1Data->block1buffer = lwm2m_malloc(recordSize != 0 ? recordSize : length);
+    if (NULL == block1Data->block1buffer) return COAP_500_INTERNAL_SERVER_ERROR;
+    memcpy(block1Data->block1buffer, buffer, length);
+    block1Data->block1bufferSize = length;
+    block1Data->recordSize = recordSize;
+
+    return NO_ERROR;
+}
+
+uint8_t coap_block1_tlv_handler(lwm2m_block1_data_t ** pBlock1Data,
+                                uint16_t mid,
+                                uint8_t * buffer,
+                                size_t length,
+                                uint16_t blockSize,
+                                uint32_t blockNum,
+                                bool blockMore,
+                                uint8_t ** outputBuffer,
+                                size_t * outputLength)
+{
+    lwm2m_block1_data_t * block1Data = *pBlock1Data;
+    uint8_t * mergedP = NULL;
+    uint8_t * recordP = NULL;
+    size_t recordSize = 0;
+    size_t used = 0;
+    size_t complete;
+    size_t nextSize;
+
+    *outputLength = 0;
+
+    // manage new block1 transfer
+    if (blockNum == 0)
+    {
+        // we already have block1 data for this server, clear it
+        if (block1Data != NULL)
+        {
+            lwm2m_free(block1Data->block1buffer);
+            lwm2m_free(block1Data->recordsBuffer);
+        }
+        else
+        {
+            block1Data = lwm2m_malloc(sizeof(lwm2m_block1_data_t));
+            *pBlock1Data = block1Data;
+            if (NULL == block1Data) return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        memset(block1Data, 0, sizeof(lwm2m_block1_data_t));
+    }
+    // manage already started block1 transfer
+    else
+    {
+        if (block1Data == NULL)
+        {
+            // we never receive the first block
+            return COAP_408_REQ_ENTITY_INCOMPLETE;
+        }
+
+        // If this is a retransmission or a late duplicate of an earlier block,
+        // its records were already handled.
+        if (block1Data->lastmid == mid
+         || block1Data->receivedSize > (size_t)blockSize * blockNum)
+        {
+            return blockMore ? COAP_231_CONTINUE : COAP_204_CHANGED;
+        }
+
+        if (block1Data->receivedSize != (size_t)blockSize * blockNum)
+        {
+            // we don't receive block in right order
+            return COAP_408_REQ_ENTITY_INCOMPLETE;
+        }
+
+        // the records of the previous block were handled
+        lwm2m_free(block1Data->recordsBuffer);
+        block1Data->recordsBuffer = NULL;
+    }
+    block1Data->lastmid = mid;
+    block1Data->receivedSize += length;
+
+    if (block1Data->block1bufferSize != 0 && block1Data->recordSize == 0)
+    {
+        // the header of the pending record is split, decode it along with this block
+        mergedP = lwm2m_malloc(block1Data->block1bufferSize + length);
+        if (NULL == mergedP) return COAP_500_INTERNAL_SERVER_ERROR;
+        memcpy(mergedP, block1Data->block1buffer, block1Data->block1bufferSize);
+        memcpy(mergedP + block1Data->block1bufferSize, buffer, length);
+        buffer = mergedP;
+        length += block1Data->block1bufferSize;
+
+        lwm2m_free(block1Data->block1buffer);
+        block1Data->block1buffer = NULL;
+        block1Data->block1bufferSize = 0;
+    }
+    else if (block1Data->block1bufferSize != 0)
+    {
+        // complete the pending record
+        used = block1Data->recordSize - block1Data->block1bufferSize;
+        if (used > length) used = length;
+        memcpy(block1Data->block1buffer + block1Data->block1bufferSize, buffer, used);
+        block1Data->block1bufferSize += used;
+        if (block1Data->block1bufferSize < block1Data->recordSize)
+        {
+            return blockMore ? COAP_231_CONTINUE : COAP_400_BAD_REQUEST;
+        }
+
+        recordP = block1Data->block1buffer;
+        recordSize = block1Data->recordSize;
+        block1Data->block1buffer = NULL;
+        block1Data->block1bufferSize = 0;
+        block1Data->recordSize = 0;
+    }
+
+    complete = tlv_getCompleteLength(buffer + used, length - used, &nextSize);
+
+    if (used + complete < length)
+    {
+        uint8_t result;
+
+        // the last record of the payload is truncated
+        if (!blockMore) result = COAP_400_BAD_REQUEST;
+        else result = prv_keepRecord(block1Data, buffer + used + complete, length - used - complete, nextSize);
+
+        if (result != NO_ERROR)
+        {
+            lwm2m_free(mergedP);
+            lwm2m_free(recordP);
+            return result;
+        }
+    }
+
+    if (recordP != NULL && complete != 0)
+    {
+        block1Data->recordsBuffer = lwm2m_malloc(recordSize + complete);
+        if (NULL == block1Data->recordsBuffer)
+        {
+            lwm2m_free(recordP);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        memcpy(block1Data->recordsBuffer, recordP, recordSize);
+        memcpy(block1Data->recordsBuffer + recordSize, buffer + used, complete);
+        lwm2m_free(recordP);
+
+        *outputBuffer = block1Data->recordsBuffer;
+        *outputLength = recordSize + complete;
+    }
+    else if (recordP != NULL)
+    {
+        block1Data->recordsBuffer = recordP;
+
+        *outputBuffer = recordP;
+        *outputLength = recordSize;
+    }
+    else
+    {
+        // the records are handled in place, unless the block had to be merged
+        block1Data->recordsBuffer = mergedP;
+
+        *outputBuffer = buffer;
+        *outputLength = complete;
+    }
+
+    if (*outputLength == 0)
+    {
+        return blockMore ? COAP_231_CONTINUE : COAP_204_CHANGED;
+    }
+
+    return NO_ERROR;
+}
+
 void free_block1_buffer(lwm2m_block1_data_t * block1Data)
 {
     if (block1Data != NULL)
     {
         // free block1 buffer
         lwm2m_free(block1Data->block1buffer);
+        lwm2m_free(block1Data->recordsBuffer);
         block1Data->block1bufferSize = 0 ;
 
         // free current element
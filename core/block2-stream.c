@@ -16,27 +16,16 @@
 #include <lwm2mcore/lwm2mcore.h>
 #include <internalCoapHandler.h>
 
-#define MAX_BLOCK2_SIZE 1024
-
-typedef struct
+void coap_end_block2_stream(lwm2m_context_t * contextP)
 {
-    coap_packet_t response;
-    uint8_t payload[MAX_BLOCK2_SIZE];
-    uint32_t payload_len;
-    uint32_t expBlock2Num;
-    uint16_t lastBlock2Mid;
-}block2_context_t;
-
-static block2_context_t blk2_ctxt;
-
-void coap_end_block2_stream()
-{
-    memset(&blk2_ctxt, 0, sizeof(block2_context_t));
+    memset(&contextP->packetStateP->block2State, 0, sizeof(block2_context_t));
 }
 
-coap_status_t coap_block2_stream_handler(coap_packet_t* message,
+coap_status_t coap_block2_stream_handler(lwm2m_context_t * contextP,
+                                         coap_packet_t* message,
                                          coap_packet_t* response)
 {
+    block2_context_t * blk2_ctxtP = &contextP->packetStateP->block2State;
     uint16_t blockSize;
     uint32_t blockNum;
     bool blockMore;
@@ -56,7 +45,7 @@ coap_status_t coap_block2_stream_handler(coap_packet_t* message,
     {
         case COAP_408_REQ_ENTITY_INCOMPLETE:
         case COAP_413_ENTITY_TOO_LARGE:
-            coap_end_block2_stream();
+            coap_end_block2_stream(contextP);
             lwm2mcore_CallCoapExternalHandler(message, LWM2MCORE_TX_STREAM_ERROR);
             rc = COAP_IGNORE;
             break;
@@ -68,19 +57,19 @@ coap_status_t coap_block2_stream_handler(coap_packet_t* message,
             {
                 LOG_ARG("Unexpected block size %d, expected block size %d", blockSize, MAX_BLOCK2_SIZE);
                 lwm2mcore_CallCoapExternalHandler(message, LWM2MCORE_TX_STREAM_ERROR);
-                coap_end_block2_stream();
+                coap_end_block2_stream(contextP);
                 return (coap_status_t)COAP_500_INTERNAL_SERVER_ERROR;
             }
 
             // Check if this is a retransmission request
             // If the current mid is equal to the last block2 mid, retransmit the saved block.
             // We are not supposed to receive any message id's that are older than current mid.
-            if ((message->mid <= blk2_ctxt.lastBlock2Mid) && (message->mid != 0))
+            if ((message->mid <= blk2_ctxtP->lastBlock2Mid) && (message->mid != 0))
             {
                 LOG_ARG("Retransmission for block number %d", blockNum);
 
-                memcpy(response, &blk2_ctxt.response, sizeof(coap_packet_t));
-                coap_set_payload(response, blk2_ctxt.payload, MIN(blk2_ctxt.payload_len, MAX_BLOCK2_SIZE));
+                memcpy(response, &blk2_ctxtP->response, sizeof(coap_packet_t));
+                coap_set_payload(response, blk2_ctxtP->payload, MIN(blk2_ctxtP->payload_len, MAX_BLOCK2_SIZE));
 
                 LOG_ARG("Response code = %d", response->code);
                 LOG_ARG("Payload length = %d", response->payload_len);
@@ -92,21 +81,21 @@ coap_status_t coap_block2_stream_handler(coap_packet_t* message,
 
                 return (coap_status_t)response->code;
             }
-            else if (blockNum != blk2_ctxt.expBlock2Num)
+            else if (blockNum != blk2_ctxtP->expBlock2Num)
             {
-                LOG_ARG("Unexpected block number %d, expected block num %d", blockNum, blk2_ctxt.expBlock2Num);
+                LOG_ARG("Unexpected block number %d, expected block num %d", blockNum, blk2_ctxtP->expBlock2Num);
                 lwm2mcore_CallCoapExternalHandler(message, LWM2MCORE_TX_STREAM_ERROR);
-                coap_end_block2_stream();
+                coap_end_block2_stream(contextP);
                 return (coap_status_t)COAP_500_INTERNAL_SERVER_ERROR;
             }
 
-            blk2_ctxt.lastBlock2Mid = message->mid;
+            blk2_ctxtP->lastBlock2Mid = message->mid;
             rc = lwm2mcore_CallCoapExternalHandler(message, LWM2MCORE_TX_STREAM_IN_PROGRESS);
             break;
 
         default:
             LOG_ARG("Unexpected coap message code %d", message->code);
-            coap_end_block2_stream();
+            coap_end_block2_stream(contextP);
             rc = COAP_500_INTERNAL_SERVER_ERROR;
             break;
     }
@@ -114,29 +103,32 @@ coap_status_t coap_block2_stream_handler(coap_packet_t* message,
     return (coap_status_t)rc;
 }
 
-void coap_block2_handle_response(coap_packet_t* response,
+void coap_block2_handle_response(lwm2m_context_t * contextP,
+                                 coap_packet_t* response,
                                  lwm2mcore_StreamStatus_t streamStatus)
 {
+    block2_context_t * blk2_ctxtP = &contextP->packetStateP->block2State;
+
     /* initiate block transfer for a bigger block */
     if (streamStatus == LWM2MCORE_TX_STREAM_START)
     {
-        blk2_ctxt.expBlock2Num = 0;
+        blk2_ctxtP->expBlock2Num = 0;
         LOG_ARG("Initiate Blockwise transfer with block_size %u", REST_MAX_CHUNK_SIZE);
-        coap_set_header_block2(response, blk2_ctxt.expBlock2Num++, 1, REST_MAX_CHUNK_SIZE);
+        coap_set_header_block2(response, blk2_ctxtP->expBlock2Num++, 1, REST_MAX_CHUNK_SIZE);
     }
     else if (streamStatus == LWM2MCORE_TX_STREAM_IN_PROGRESS)
     {
-        coap_set_header_block2(response, blk2_ctxt.expBlock2Num++, 1, REST_MAX_CHUNK_SIZE);
+        coap_set_header_block2(response, blk2_ctxtP->expBlock2Num++, 1, REST_MAX_CHUNK_SIZE);
     }
     else if (streamStatus == LWM2MCORE_TX_STREAM_END)
     {
-        coap_set_header_block2(response, blk2_ctxt.expBlock2Num++, 0, REST_MAX_CHUNK_SIZE);
+        coap_set_header_block2(response, blk2_ctxtP->expBlock2Num++, 0, REST_MAX_CHUNK_SIZE);
     }
 
     /* save last block */
-    memcpy(&blk2_ctxt.response, response, sizeof(coap_packet_t));
-    memcpy(blk2_ctxt.payload, response->payload, response->payload_len);
-    blk2_ctxt.payload_len = response->payload_len;
+    memcpy(&blk2_ctxtP->response, response, sizeof(coap_packet_t));
+    memcpy(blk2_ctxtP->payload, response->payload, response->payload_len);
+    blk2_ctxtP->payload_len = response->payload_len;
 }
 
 #endif
@@ -33,6 +33,14 @@
 
 #define PRV_QUERY_BUFFER_LENGTH 200
 
+// registration is the end of the hold off for the application, registrationMs drives the step
+static void prv_setHoldOff(lwm2m_server_t * serverP,
+                           int64_t currentTime,
+                           time_t delay)
+{
+    serverP->registration = lwm2m_gettime() + delay;
+    serverP->registrationMs = currentTime + (int64_t)delay * MS_PER_SECOND;
+}
 
 static void prv_handleResponse(lwm2m_server_t * bootstrapServer,
                                coap_packet_t * message)
@@ -41,7 +49,7 @@ static void prv_handleResponse(lwm2m_server_t * bootstrapServer,
     {
         LOG("Received ACK/2.04, Bootstrap pending, waiting for DEL/PUT from BS server...");
         bootstrapServer->status = STATE_BS_PENDING;
-        bootstrapServer->registration = lwm2m_gettime() + COAP_EXCHANGE_LIFETIME;
+        prv_setHoldOff(bootstrapServer, utils_gettimeMs(), COAP_EXCHANGE_LIFETIME);
     }
     else
     {
@@ -132,7 +140,6 @@ static void prv_requestBootstrap(lwm2m_context_t * context,
         coap_set_header_uri_query(transaction->message, query);
         transaction->callback = prv_handleBootstrapReply;
         transaction->userData = (void *)bootstrapServer;
-        context->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(context->transactionList, transaction);
         if (transaction_send(context, transaction) == 0)
         {
             LOG("CI bootstrap requested to BS server");
@@ -147,8 +154,8 @@ static void prv_requestBootstrap(lwm2m_context_t * context,
 }
 
 void bootstrap_step(lwm2m_context_t * contextP,
-                    time_t currentTime,
-                    time_t * timeoutP)
+                    int64_t currentTime,
+                    int64_t * timeoutP)
 {
     lwm2m_server_t * targetP;
 
@@ -160,22 +167,22 @@ void bootstrap_step(lwm2m_context_t * contextP,
         switch (targetP->status)
         {
         case STATE_DEREGISTERED:
-            targetP->registration = currentTime + targetP->lifetime;
+            prv_setHoldOff(targetP, currentTime, targetP->lifetime);
             targetP->status = STATE_BS_HOLD_OFF;
-            if (*timeoutP > targetP->lifetime)
+            if (*timeoutP > (int64_t)targetP->lifetime * MS_PER_SECOND)
             {
-                *timeoutP = targetP->lifetime;
+                *timeoutP = (int64_t)targetP->lifetime * MS_PER_SECOND;
             }
             break;
 
         case STATE_BS_HOLD_OFF:
-            if (targetP->registration <= currentTime)
+            if (targetP->registrationMs <= currentTime)
             {
                 prv_requestBootstrap(contextP, targetP);
             }
-            else if (*timeoutP > targetP->registration - currentTime)
+            else if (*timeoutP > targetP->registrationMs - currentTime)
             {
-                *timeoutP = targetP->registration - currentTime;
+                *timeoutP = targetP->registrationMs - currentTime;
             }
             break;
 
@@ -184,14 +191,14 @@ void bootstrap_step(lwm2m_context_t * contextP,
             break;
 
         case STATE_BS_PENDING:
-            if (targetP->registration <= currentTime)
+            if (targetP->registrationMs <= currentTime)
             {
                targetP->status = STATE_BS_FAILING;
                *timeoutP = 0;
             }
-            else if (*timeoutP > targetP->registration - currentTime)
+            else if (*timeoutP > targetP->registrationMs - currentTime)
             {
-                *timeoutP = targetP->registration - currentTime;
+                *timeoutP = targetP->registrationMs - currentTime;
             }
             break;
 
@@ -339,7 +346,7 @@ static uint8_t prv_checkServerStatus(lwm2m_server_t * serverP)
     case STATE_DEREGISTERED:
         // server initiated bootstrap
     case STATE_BS_PENDING:
-        serverP->registration = lwm2m_gettime() + COAP_EXCHANGE_LIFETIME;
+        prv_setHoldOff(serverP, utils_gettimeMs(), COAP_EXCHANGE_LIFETIME);
         break;
 
     case STATE_BS_FINISHED:
@@ -791,8 +798,6 @@ int lwm2m_bootstrap_delete(lwm2m_context_t * contextP,
     transaction->callback = prv_resultCallback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     return transaction_send(contextP, transaction);
 }
 
@@ -834,8 +839,6 @@ int lwm2m_bootstrap_write(lwm2m_context_t * contextP,
     transaction->callback = prv_resultCallback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     return transaction_send(contextP, transaction);
 }
 
@@ -864,8 +867,6 @@ int lwm2m_bootstrap_finish(lwm2m_context_t * contextP,
     transaction->callback = prv_resultCallback;
     transaction->userData = (void *)dataP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     return transaction_send(contextP, transaction);
 }
 
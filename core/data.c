@@ -579,16 +579,12 @@ int lwm2m_data_parse(lwm2m_uri_t * uriP,
     }
 }
 
-int lwm2m_data_serialize(lwm2m_uri_t * uriP,
-                         int size,
-                         lwm2m_data_t * dataP,
-                         lwm2m_media_type_t * formatP,
-                         uint8_t ** bufferP)
+// Fall back to a format able to carry the data, returns false if the format cannot be used
+static bool prv_checkFormat(lwm2m_uri_t * uriP,
+                            int size,
+                            lwm2m_data_t * dataP,
+                            lwm2m_media_type_t * formatP)
 {
-    LOG_URI(uriP);
-    LOG_ARG("size: %d, formatP: %s", size, STR_MEDIA_TYPE(*formatP));
-
-    // Check format
     if (*formatP == LWM2M_CONTENT_TEXT
      || *formatP == LWM2M_CONTENT_OPAQUE)
     {
@@ -610,11 +606,34 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
      && dataP->type != LWM2M_TYPE_OPAQUE)
     {
         LOG("Opaque format is reserved to opaque resources.");
-        return -1;
+        return false;
     }
 
     LOG_ARG("Final format: %s", STR_MEDIA_TYPE(*formatP));
 
+    return true;
+}
+
+// The TLV records are resource instances when a multiple resource is targeted
+static bool prv_isResourceInstance(lwm2m_uri_t * uriP,
+                                   int size,
+                                   lwm2m_data_t * dataP)
+{
+    return uriP != NULL && LWM2M_URI_IS_SET_RESOURCE(uriP)
+        && (size != 1 || dataP->id != uriP->resourceId);
+}
+
+int lwm2m_data_serialize(lwm2m_uri_t * uriP,
+                         int size,
+                         lwm2m_data_t * dataP,
+                         lwm2m_media_type_t * formatP,
+                         uint8_t ** bufferP)
+{
+    LOG_URI(uriP);
+    LOG_ARG("size: %d, formatP: %s", size, STR_MEDIA_TYPE(*formatP));
+
+    if (!prv_checkFormat(uriP, size, dataP, formatP)) return -1;
+
     switch (*formatP)
     {
     case LWM2M_CONTENT_TEXT:
@@ -628,20 +647,7 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
 
     case LWM2M_CONTENT_TLV:
     case LWM2M_CONTENT_TLV_OLD:
-    {
-            bool isResourceInstance;
-
-            if (uriP != NULL && LWM2M_URI_IS_SET_RESOURCE(uriP)
-             && (size != 1 || dataP->id != uriP->resourceId))
-            {
-                isResourceInstance = true;
-            }
-            else
-            {
-                isResourceInstance = false;
-            }
-            return tlv_serialize(isResourceInstance, size, dataP, bufferP);
-        }
+        return tlv_serialize(prv_isResourceInstance(uriP, size, dataP), size, dataP, bufferP);
 
 #ifdef LWM2M_CLIENT_MODE
     case LWM2M_CONTENT_LINK:
@@ -658,3 +664,50 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
     }
 }
 
+int data_serializeBlock(lwm2m_uri_t * uriP,
+                        int size,
+                        lwm2m_data_t * dataP,
+                        lwm2m_media_type_t * formatP,
+                        size_t offset,
+                        size_t blockSize,
+                        uint8_t ** bufferP,
+                        size_t * totalP)
+{
+    uint8_t * fullP;
+    int res;
+
+    LOG_ARG("size: %d, offset: %u, blockSize: %u", size, offset, blockSize);
+
+    *bufferP = NULL;
+    if (!prv_checkFormat(uriP, size, dataP, formatP)) return -1;
+
+    if (*formatP == LWM2M_CONTENT_TLV
+     || *formatP == LWM2M_CONTENT_TLV_OLD)
+    {
+        // only the requested block is encoded
+        return tlv_serializeBlock(prv_isResourceInstance(uriP, size, dataP), size, dataP, offset, blockSize, bufferP, totalP);
+    }
+
+    // other formats are serialized in full then sliced
+    res = lwm2m_data_serialize(uriP, size, dataP, formatP, &fullP);
+    if (res < 0) return -1;
+    *totalP = (size_t)res;
+    if (offset >= (size_t)res)
+    {
+        lwm2m_free(fullP);
+        return 0;
+    }
+    if (offset == 0 && (size_t)res <= blockSize)
+    {
+        *bufferP = fullP;
+        return res;
+    }
+
+    res -= (int)offset;
+    if ((size_t)res > blockSize) res = (int)blockSize;
+    *bufferP = (uint8_t *)lwm2m_malloc(res);
+    if (*bufferP != NULL) memcpy(*bufferP, fullP + offset, res);
+    lwm2m_free(fullP);
+
+    return *bufferP == NULL ? -1 : res;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file deadline.c
+ *
+ * Binary min-heap of deadlines.
+ *
+ * The heap nodes (lwm2m_deadline_t) are embedded in the scheduled structures so
+ * that scheduling never allocates once the heap is large enough. Each node keeps
+ * its position in the heap to allow O(log n) rescheduling and cancellation.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+
+#define PRV_DEADLINE_MIN_SIZE   16
+
+static void prv_set(lwm2m_deadline_heap_t * heapP,
+                    size_t index,
+                    lwm2m_deadline_t * nodeP)
+{
+    heapP->nodes[index] = nodeP;
+    nodeP->position = index + 1;
+}
+
+static void prv_siftUp(lwm2m_deadline_heap_t * heapP,
+                       size_t index)
+{
+    lwm2m_deadline_t * nodeP = heapP->nodes[index];
+
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+
+        if (heapP->nodes[parent]->deadline <= nodeP->deadline) break;
+        prv_set(heapP, index, heapP->nodes[parent]);
+        index = parent;
+    }
+    prv_set(heapP, index, nodeP);
+}
+
+static void prv_siftDown(lwm2m_deadline_heap_t * heapP,
+                         size_t index)
+{
+    lwm2m_deadline_t * nodeP = heapP->nodes[index];
+
+    while (1)
+    {
+        size_t child = 2 * index + 1;
+
+        if (child >= heapP->count) break;
+        if (child + 1 < heapP->count
+         && heapP->nodes[child + 1]->deadline < heapP->nodes[child]->deadline)
+        {
+            child++;
+        }
+        if (nodeP->deadline <= heapP->nodes[child]->deadline) break;
+        prv_set(heapP, index, heapP->nodes[child]);
+        index = child;
+    }
+    prv_set(heapP, index, nodeP);
+}
+
+bool deadline_schedule(lwm2m_deadline_heap_t * heapP,
+                       lwm2m_deadline_t * nodeP,
+                       int64_t deadline)
+{
+    size_t index;
+
+    nodeP->deadline = deadline;
+
+    if (0 != nodeP->position)
+    {
+        index = nodeP->position - 1;
+        if (index > 0 && heapP->nodes[(index - 1) / 2]->deadline > deadline)
+        {
+            prv_siftUp(heapP, index);
+        }
+        else
+        {
+            prv_siftDown(heapP, index);
+        }
+        return true;
+    }
+
+    if (heapP->count == heapP->size)
+    {
+        lwm2m_deadline_t ** nodes;
+        size_t size;
+
+        size = (heapP->size == 0) ? PRV_DEADLINE_MIN_SIZE : heapP->size * 2;
+        nodes = (lwm2m_deadline_t **)lwm2m_malloc(size * sizeof(lwm2m_deadline_t *));
+        if (NULL == nodes) return false;
+        if (NULL != heapP->nodes)
+        {
+            memcpy(nodes, heapP->nodes, heapP->count * sizeof(lwm2m_deadline_t *));
+            lwm2m_free(heapP->nodes);
+        }
+        heapP->nodes = nodes;
+        heapP->size = size;
+    }
+
+    nodeP->next = NULL;
+    heapP->nodes[heapP->count] = nodeP;
+    heapP->count++;
+    prv_siftUp(heapP, heapP->count - 1);
+
+    return true;
+}
+
+void deadline_cancel(lwm2m_deadline_heap_t * heapP,
+                     lwm2m_deadline_t * nodeP)
+{
+    size_t index;
+    lwm2m_deadline_t * lastP;
+
+    if (0 == nodeP->position) return;
+
+    index = nodeP->position - 1;
+    nodeP->position = 0;
+    heapP->count--;
+    if (index == heapP->count) return;
+
+    lastP = heapP->nodes[heapP->count];
+    prv_set(heapP, index, lastP);
+    if (index > 0 && heapP->nodes[(index - 1) / 2]->deadline > lastP->deadline)
+    {
+        prv_siftUp(heapP, index);
+    }
+    else
+    {
+        prv_siftDown(heapP, index);
+    }
+}
+
+lwm2m_deadline_t * deadline_first(lwm2m_deadline_heap_t * heapP)
+{
+    if (0 == heapP->count) return NULL;
+
+    return heapP->nodes[0];
+}
+
+lwm2m_deadline_t * deadline_expire(lwm2m_deadline_heap_t * heapP,
+                                   int64_t currentTime)
+{
+    lwm2m_deadline_t * headP = NULL;
+    lwm2m_deadline_t * tailP = NULL;
+    lwm2m_deadline_t * nodeP;
+
+    while (NULL != (nodeP = deadline_first(heapP))
+        && nodeP->deadline <= currentTime)
+    {
+        deadline_cancel(heapP, nodeP);
+        nodeP->next = NULL;
+        if (NULL == tailP)
+        {
+            headP = nodeP;
+        }
+        else
+        {
+            tailP->next = nodeP;
+        }
+        tailP = nodeP;
+    }
+
+    return headP;
+}
+
+int64_t deadline_interval(lwm2m_deadline_heap_t * heapP,
+                          int64_t currentTime,
+                          int64_t interval)
+{
+    lwm2m_deadline_t * nodeP = deadline_first(heapP);
+
+    if (NULL == nodeP) return interval;
+
+    if (nodeP->deadline <= currentTime) return 0;
+    if (nodeP->deadline - currentTime < interval) return nodeP->deadline - currentTime;
+
+    return interval;
+}
+
+void deadline_free(lwm2m_deadline_heap_t * heapP)
+{
+    size_t i;
+
+    for (i = 0 ; i < heapP->count ; i++)
+    {
+        heapP->nodes[i]->position = 0;
+    }
+    if (NULL != heapP->nodes) lwm2m_free(heapP->nodes);
+    memset(heapP, 0, sizeof(lwm2m_deadline_heap_t));
+}
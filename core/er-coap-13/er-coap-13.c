@@ -65,8 +65,6 @@
 /*-----------------------------------------------------------------------------------*/
 static uint16_t current_mid = 0;
 
-coap_status_t coap_error_code = NO_ERROR;
-const char *coap_error_message = "";
 /*-----------------------------------------------------------------------------------*/
 /*- LOCAL HELP FUNCTIONS ------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -144,7 +142,25 @@ coap_set_option_header(unsigned int delta, size_t length, uint8_t *buffer)
 /*-----------------------------------------------------------------------------------*/
 static
 size_t
-coap_serialize_int_option(unsigned int number, unsigned int current_number, uint8_t *buffer, uint32_t value)
+coap_option_header_len(unsigned int delta, size_t length)
+{
+  size_t len = 1;
+
+  if (delta > 268) len += 2;
+  else if (delta > 12) len += 1;
+
+  if (length > 268) len += 2;
+  else if (length > 12) len += 1;
+
+  return len;
+}
+/*-----------------------------------------------------------------------------------*/
+/*
+ * The option serializers write at most available bytes and return 0 when the option does not fit.
+ */
+static
+size_t
+coap_serialize_int_option(unsigned int number, unsigned int current_number, uint8_t *buffer, size_t available, uint32_t value)
 {
   size_t i = 0;
 
@@ -153,6 +169,8 @@ coap_serialize_int_option(unsigned int number, unsigned int current_number, uint
   if (0xFFFFFF00 & value) ++i;
   if (0xFFFFFFFF & value) ++i;
 
+  if (coap_option_header_len(number - current_number, i) + i > available) return 0;
+
   PRINTF("OPTION %u (delta %u, len %u)\n", number, number - current_number, i);
 
   i = coap_set_option_header(number - current_number, i, buffer);
@@ -167,7 +185,7 @@ coap_serialize_int_option(unsigned int number, unsigned int current_number, uint
 /*-----------------------------------------------------------------------------------*/
 static
 size_t
-coap_serialize_array_option(unsigned int number, unsigned int current_number, uint8_t *buffer, uint8_t *array, size_t length, char split_char)
+coap_serialize_array_option(unsigned int number, unsigned int current_number, uint8_t *buffer, size_t available, uint8_t *array, size_t length, char split_char)
 {
   size_t i = 0;
 
@@ -180,11 +198,13 @@ coap_serialize_array_option(unsigned int number, unsigned int current_number, ui
 
     for (j = 0; j<=length; ++j)
     {
-      if (array[j]==split_char || j==length)
+      if (j==length || array[j]==split_char)
       {
         part_end = array + j;
         temp_length = part_end-part_start;
 
+        if (i + coap_option_header_len(number - current_number, temp_length) + temp_length > available) return 0;
+
         i += coap_set_option_header(number - current_number, temp_length, &buffer[i]);
         memcpy(&buffer[i], part_start, temp_length);
         i += temp_length;
@@ -199,6 +219,8 @@ coap_serialize_array_option(unsigned int number, unsigned int current_number, ui
   }
   else
   {
+    if (coap_option_header_len(number - current_number, length) + length > available) return 0;
+
     i += coap_set_option_header(number - current_number, length, &buffer[i]);
     memcpy(&buffer[i], array, length);
     i += length;
@@ -211,13 +233,15 @@ coap_serialize_array_option(unsigned int number, unsigned int current_number, ui
 /*-----------------------------------------------------------------------------------*/
 static
 size_t
-coap_serialize_multi_option(unsigned int number, unsigned int current_number, uint8_t *buffer, multi_option_t *array)
+coap_serialize_multi_option(unsigned int number, unsigned int current_number, uint8_t *buffer, size_t available, multi_option_t *array)
 {
   size_t i = 0;
   multi_option_t * j;
 
   for (j = array; j != NULL; j= j->next)
   {
+     if (i + coap_option_header_len(number - current_number, j->len) + j->len > available) return 0;
+
      i += coap_set_option_header(number - current_number, j->len, &buffer[i]);
      current_number = number;
      memcpy(&buffer[i], j->data, j->len);
@@ -259,6 +283,7 @@ coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len,
   if (opt)
   {
     opt->next = NULL;
+    opt->is_pooled = 0;
     opt->len = (uint8_t)option_len;
     if (is_static)
     {
@@ -293,19 +318,57 @@ coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len,
   }
 }
 
+/*
+ * Adds an option of a message being parsed. The node is taken from the packet's
+ * option pool while it lasts, so that parsing a message does not allocate.
+ */
+static
+void
+coap_parse_multi_option(coap_packet_t *coap_pkt, multi_option_t **dst, uint8_t *option, size_t option_len)
+{
+  multi_option_t *opt;
+
+  if (coap_pkt->option_pool_len >= COAP_OPTION_POOL_SIZE)
+  {
+    coap_add_multi_option(dst, option, option_len, 1);
+    return;
+  }
+
+  opt = &coap_pkt->option_pool[coap_pkt->option_pool_len];
+  opt->next = NULL;
+  opt->is_static = 1;
+  opt->is_pooled = 1;
+  opt->len = (uint8_t)option_len;
+  opt->data = option;
+
+  if (*dst)
+  {
+    /* Options are sorted by number: the tail of dst is the previous pool node. */
+    coap_pkt->option_pool[coap_pkt->option_pool_len - 1].next = opt;
+  }
+  else
+  {
+    *dst = opt;
+  }
+  coap_pkt->option_pool_len++;
+}
+
 void
 free_multi_option(multi_option_t *dst)
 {
-  if (dst)
+  while (dst)
   {
     multi_option_t *n = dst->next;
     dst->next = NULL;
-    if (dst->is_static == 0)
+    if (dst->is_pooled == 0)
     {
-        lwm2m_free(dst->data);
+      if (dst->is_static == 0)
+      {
+          lwm2m_free(dst->data);
+      }
+      lwm2m_free(dst);
     }
-    lwm2m_free(dst);
-    free_multi_option(n);
+    dst = n;
   }
 }
 
@@ -434,18 +497,18 @@ size_t coap_serialize_get_size(void *packet)
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_IF_NONE_MATCH))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_OBSERVE))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_URI_PORT))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_LOCATION_PATH))
     {
@@ -467,13 +530,13 @@ size_t coap_serialize_get_size(void *packet)
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_CONTENT_TYPE))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_MAX_AGE))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_URI_QUERY))
     {
@@ -486,26 +549,33 @@ size_t coap_serialize_get_size(void *packet)
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_ACCEPT))
     {
-        length += coap_pkt->accept_num * COAP_MAX_OPTION_HEADER_LEN;
+        length += coap_pkt->accept_num * (COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN);
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_LOCATION_QUERY))
     {
+        size_t i;
+
+        // serialized as one option per '&' separated part
         length += COAP_MAX_OPTION_HEADER_LEN + coap_pkt->location_query_len;
+        for (i = 0 ; i < coap_pkt->location_query_len ; i++)
+        {
+            if ('&' == coap_pkt->location_query[i]) length += COAP_MAX_OPTION_HEADER_LEN;
+        }
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_BLOCK2))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_BLOCK1))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_SIZE))
     {
-        // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        // option header and up to 4 bytes of value
+        length += COAP_MAX_OPTION_HEADER_LEN + COAP_MAX_INT_OPTION_LEN;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_PROXY_URI))
     {
@@ -522,13 +592,19 @@ size_t coap_serialize_get_size(void *packet)
 }
 
 /*-----------------------------------------------------------------------------------*/
+/*
+ * Writes the fixed header, the token, the options and the payload marker in a single pass.
+ * Returns the number of bytes written or 0 if they do not fit in buffer_len bytes.
+ */
+static
 size_t
-coap_serialize_message(void *packet, uint8_t *buffer)
+coap_serialize_fields(coap_packet_t *coap_pkt, uint8_t *buffer, size_t buffer_len)
 {
-  coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
   uint8_t *option;
   unsigned int current_number = 0;
 
+  if ((size_t)(COAP_HEADER_LEN + coap_pkt->token_len) > buffer_len) return 0;
+
   /* Initialize */
   coap_pkt->buffer = buffer;
   coap_pkt->version = 1;
@@ -581,20 +657,48 @@ coap_serialize_message(void *packet, uint8_t *buffer)
 
   PRINTF("-Done serializing at %p----\n", option);
 
-  /* Free allocated header fields */
-  coap_free_header(packet);
-
-  /* Pack payload */
   /* Payload marker */
   if (coap_pkt->payload_len)
   {
+    if ((size_t)(option - buffer) >= buffer_len) return 0;
     *option = 0xFF;
     ++option;
   }
 
-  memmove(option, coap_pkt->payload, coap_pkt->payload_len);
+  return option - buffer;
+}
+/*-----------------------------------------------------------------------------------*/
+size_t
+coap_serialize_header(void *packet, uint8_t *buffer, size_t buffer_len)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
+  size_t header_len;
+
+  header_len = coap_serialize_fields(coap_pkt, buffer, buffer_len);
+
+  /* Free allocated header fields */
+  coap_free_header(packet);
+
+  PRINTF("-Done %u B header, payload len %u-\n", header_len, coap_pkt->payload_len);
+
+  return header_len;
+}
+/*-----------------------------------------------------------------------------------*/
+size_t
+coap_serialize_message(void *packet, uint8_t *buffer)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
+  size_t header_len;
 
-  PRINTF("-Done %u B (header len %u, payload len %u)-\n", coap_pkt->payload_len + option - buffer, option - buffer, coap_pkt->payload_len);
+  /* The caller sized buffer with coap_serialize_get_size() */
+  header_len = coap_serialize_header(packet, buffer, SIZE_MAX);
+  if (header_len == 0) return 0;
+
+  /* Pack payload */
+  if (coap_pkt->payload_len)
+  {
+    memmove(buffer + header_len, coap_pkt->payload, coap_pkt->payload_len);
+  }
 
   PRINTF("Dump [0x%02X %02X %02X %02X  %02X %02X %02X %02X]\n",
       coap_pkt->buffer[0],
@@ -607,21 +711,47 @@ coap_serialize_message(void *packet, uint8_t *buffer)
       coap_pkt->buffer[7]
     );
 
-  return (option - buffer) + coap_pkt->payload_len; /* packet length */
+  return header_len + coap_pkt->payload_len; /* packet length */
+}
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Reads the extended option delta or length announced by the 4-bit value (RFC 7252 section 3.1).
+ * Returns 0 if the value is reserved or if its extension bytes do not fit in the packet.
+ */
+static
+int
+coap_parse_option_extension(unsigned int *value, uint8_t **current_option, const uint8_t *data_end)
+{
+  switch (*value)
+  {
+  case 13:
+    if (data_end - *current_option < 1) return 0;
+    *value = 13 + (*current_option)[0];
+    *current_option += 1;
+    break;
+  case 14:
+    if (data_end - *current_option < 2) return 0;
+    *value = 269 + ((*current_option)[0] << 8) + (*current_option)[1];
+    *current_option += 2;
+    break;
+  case 15:
+    return 0;
+  default:
+    break;
+  }
+
+  return 1;
 }
 /*-----------------------------------------------------------------------------------*/
-#ifndef __THREADX__
-coap_status_t __attribute__((optimize("O0")))
-#else
 coap_status_t
-#endif
 coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
+  const uint8_t *data_end = data + data_len;
   uint8_t *current_option;
   unsigned int option_number = 0;
   unsigned int option_delta = 0;
-  size_t option_length = 0;
+  unsigned int option_length = 0;
 
   /* Initialize packet */
   memset(coap_pkt, 0, sizeof(coap_packet_t));
@@ -629,21 +759,36 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
   /* pointer to packet bytes */
   coap_pkt->buffer = data;
 
+  if (data_len < COAP_HEADER_LEN)
+  {
+    coap_pkt->error_message = "Packet shorter than the CoAP header";
+    return BAD_REQUEST_4_00;
+  }
+
   /* parse header fields */
   coap_pkt->version = (COAP_HEADER_VERSION_MASK & coap_pkt->buffer[0])>>COAP_HEADER_VERSION_POSITION;
   coap_pkt->type = (coap_message_type_t)((COAP_HEADER_TYPE_MASK & coap_pkt->buffer[0])>>COAP_HEADER_TYPE_POSITION);
-  coap_pkt->token_len = MIN(COAP_TOKEN_LEN, (COAP_HEADER_TOKEN_LEN_MASK & coap_pkt->buffer[0])>>COAP_HEADER_TOKEN_LEN_POSITION);
+  coap_pkt->token_len = (COAP_HEADER_TOKEN_LEN_MASK & coap_pkt->buffer[0])>>COAP_HEADER_TOKEN_LEN_POSITION;
   coap_pkt->code = coap_pkt->buffer[1];
   coap_pkt->mid = coap_pkt->buffer[2]<<8 | coap_pkt->buffer[3];
 
   if (coap_pkt->version != 1)
   {
-    coap_error_message = "CoAP version must be 1";
+    coap_pkt->error_message = "CoAP version must be 1";
     return BAD_REQUEST_4_00;
   }
 
   current_option = data + COAP_HEADER_LEN;
 
+  /* token lengths 9 to 15 are reserved */
+  if (coap_pkt->token_len > COAP_TOKEN_LEN
+   || coap_pkt->token_len > data_end - current_option)
+  {
+    coap_pkt->token_len = 0;
+    coap_pkt->error_message = "Invalid token length";
+    return BAD_REQUEST_4_00;
+  }
+
   if (coap_pkt->token_len != 0)
   {
       memcpy(coap_pkt->token, current_option, coap_pkt->token_len);
@@ -664,7 +809,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
   /* parse options */
   current_option += coap_pkt->token_len;
 
-  while (current_option < data+data_len)
+  while (current_option < data_end)
   {
     /* Payload marker 0xFF, currently only checking for 0xF* because rest is reserved */
     if ((current_option[0] & 0xF0)==0xF0)
@@ -679,31 +824,18 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
     option_length = current_option[0] & 0x0F;
     ++current_option;
 
-    if (option_delta == 13) {
-      option_delta += current_option[0];
-      ++current_option;
-    } else if (option_delta == 14) {
-      option_delta += 255;
-      option_delta += current_option[0] << 8;
-      ++current_option;
-      option_delta += current_option[0];
-      ++current_option;
-    }
-
-    if (option_length == 13) {
-      option_length += current_option[0];
-      ++current_option;
-    } else if (option_length == 14) {
-      option_length += 255;
-      option_length += current_option[0] << 8;
-      ++current_option;
-      option_length += current_option[0];
-      ++current_option;
+    if (!coap_parse_option_extension(&option_delta, &current_option, data_end)
+     || !coap_parse_option_extension(&option_length, &current_option, data_end))
+    {
+        PRINTF("OPTION after %u has an invalid header.\n", option_number);
+        coap_free_header(coap_pkt);
+        return BAD_REQUEST_4_00;
     }
 
     option_number += option_delta;
 
-    if (current_option + option_length > data + data_len)
+    if (option_number > 0xFFFF
+     || option_length > (unsigned int)(data_end - current_option))
     {
         PRINTF("OPTION %u (delta %u, len %u) has invalid length.\n", option_number, option_delta, option_length);
         coap_free_header(coap_pkt);
@@ -780,18 +912,18 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       case COAP_OPTION_URI_PATH:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_path), &(coap_pkt->uri_path_len), current_option, option_length, 0);
-        coap_add_multi_option( &(coap_pkt->uri_path), current_option, option_length, 1);
+        coap_parse_multi_option(coap_pkt, &(coap_pkt->uri_path), current_option, option_length);
         PRINTF("Uri-Path [%.*s]\n", option_length, current_option);
         break;
       case COAP_OPTION_URI_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_query), &(coap_pkt->uri_query_len), current_option, option_length, '&');
-        coap_add_multi_option( &(coap_pkt->uri_query), current_option, option_length, 1);
+        coap_parse_multi_option(coap_pkt, &(coap_pkt->uri_query), current_option, option_length);
         PRINTF("Uri-Query [%.*s]\n", option_length, current_option);
         break;
 
       case COAP_OPTION_LOCATION_PATH:
-        coap_add_multi_option( &(coap_pkt->location_path), current_option, option_length, 1);
+        coap_parse_multi_option(coap_pkt, &(coap_pkt->location_path), current_option, option_length);
         break;
       case COAP_OPTION_LOCATION_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
@@ -805,7 +937,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         coap_pkt->proxy_uri_len = option_length;
         /*TODO length > 270 not implemented (actually not required) */
         PRINTF("Proxy-Uri NOT IMPLEMENTED [%.*s]\n", coap_pkt->proxy_uri_len, coap_pkt->proxy_uri);
-        coap_error_message = "This is a constrained server (Contiki)";
+        coap_pkt->error_message = "This is a constrained server (Contiki)";
         coap_free_header(coap_pkt);
         return PROXYING_NOT_SUPPORTED_5_05;
 
@@ -838,7 +970,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         /* Check if critical (odd) */
         if (option_number & 1)
         {
-          coap_error_message = "Unsupported critical option";
+          coap_pkt->error_message = "Unsupported critical option";
           coap_free_header(coap_pkt);
           return BAD_OPTION_4_02;
         }
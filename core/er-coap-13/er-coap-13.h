@@ -68,8 +68,12 @@
 #define COAP_ETAG_LEN                        8 /* The maximum number of bytes for the ETag */
 #define COAP_TOKEN_LEN                       8 /* The maximum number of bytes for the Token */
 #define COAP_MAX_ACCEPT_NUM                  2 /* The maximum number of accept preferences to parse/store */
+#ifndef COAP_OPTION_POOL_SIZE
+#define COAP_OPTION_POOL_SIZE                8 /* The number of Uri-Path/Uri-Query/Location-Path options parsed without allocation */
+#endif
 
 #define COAP_MAX_OPTION_HEADER_LEN           5
+#define COAP_MAX_INT_OPTION_LEN              4 /* The maximum number of bytes of an integer option value */
 
 #define COAP_HEADER_VERSION_MASK             0xC0
 #define COAP_HEADER_VERSION_POSITION         6
@@ -98,8 +102,8 @@
 
 /* Bitmap for set options */
 enum { OPTION_MAP_SIZE = sizeof(uint8_t) * 8 };
-#define SET_OPTION(packet, opt) {if (opt <= sizeof((packet)->options) * OPTION_MAP_SIZE) {(packet)->options[opt / OPTION_MAP_SIZE] |= 1 << (opt % OPTION_MAP_SIZE);}}
-#define IS_OPTION(packet, opt) ((opt <= sizeof((packet)->options) * OPTION_MAP_SIZE)?(packet)->options[opt / OPTION_MAP_SIZE] & (1 << (opt % OPTION_MAP_SIZE)):0)
+#define SET_OPTION(packet, opt) {if (opt < sizeof((packet)->options) * OPTION_MAP_SIZE) {(packet)->options[opt / OPTION_MAP_SIZE] |= 1 << (opt % OPTION_MAP_SIZE);}}
+#define IS_OPTION(packet, opt) ((opt < sizeof((packet)->options) * OPTION_MAP_SIZE)?(packet)->options[opt / OPTION_MAP_SIZE] & (1 << (opt % OPTION_MAP_SIZE)):0)
 
 #ifndef MIN
 #define MIN(a, b) ((a) < (b)? (a) : (b))
@@ -211,6 +215,7 @@ typedef enum {
 typedef struct _multi_option_t {
   struct _multi_option_t *next;
   uint8_t is_static;
+  uint8_t is_pooled; /* the node belongs to coap_packet_t::option_pool and is not allocated */
   uint8_t len;
   uint8_t *data;
 } multi_option_t;
@@ -261,13 +266,26 @@ typedef struct {
   uint32_t payload_len;
   uint8_t *payload;
 
+  /* Human-readable reason of a parsing error, NULL if none */
+  const char *error_message;
+
+  /* Nodes of the multi-value options of a parsed message, pointing into the datagram */
+  uint8_t option_pool_len;
+  multi_option_t option_pool[COAP_OPTION_POOL_SIZE];
 } coap_packet_t;
 
-/* Option format serialization*/
+/* Option format serialization, return 0 from the enclosing function when the buffer is full */
+#define COAP_SERIALIZE_OPTION_CALL(call) \
+    { \
+      size_t written = call; \
+      if (written == 0) return 0; \
+      option += written; \
+    }
+#define COAP_SERIALIZE_AVAILABLE (buffer_len - (size_t)(option - buffer))
 #define COAP_SERIALIZE_INT_OPTION(number, field, text)  \
     if (IS_OPTION(coap_pkt, number)) { \
       PRINTF(text" [%u]\n", coap_pkt->field); \
-      option += coap_serialize_int_option(number, current_number, option, coap_pkt->field); \
+      COAP_SERIALIZE_OPTION_CALL(coap_serialize_int_option(number, current_number, option, COAP_SERIALIZE_AVAILABLE, coap_pkt->field)) \
       current_number = number; \
     }
 #define COAP_SERIALIZE_BYTE_OPTION(number, field, text)      \
@@ -282,19 +300,20 @@ typedef struct {
         coap_pkt->field[6], \
         coap_pkt->field[7] \
       ); /*FIXME always prints 8 bytes */ \
-      option += coap_serialize_array_option(number, current_number, option, coap_pkt->field, coap_pkt->field##_len, '\0'); \
+      COAP_SERIALIZE_OPTION_CALL(coap_serialize_array_option(number, current_number, option, COAP_SERIALIZE_AVAILABLE, coap_pkt->field, coap_pkt->field##_len, '\0')) \
       current_number = number; \
     }
 #define COAP_SERIALIZE_STRING_OPTION(number, field, splitter, text)      \
     if (IS_OPTION(coap_pkt, number)) { \
       PRINTF(text" [%.*s]\n", coap_pkt->field##_len, coap_pkt->field); \
-      option += coap_serialize_array_option(number, current_number, option, (uint8_t *) coap_pkt->field, coap_pkt->field##_len, splitter); \
+      COAP_SERIALIZE_OPTION_CALL(coap_serialize_array_option(number, current_number, option, COAP_SERIALIZE_AVAILABLE, (uint8_t *) coap_pkt->field, coap_pkt->field##_len, splitter)) \
       current_number = number; \
     }
 #define COAP_SERIALIZE_MULTI_OPTION(number, field, text)      \
-        if (IS_OPTION(coap_pkt, number)) { \
+        /* an empty list writes nothing, 0 is only returned when it does not fit */ \
+        if (IS_OPTION(coap_pkt, number) && coap_pkt->field != NULL) { \
           PRINTF(text); \
-          option += coap_serialize_multi_option(number, current_number, option, coap_pkt->field); \
+          COAP_SERIALIZE_OPTION_CALL(coap_serialize_multi_option(number, current_number, option, COAP_SERIALIZE_AVAILABLE, coap_pkt->field)) \
           current_number = number; \
         }
 #define COAP_SERIALIZE_ACCEPT_OPTION(number, field, text)  \
@@ -303,7 +322,7 @@ typedef struct {
       for (i=0; i<coap_pkt->field##_num; ++i) \
       { \
         PRINTF(text" [%u]\n", coap_pkt->field[i]); \
-        option += coap_serialize_int_option(number, current_number, option, coap_pkt->field[i]); \
+        COAP_SERIALIZE_OPTION_CALL(coap_serialize_int_option(number, current_number, option, COAP_SERIALIZE_AVAILABLE, coap_pkt->field[i])) \
         current_number = number; \
       } \
     }
@@ -315,18 +334,18 @@ typedef struct {
       if (coap_pkt->field##_more) block |= 0x8; \
       block |= 0xF & coap_log_2(coap_pkt->field##_size/16); \
       PRINTF(text" encoded: 0x%lX\n", block); \
-      option += coap_serialize_int_option(number, current_number, option, block); \
+      COAP_SERIALIZE_OPTION_CALL(coap_serialize_int_option(number, current_number, option, COAP_SERIALIZE_AVAILABLE, block)) \
       current_number = number; \
     }
 
-/* To store error code and human-readable payload */
-extern const char *coap_error_message;
 
 uint16_t coap_get_mid(void);
 
 void coap_init_message(void *packet, coap_message_type_t type, uint8_t code, uint16_t mid);
 size_t coap_serialize_get_size(void *packet);
 size_t coap_serialize_message(void *packet, uint8_t *buffer);
+/* Serializes everything but the payload bytes, returns the header length or 0 if it does not fit */
+size_t coap_serialize_header(void *packet, uint8_t *buffer, size_t buffer_len);
 coap_status_t coap_parse_message(void *request, uint8_t *data, uint16_t data_len);
 void coap_free_header(void *packet);
 
@@ -0,0 +1,125 @@
+/**
+ * @file hashindex.c
+ *
+ * Open-addressed hash table (linear probing) of pointers.
+ *
+ * The index only stores the entries. Their key is hashed by the function given to each call,
+ * which must be the same for all the calls on an index, and the lookups are done by the
+ * owner of the index, which knows how to compare its entries with a key.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+
+#define PRV_HASHINDEX_MIN_SIZE  16
+
+static void prv_put(lwm2m_hash_index_t * indexP,
+                    void * entryP,
+                    lwm2m_hash_func_t hashFunc)
+{
+    size_t mask = indexP->size - 1;
+    size_t i;
+
+    i = hashFunc(entryP) & mask;
+    while (NULL != indexP->slots[i])
+    {
+        i = (i + 1) & mask;
+    }
+    indexP->slots[i] = entryP;
+    indexP->count++;
+}
+
+static bool prv_grow(lwm2m_hash_index_t * indexP,
+                     lwm2m_hash_func_t hashFunc)
+{
+    void ** oldSlots = indexP->slots;
+    size_t oldSize = indexP->size;
+    size_t newSize;
+    size_t i;
+
+    newSize = (oldSize == 0) ? PRV_HASHINDEX_MIN_SIZE : oldSize * 2;
+    indexP->slots = (void **)lwm2m_malloc(newSize * sizeof(void *));
+    if (NULL == indexP->slots)
+    {
+        indexP->slots = oldSlots;
+        return false;
+    }
+    memset(indexP->slots, 0, newSize * sizeof(void *));
+    indexP->size = newSize;
+    indexP->count = 0;
+
+    for (i = 0 ; i < oldSize ; i++)
+    {
+        if (NULL != oldSlots[i]) prv_put(indexP, oldSlots[i], hashFunc);
+    }
+    if (NULL != oldSlots) lwm2m_free(oldSlots);
+
+    return true;
+}
+
+bool hashindex_insert(lwm2m_hash_index_t * indexP,
+                      void * entryP,
+                      lwm2m_hash_func_t hashFunc)
+{
+    // keep the load factor under 1/2 so that probe sequences stay short
+    if ((indexP->count + 1) * 2 > indexP->size)
+    {
+        if (!prv_grow(indexP, hashFunc))
+        {
+            // still usable as long as one slot remains free to end the probes
+            if (indexP->count + 1 >= indexP->size) return false;
+        }
+    }
+
+    prv_put(indexP, entryP, hashFunc);
+    return true;
+}
+
+void hashindex_remove(lwm2m_hash_index_t * indexP,
+                      void * entryP,
+                      lwm2m_hash_func_t hashFunc)
+{
+    size_t mask = indexP->size - 1;
+    size_t i;
+    size_t j;
+
+    if (0 == indexP->size) return;
+
+    i = hashFunc(entryP) & mask;
+    while (indexP->slots[i] != entryP)
+    {
+        if (NULL == indexP->slots[i]) return;
+        i = (i + 1) & mask;
+    }
+
+    // backward-shift deletion: move up the following entries that would not be
+    // reachable anymore from their home slot.
+    j = i;
+    while (1)
+    {
+        size_t home;
+
+        indexP->slots[i] = NULL;
+        do
+        {
+            j = (j + 1) & mask;
+            if (NULL == indexP->slots[j])
+            {
+                indexP->count--;
+                return;
+            }
+            home = hashFunc(indexP->slots[j]) & mask;
+        } while ((i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j)));
+
+        indexP->slots[i] = indexP->slots[j];
+        i = j;
+    }
+}
+
+void hashindex_free(lwm2m_hash_index_t * indexP)
+{
+    if (NULL != indexP->slots) lwm2m_free(indexP->slots);
+    memset(indexP, 0, sizeof(lwm2m_hash_index_t));
+}
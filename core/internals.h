@@ -269,9 +269,17 @@
 #define LWM2M_URI_MASK_TYPE (uint8_t)0x70
 #define LWM2M_URI_MASK_ID   (uint8_t)0x07
 
+// set on a registration URI /rd/<id>, whose ID is in registrationId
+#define LWM2M_URI_FLAG_REGISTRATION_ID (uint8_t)0x08
+
+#define MS_PER_SECOND 1000
+
+// retrieves the structure embedding the member pointed by P
+#define LWM2M_CONTAINER_OF(P, TYPE, MEMBER) ((TYPE *)((uint8_t *)(P) - offsetof(TYPE, MEMBER)))
+
 typedef struct
 {
-    uint16_t clientID;
+    uint32_t clientID;
     lwm2m_uri_t uri;
     lwm2m_result_callback_t callback;
     void * userData;
@@ -295,6 +303,55 @@ typedef struct
 } bs_data_t;
 #endif
 
+#if SIERRA
+#define MAX_BLOCK2_SIZE 1024
+
+// block1 data push in progress
+typedef struct
+{
+    lwm2m_context_t * contextP;
+    lwm2m_server_t * serverP;
+    uint16_t firstBlockMid;
+    uint8_t * bufferP;
+    size_t buffer_len;
+    unsigned int content_type;
+    lwm2m_push_ack_callback_t callbackP;
+} push_state_t;
+
+// block2 asynchronous response in progress
+typedef struct
+{
+    uint8_t * bufferP;
+    size_t length;
+    unsigned int content_type;
+} async_state_t;
+
+// last block2 sent for an external CoAP handler, kept for retransmissions
+typedef struct
+{
+    coap_packet_t response;
+    uint8_t payload[MAX_BLOCK2_SIZE];
+    uint32_t payload_len;
+    uint32_t expBlock2Num;
+    uint16_t lastBlock2Mid;
+} block2_context_t;
+#endif
+
+// Scratch and transfer state of the packet layer. It lives in the context, not in
+// static variables, so that contexts can be used from different threads.
+struct _lwm2m_packet_state_
+{
+    coap_packet_t message[1];       // message being handled by lwm2m_handle_packet()
+    coap_packet_t response[1];      // response built by lwm2m_handle_packet()
+#if SIERRA
+    coap_packet_t appResponse[1];   // response built by lwm2m_send_response()
+    push_state_t pushState;
+    async_state_t asyncState;
+    uint32_t block1Num;             // last block1 number sent by lwm2m_send_notification()
+    block2_context_t block2State;
+#endif
+};
+
 typedef struct
 {
     uint16_t shortId;
@@ -317,6 +374,7 @@ int uri_toString(lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, uri_dep
 // defined in objects.c
 uint8_t object_readData(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, int * sizeP, lwm2m_data_t ** dataP);
 uint8_t object_read(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t * formatP, uint8_t ** bufferP, size_t * lengthP);
+uint8_t object_readBlock(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t * formatP, size_t offset, size_t blockSize, uint8_t ** bufferP, size_t * lengthP, size_t * totalP);
 uint8_t object_write(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, size_t length);
 uint8_t object_create(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, size_t length);
 uint8_t object_execute(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, uint8_t * buffer, size_t length);
@@ -332,11 +390,13 @@ uint8_t object_writeInstance(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm
 
 // defined in transaction.c
 lwm2m_transaction_t * transaction_new(void * sessionH, coap_method_t method, char * altPath, lwm2m_uri_t * uriP, uint16_t mID, uint8_t token_len, uint8_t* token);
+// The first call to transaction_send() adds the transaction to the context's list and indexes.
 int transaction_send(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
 void transaction_free(lwm2m_transaction_t * transacP);
 void transaction_remove(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+void transaction_freeIndex(lwm2m_context_t * contextP);
 bool transaction_handleResponse(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
-void transaction_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
+void transaction_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 
 // defined in management.c
 uint8_t dm_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, coap_packet_t * message, coap_packet_t * response);
@@ -345,25 +405,29 @@ uint8_t dm_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_s
 uint8_t observe_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, int size, lwm2m_data_t * dataP, coap_packet_t * message, coap_packet_t * response);
 void observe_cancel(lwm2m_context_t * contextP, uint16_t mid, void * fromSessionH);
 uint8_t observe_setParameters(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, lwm2m_attributes_t * attrP);
-void observe_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
+void observe_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 void observe_clear(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
 bool observe_handleNotify(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 void observe_remove(lwm2m_observation_t * observationP);
+void observe_free(lwm2m_observation_t * observationP);
+void observe_freeTable(lwm2m_context_t * contextP);
 lwm2m_observed_t * observe_findByUri(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
+void observe_freeIndex(lwm2m_context_t * contextP);
 
 // defined in registration.c
 uint8_t registration_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 bool registration_deregister(lwm2m_context_t * contextP, lwm2m_server_t * serverP);
 void registration_freeClient(lwm2m_client_t * clientP);
+void registration_freeClientList(lwm2m_context_t * contextP);
 uint8_t registration_start(lwm2m_context_t * contextP);
-void registration_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
+void registration_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 lwm2m_status_t registration_getStatus(lwm2m_context_t * contextP);
 
 // defined in packet.c
 uint8_t message_send(lwm2m_context_t * contextP, coap_packet_t * message, void * sessionH);
 
 // defined in bootstrap.c
-void bootstrap_step(lwm2m_context_t * contextP, time_t currentTime, time_t* timeoutP);
+void bootstrap_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
 uint8_t bootstrap_handleCommand(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, coap_packet_t * message, coap_packet_t * response);
 uint8_t bootstrap_handleDeleteAll(lwm2m_context_t * context, void * fromSessionH);
 uint8_t bootstrap_handleFinish(lwm2m_context_t * context, void * fromSessionH);
@@ -373,7 +437,14 @@ lwm2m_status_t bootstrap_getStatus(lwm2m_context_t * contextP);
 
 // defined in tlv.c
 int tlv_parse(uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
+// Length of the complete records at the start of buffer. *nextLengthP receives the length of the next record, 0 if its header is not complete.
+size_t tlv_getCompleteLength(const uint8_t * buffer, size_t bufferLen, size_t * nextLengthP);
 int tlv_serialize(bool isResourceInstance, int size, lwm2m_data_t * dataP, uint8_t ** bufferP);
+// Serializes only the bytes from offset to offset + length, *totalP receives the length of the full serialization.
+int tlv_serializeBlock(bool isResourceInstance, int size, lwm2m_data_t * dataP, size_t offset, size_t length, uint8_t ** bufferP, size_t * totalP);
+
+// defined in data.c
+int data_serializeBlock(lwm2m_uri_t * uriP, int size, lwm2m_data_t * dataP, lwm2m_media_type_t * formatP, size_t offset, size_t blockSize, uint8_t ** bufferP, size_t * totalP);
 
 // defined in json.c
 #ifdef LWM2M_SUPPORT_JSON
@@ -386,6 +457,8 @@ int discover_serialize(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_ser
 
 // defined in block1.c
 uint8_t coap_block1_handler(lwm2m_block1_data_t ** block1Data, uint16_t mid, uint8_t * buffer, size_t length, uint16_t blockSize, uint32_t blockNum, bool blockMore, uint8_t ** outputBuffer, size_t * outputLength);
+// Same as coap_block1_handler() but outputs the complete TLV records of each block instead of the whole reassembled payload.
+uint8_t coap_block1_tlv_handler(lwm2m_block1_data_t ** block1Data, uint16_t mid, uint8_t * buffer, size_t length, uint16_t blockSize, uint32_t blockNum, bool blockMore, uint8_t ** outputBuffer, size_t * outputLength);
 void free_block1_buffer(lwm2m_block1_data_t * block1Data);
 
 // defined in utils.c
@@ -405,6 +478,27 @@ size_t utils_base64Encode(uint8_t * dataP, size_t dataLen, uint8_t * bufferP, si
 lwm2m_server_t * utils_findServer(lwm2m_context_t * contextP, void * fromSessionH);
 lwm2m_server_t * utils_findBootstrapServer(lwm2m_context_t * contextP, void * fromSessionH);
 #endif
+// time base of all the timers, in ms. Negative in case of error.
+int64_t utils_gettimeMs(void);
+uint32_t utils_random(void);
+
+// defined in deadline.c
+// deadline_schedule() (re)schedules a node, it only fails when the heap cannot grow.
+// deadline_expire() unschedules all the nodes due at currentTime and returns them chained by their next field.
+bool deadline_schedule(lwm2m_deadline_heap_t * heapP, lwm2m_deadline_t * nodeP, int64_t deadline);
+void deadline_cancel(lwm2m_deadline_heap_t * heapP, lwm2m_deadline_t * nodeP);
+lwm2m_deadline_t * deadline_first(lwm2m_deadline_heap_t * heapP);
+lwm2m_deadline_t * deadline_expire(lwm2m_deadline_heap_t * heapP, int64_t currentTime);
+int64_t deadline_interval(lwm2m_deadline_heap_t * heapP, int64_t currentTime, int64_t interval);
+void deadline_free(lwm2m_deadline_heap_t * heapP);
+
+// defined in hashindex.c
+// The hash function of an entry must be the same for all the calls on an index.
+// hashindex_insert() only fails when the index is full and cannot grow.
+typedef uint32_t (*lwm2m_hash_func_t)(void * entryP);
+bool hashindex_insert(lwm2m_hash_index_t * indexP, void * entryP, lwm2m_hash_func_t hashFunc);
+void hashindex_remove(lwm2m_hash_index_t * indexP, void * entryP, lwm2m_hash_func_t hashFunc);
+void hashindex_free(lwm2m_hash_index_t * indexP);
 
 // defined in acl.c
 void acl_readObject(lwm2m_context_t * contextP);
@@ -431,13 +525,15 @@ void coap_end_block1_stream(lwm2m_block1_data_t ** pBlock1Data,
                             size_t * outputLength);
 
 // defined in block2-stream.c
-coap_status_t coap_block2_stream_handler(coap_packet_t * message,
+coap_status_t coap_block2_stream_handler(lwm2m_context_t * contextP,
+                                         coap_packet_t * message,
                                          coap_packet_t * response);
 
-void coap_block2_handle_response(coap_packet_t* response,
+void coap_block2_handle_response(lwm2m_context_t * contextP,
+                                 coap_packet_t* response,
                                  lwm2mcore_StreamStatus_t streamStatus);
 
-void coap_end_block2_stream(void);
+void coap_end_block2_stream(lwm2m_context_t * contextP);
 #endif
 
 #endif
@@ -25,12 +25,15 @@
 
 #ifdef LWM2M_SUPPORT_JSON
 
+// Initial size of the serialized output, doubled as needed
 #define PRV_JSON_BUFFER_SIZE 1024
 
 #define JSON_MIN_ARRAY_LEN      21      // e":[{"n":"N","v":X}]}
 #define JSON_MIN_BASE_LEN        7      // n":"N",
 #define JSON_ITEM_MAX_SIZE      36      // with ten characters for value
 #define JSON_MIN_BX_LEN          5      // bt":1
+#define JSON_NUMBER_MAX_SIZE    64      // room for a number in text
+#define JSON_ID_MAX_SIZE         5      // 65535
 
 #define JSON_FALSE_STRING  "false"
 #define JSON_TRUE_STRING   "true"
@@ -87,6 +90,13 @@ typedef enum
     _TYPE_STRING
 } _type;
 
+typedef struct
+{
+    uint8_t *   buffer;
+    size_t      length;
+    size_t      size;
+} _writer_t;
+
 typedef struct
 {
     uint16_t    ids[4];
@@ -1029,6 +1039,74 @@ error:
     return -1;
 }
 
+// Make room for length more bytes, the buffer is doubled as needed
+static bool prv_reserve(_writer_t * writerP,
+                        size_t length)
+{
+    uint8_t * bufferP;
+    size_t size;
+
+    if (writerP->size - writerP->length >= length) return true;
+
+    size = writerP->size * 2;
+    while (size - writerP->length < length) size *= 2;
+
+    bufferP = (uint8_t *)lwm2m_malloc(size);
+    if (bufferP == NULL) return false;
+    memcpy(bufferP, writerP->buffer, writerP->length);
+    lwm2m_free(writerP->buffer);
+    writerP->buffer = bufferP;
+    writerP->size = size;
+
+    return true;
+}
+
+static bool prv_write(_writer_t * writerP,
+                      const void * data,
+                      size_t length)
+{
+    if (!prv_reserve(writerP, length)) return false;
+
+    memcpy(writerP->buffer + writerP->length, data, length);
+    writerP->length += length;
+
+    return true;
+}
+
+// Upper bound of the length of the serialized resource
+static size_t prv_getItemMaxSize(lwm2m_data_t * tlvP,
+                                 size_t parentUriLen)
+{
+    size_t length;
+
+    length = JSON_RES_ITEM_URI_SIZE + parentUriLen + JSON_ID_MAX_SIZE;
+
+    switch (tlvP->type)
+    {
+    case LWM2M_TYPE_STRING:
+        length += JSON_ITEM_STRING_BEGIN_SIZE + tlvP->value.asBuffer.length + JSON_ITEM_STRING_END_SIZE;
+        break;
+
+    case LWM2M_TYPE_OPAQUE:
+        length += JSON_ITEM_STRING_BEGIN_SIZE + utils_base64GetSize(tlvP->value.asBuffer.length) + JSON_ITEM_STRING_END_SIZE;
+        break;
+
+    case LWM2M_TYPE_INTEGER:
+    case LWM2M_TYPE_FLOAT:
+        length += JSON_ITEM_NUM_SIZE + JSON_NUMBER_MAX_SIZE + JSON_ITEM_NUM_END_SIZE;
+        break;
+
+    case LWM2M_TYPE_BOOLEAN:
+        length += JSON_ITEM_BOOL_FALSE_SIZE;
+        break;
+
+    default:
+        break;
+    }
+
+    return length;
+}
+
 static int prv_serializeValue(lwm2m_data_t * tlvP,
                               uint8_t * buffer,
                               size_t bufferLen)
@@ -1139,17 +1217,14 @@ static int prv_serializeValue(lwm2m_data_t * tlvP,
     return head;
 }
 
-int prv_serializeData(lwm2m_data_t * tlvP,
-                      uint8_t * parentUriStr,
-                      size_t parentUriLen,
-                      uint8_t * buffer,
-                      size_t bufferLen)
+static bool prv_serializeData(lwm2m_data_t * tlvP,
+                              uint8_t * parentUriStr,
+                              size_t parentUriLen,
+                              _writer_t * writerP)
 {
     int head;
     int res;
 
-    head = 0;
-
     switch (tlvP->type)
     {
     case LWM2M_TYPE_OBJECT:
@@ -1162,7 +1237,7 @@ int prv_serializeData(lwm2m_data_t * tlvP,
 
         if (parentUriLen > 0)
         {
-            if (URI_MAX_STRING_LEN < parentUriLen) return -1;
+            if (URI_MAX_STRING_LEN < parentUriLen) return false;
             memcpy(uriStr, parentUriStr, parentUriLen);
             uriLen = parentUriLen;
         }
@@ -1171,44 +1246,53 @@ int prv_serializeData(lwm2m_data_t * tlvP,
             uriLen = 0;
         }
         res = utils_intToText(tlvP->id, uriStr + uriLen, URI_MAX_STRING_LEN - uriLen);
-        if (res <= 0) return -1;
+        if (res <= 0) return false;
         uriLen += res;
         uriStr[uriLen] = '/';
         uriLen++;
 
-        head = 0;
         for (index = 0 ; index < tlvP->value.asChildren.count; index++)
         {
-            res = prv_serializeData(tlvP->value.asChildren.array + index, uriStr, uriLen, buffer + head, bufferLen - head);
-            if (res < 0) return -1;
-            head += res;
+            if (!prv_serializeData(tlvP->value.asChildren.array + index, uriStr, uriLen, writerP)) return false;
         }
     }
     break;
 
     default:
-        if (bufferLen < JSON_RES_ITEM_URI_SIZE) return -1;
+    {
+        uint8_t * buffer;
+        size_t bufferLen;
+
+        // the item is written in place once the buffer is large enough for it
+        if (!prv_reserve(writerP, prv_getItemMaxSize(tlvP, parentUriLen))) return false;
+        buffer = writerP->buffer + writerP->length;
+        bufferLen = writerP->size - writerP->length;
+
+        if (bufferLen < JSON_RES_ITEM_URI_SIZE) return false;
         memcpy(buffer, JSON_RES_ITEM_URI, JSON_RES_ITEM_URI_SIZE);
         head = JSON_RES_ITEM_URI_SIZE;
 
         if (parentUriLen > 0)
         {
-            if (bufferLen - head < parentUriLen) return -1;
+            if (bufferLen - head < parentUriLen) return false;
             memcpy(buffer + head, parentUriStr, parentUriLen);
             head += parentUriLen;
         }
 
         res = utils_intToText(tlvP->id, buffer + head, bufferLen - head);
-        if (res <= 0) return -1;
+        if (res <= 0) return false;
         head += res;
 
         res = prv_serializeValue(tlvP, buffer + head, bufferLen - head);
-        if (res < 0) return -1;
+        if (res < 0) return false;
         head += res;
-        break;
+
+        writerP->length += head;
+    }
+    break;
     }
 
-    return head;
+    return true;
 }
 
 static int prv_findAndCheckData(lwm2m_uri_t * uriP,
@@ -1359,8 +1443,8 @@ int json_serialize(lwm2m_uri_t * uriP,
                    uint8_t ** bufferP)
 {
     int index;
-    size_t head;
-    uint8_t bufferJSON[PRV_JSON_BUFFER_SIZE];
+    _writer_t writer;
+    bool success;
     uint8_t baseUriStr[URI_MAX_STRING_LEN];
     int baseUriLen;
     uri_depth_t rootLevel;
@@ -1385,51 +1469,48 @@ int json_serialize(lwm2m_uri_t * uriP,
         int res;
 
         res = utils_intToText(targetP->id, baseUriStr + baseUriLen, URI_MAX_STRING_LEN - baseUriLen);
-        if (res <= 0) return 0;
+        if (res <= 0) return -1;
         baseUriLen += res;
-        if (baseUriLen >= URI_MAX_STRING_LEN -1) return 0;
+        if (baseUriLen >= URI_MAX_STRING_LEN -1) return -1;
         num = targetP->value.asChildren.count;
         targetP = targetP->value.asChildren.array;
         baseUriStr[baseUriLen] = '/';
         baseUriLen++;
     }
 
+    // the output is written in place in the returned buffer
+    writer.buffer = (uint8_t *)lwm2m_malloc(PRV_JSON_BUFFER_SIZE);
+    if (writer.buffer == NULL) return -1;
+    writer.size = PRV_JSON_BUFFER_SIZE;
+    writer.length = 0;
+
     if (baseUriLen > 0)
     {
-        memcpy(bufferJSON, JSON_BN_HEADER_1, JSON_BN_HEADER_1_SIZE);
-        head = JSON_BN_HEADER_1_SIZE;
-        memcpy(bufferJSON + head, baseUriStr, baseUriLen);
-        head += baseUriLen;
-        memcpy(bufferJSON + head, JSON_BN_HEADER_2, JSON_BN_HEADER_2_SIZE);
-        head += JSON_BN_HEADER_2_SIZE;
+        success = prv_write(&writer, JSON_BN_HEADER_1, JSON_BN_HEADER_1_SIZE)
+               && prv_write(&writer, baseUriStr, baseUriLen)
+               && prv_write(&writer, JSON_BN_HEADER_2, JSON_BN_HEADER_2_SIZE);
     }
     else
     {
-        memcpy(bufferJSON, JSON_HEADER, JSON_HEADER_SIZE);
-        head = JSON_HEADER_SIZE;
+        success = prv_write(&writer, JSON_HEADER, JSON_HEADER_SIZE);
     }
 
-    for (index = 0 ; index < num && head < PRV_JSON_BUFFER_SIZE ; index++)
+    for (index = 0 ; index < num && success ; index++)
     {
-        int res;
-
-        res = prv_serializeData(targetP + index, NULL, 0, bufferJSON + head, PRV_JSON_BUFFER_SIZE - head);
-        if (res < 0) return 0;
-        head += res;
+        success = prv_serializeData(targetP + index, NULL, 0, &writer);
     }
 
-    if (head + JSON_FOOTER_SIZE - 1 > PRV_JSON_BUFFER_SIZE) return 0;
-
-    if (num > 0) head = head - 1;
-
-    memcpy(bufferJSON + head, JSON_FOOTER, JSON_FOOTER_SIZE);
-    head = head + JSON_FOOTER_SIZE;
+    // the separator after the last item is replaced by the footer
+    if (num > 0) writer.length--;
 
-    *bufferP = (uint8_t *)lwm2m_malloc(head);
-    if (*bufferP == NULL) return 0;
-    memcpy(*bufferP, bufferJSON, head);
+    if (!success || !prv_write(&writer, JSON_FOOTER, JSON_FOOTER_SIZE))
+    {
+        lwm2m_free(writer.buffer);
+        return -1;
+    }
 
-    return head;
+    *bufferP = writer.buffer;
+    return (int)writer.length;
 }
 
 #endif
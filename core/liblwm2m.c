@@ -74,6 +74,13 @@ lwm2m_context_t * lwm2m_init(void * userData)
     if (NULL != contextP)
     {
         memset(contextP, 0, sizeof(lwm2m_context_t));
+        contextP->packetStateP = (lwm2m_packet_state_t *)lwm2m_malloc(sizeof(lwm2m_packet_state_t));
+        if (NULL == contextP->packetStateP)
+        {
+            lwm2m_free(contextP);
+            return NULL;
+        }
+        memset(contextP->packetStateP, 0, sizeof(lwm2m_packet_state_t));
         contextP->userData = userData;
 #ifdef LEGATO_EMBEDDED
         uint16_t randBuf;
@@ -111,12 +118,12 @@ bool lwm2m_deregister(lwm2m_context_t * context)
     return result;
 }
 
-static void prv_deleteServer(lwm2m_server_t * serverP, void *userData)
+static void prv_deleteServer(lwm2m_context_t * contextP, lwm2m_server_t * serverP)
 {
     // TODO parse transaction and observation to remove the ones related to this server
     if (serverP->sessionH != NULL)
     {
-         lwm2m_close_connection(serverP->sessionH, userData);
+         lwm2m_close_connection(serverP->sessionH, contextP->userData);
     }
     if (NULL != serverP->location)
     {
@@ -124,7 +131,7 @@ static void prv_deleteServer(lwm2m_server_t * serverP, void *userData)
     }
 #if SIERRA
         coap_end_block1_stream(&serverP->block1Data, NULL, 0);
-        coap_end_block2_stream();
+        coap_end_block2_stream(contextP);
 #else
         free_block1_buffer(serverP->block1Data);
 #endif
@@ -138,7 +145,7 @@ static void prv_deleteServerList(lwm2m_context_t * context)
         lwm2m_server_t * server;
         server = context->serverList;
         context->serverList = server->next;
-        prv_deleteServer(server, context->userData);
+        prv_deleteServer(context, server);
     }
 }
 
@@ -167,6 +174,9 @@ static void prv_deleteBootstrapServerList(lwm2m_context_t * context)
 
 static void prv_deleteObservedList(lwm2m_context_t * contextP)
 {
+    observe_freeIndex(contextP);
+    deadline_free(&contextP->watcherDeadlines);
+    contextP->observedDirty = NULL;
     while (NULL != contextP->observedList)
     {
         lwm2m_observed_t * targetP;
@@ -188,6 +198,8 @@ static void prv_deleteObservedList(lwm2m_context_t * contextP)
 
 void prv_deleteTransactionList(lwm2m_context_t * context)
 {
+    // the deadline heap still references the transactions
+    transaction_freeIndex(context);
     while (NULL != context->transactionList)
     {
         lwm2m_transaction_t * transaction;
@@ -198,6 +210,13 @@ void prv_deleteTransactionList(lwm2m_context_t * context)
     }
 }
 
+static void prv_deleteContext(lwm2m_context_t * contextP)
+{
+    prv_deleteTransactionList(contextP);
+    lwm2m_free(contextP->packetStateP);
+    lwm2m_free(contextP);
+}
+
 bool lwm2m_close(lwm2m_context_t * contextP)
 {
 #ifdef LWM2M_CLIENT_MODE
@@ -220,26 +239,18 @@ bool lwm2m_close(lwm2m_context_t * contextP)
         lwm2m_free(contextP->altPath);
     }
 #if SIERRA
-    lwm2m_end_push();
+    lwm2m_end_push(contextP);
 #endif /* SIERRA */
 
-    prv_deleteTransactionList(contextP);
-    lwm2m_free(contextP);
+    prv_deleteContext(contextP);
     return true;
 #endif /* !LWM2M_DEREGISTER */
 
 #endif /* LWM2M_CLIENT_MODE */
 
 #ifdef LWM2M_SERVER_MODE
-    while (NULL != contextP->clientList)
-    {
-        lwm2m_client_t * clientP;
-
-        clientP = contextP->clientList;
-        contextP->clientList = contextP->clientList->next;
-
-        registration_freeClient(clientP);
-    }
+    registration_freeClientList(contextP);
+    prv_deleteContext(contextP);
     return true;
 #endif
 }
@@ -263,32 +274,19 @@ void lwm2m_followClosure(lwm2m_context_t * contextP)
         lwm2m_free(contextP->altPath);
     }
 #if SIERRA
-    lwm2m_end_push();
+    lwm2m_end_push(contextP);
 #endif
 
     /* Notify that the connection is stopped */
     smanager_SendSessionEvent(EVENT_SESSION, EVENT_STATUS_DONE_SUCCESS, contextP);
-    prv_deleteTransactionList(contextP);
-    lwm2m_free(contextP);
 
 #endif
 
 #ifdef LWM2M_SERVER_MODE
-    while (NULL != contextP->clientList)
-    {
-        lwm2m_client_t * clientP;
-
-        clientP = contextP->clientList;
-        contextP->clientList = contextP->clientList->next;
-
-        registration_freeClient(clientP);
-    }
+    registration_freeClientList(contextP);
 #endif
 
-#ifndef LWM2M_DEREGISTER
-    prv_deleteTransactionList(contextP);
-    lwm2m_free(contextP);
-#endif
+    prv_deleteContext(contextP);
 }
 
 #ifdef LWM2M_CLIENT_MODE
@@ -314,7 +312,7 @@ static int prv_refreshServerList(lwm2m_context_t * contextP)
         else
         {
             LOG_ARG("Deleting BS server %d", targetP->shortID);
-            prv_deleteServer(targetP, contextP->userData);
+            prv_deleteServer(contextP, targetP);
         }
         targetP = nextP;
     }
@@ -333,7 +331,7 @@ static int prv_refreshServerList(lwm2m_context_t * contextP)
         else
         {
             LOG_ARG("Deleting DM server %d", targetP->shortID);
-            prv_deleteServer(targetP, contextP->userData);
+            prv_deleteServer(contextP, targetP);
         }
         targetP = nextP;
     }
@@ -470,13 +468,27 @@ int lwm2m_remove_object(lwm2m_context_t * contextP,
 int lwm2m_step(lwm2m_context_t * contextP,
                time_t * timeoutP)
 {
-    time_t tv_sec;
+    int64_t timeoutMs;
+    int result;
+
+    timeoutMs = (int64_t)*timeoutP * MS_PER_SECOND;
+    result = lwm2m_step_ms(contextP, &timeoutMs);
+    // round up so that the caller does not wake up before the next deadline
+    *timeoutP = (time_t)((timeoutMs + MS_PER_SECOND - 1) / MS_PER_SECOND);
+
+    return result;
+}
+
+int lwm2m_step_ms(lwm2m_context_t * contextP,
+                  int64_t * timeoutP)
+{
+    int64_t currentTime;
     int result;
 
-    LOG_ARG("timeoutP: %" PRId64, *timeoutP);
-    tv_sec = lwm2m_gettime();
+    LOG_ARG("timeoutP: %" PRId64 " ms", *timeoutP);
+    currentTime = utils_gettimeMs();
 
-    if ((int32_t)tv_sec < 0)
+    if (currentTime < 0)
     {
         return COAP_500_INTERNAL_SERVER_ERROR;
     }
@@ -518,7 +530,7 @@ next_step:
 #endif
             bootstrap_start(contextP);
             contextP->state = STATE_BOOTSTRAPPING;
-            bootstrap_step(contextP, tv_sec, timeoutP);
+            bootstrap_step(contextP, currentTime, timeoutP);
 #if SIERRA
             LOG_ARG ("STATE_BOOTSTRAP_REQUIRED -> %s", STR_STATE(contextP->state));
 #endif
@@ -558,7 +570,7 @@ next_step:
 
         default:
             // keep on waiting
-            bootstrap_step(contextP, tv_sec, timeoutP);
+            bootstrap_step(contextP, currentTime, timeoutP);
             break;
         }
         break;
@@ -654,13 +666,13 @@ next_step:
         break;
     }
 
-    observe_step(contextP, tv_sec, timeoutP);
+    observe_step(contextP, currentTime, timeoutP);
 #endif
 
-    registration_step(contextP, tv_sec, timeoutP);
-    transaction_step(contextP, tv_sec, timeoutP);
+    registration_step(contextP, currentTime, timeoutP);
+    transaction_step(contextP, currentTime, timeoutP);
 
-    LOG_ARG("Final timeoutP: %" PRId64, *timeoutP);
+    LOG_ARG("Final timeoutP: %" PRId64 " ms", *timeoutP);
 #ifdef LWM2M_CLIENT_MODE
     LOG_ARG("Final state: %s", STR_STATE(contextP->state));
 #endif
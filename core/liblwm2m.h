@@ -108,6 +108,16 @@ int lwm2m_strncmp(const char * s1, const char * s2, size_t n);
 // In case of error, this must return a negative value.
 // Per POSIX specifications, time_t is a signed integer.
 time_t lwm2m_gettime(void);
+#ifdef LWM2M_WITH_MS_CLOCK
+// This function must return the number of milliseconds elapsed since origin
+// on a monotonic clock. When LWM2M_WITH_MS_CLOCK is defined, it replaces
+// lwm2m_gettime() as the time base of all the library timers. Otherwise these
+// timers have a resolution of one second.
+// The dates given to the application, lwm2m_server_t::registration and
+// lwm2m_client_t::endOfLife, stay in seconds of lwm2m_gettime().
+// In case of error, this must return a negative value.
+int64_t lwm2m_gettime_ms(void);
+#endif
 
 #ifdef LWM2M_WITH_LOGS
 // Same usage as C89 printf()
@@ -131,6 +141,22 @@ void lwm2m_close_connection(void * sessionH, void * userData);
 // buffer, length: data to send
 // userData: parameter to lwm2m_init()
 uint8_t lwm2m_buffer_send(void * sessionH, uint8_t * buffer, size_t length, void * userData, bool firstBlock);
+// Scatter-gather element for lwm2m_buffer_sendv()
+typedef struct
+{
+    uint8_t * buffer;
+    size_t    length;
+} lwm2m_iovec_t;
+#ifdef LWM2M_WITH_SENDV
+// Send to a peer the concatenation of count buffers as a single datagram.
+// When LWM2M_WITH_SENDV is defined, this replaces lwm2m_buffer_send() for messages which are not
+// retransmitted, so that their payload is never copied.
+// Returns COAP_NO_ERROR or a COAP_NNN error code
+// sessionH: session handle identifying the peer (opaque to the core)
+// vector, count: buffers to send, in order
+// userData: parameter to lwm2m_init()
+uint8_t lwm2m_buffer_sendv(void * sessionH, const lwm2m_iovec_t * vector, size_t count, void * userData, bool firstBlock);
+#endif
 // Compare two session handles
 // Returns true if the two sessions identify the same peer. false otherwise.
 // userData: parameter to lwm2m_init()
@@ -300,6 +326,41 @@ void lwm2m_list_free(lwm2m_list_t * head);
 #define LWM2M_LIST_FIND(H,I) lwm2m_list_find((lwm2m_list_t *)H, I)
 #define LWM2M_LIST_FREE(H) lwm2m_list_free((lwm2m_list_t *)H)
 
+/*
+ * Deadline min-heap
+ *
+ * lwm2m_deadline_t is embedded in the structures to schedule. position is the
+ * 1-based index of the node in the heap, 0 when the node is not scheduled.
+ * next chains the nodes returned by an expiry.
+ */
+typedef struct _lwm2m_deadline_
+{
+    int64_t                   deadline;     // in ms
+    size_t                    position;
+    struct _lwm2m_deadline_ * next;
+} lwm2m_deadline_t;
+
+typedef struct
+{
+    lwm2m_deadline_t ** nodes;
+    size_t              size;
+    size_t              count;
+} lwm2m_deadline_heap_t;
+
+/*
+ * Hash index
+ *
+ * Open-addressed hash table (linear probing) of pointers, used to find the
+ * transactions and the registered clients of a context. size is a power of two,
+ * or 0 until the first insertion.
+ */
+typedef struct
+{
+    void ** slots;
+    size_t  size;
+    size_t  count;
+} lwm2m_hash_index_t;
+
 /*
  * URI
  *
@@ -323,6 +384,7 @@ typedef struct
     uint16_t    objectId;
     uint16_t    instanceId;
     uint16_t    resourceId;
+    uint32_t    registrationId; // for internal use only, the ID of a registration URI /rd/<id>
 } lwm2m_uri_t;
 
 
@@ -530,6 +592,9 @@ struct _lwm2m_block1_data_
     uint16_t              lastmid;          // mid of the last message received
     uint32_t              block1Num;        // block1 number
     uint16_t              block1Size;        // block1 size
+    uint8_t *             recordsBuffer;    // for internal use only, complete TLV records of the last block when they had to be copied
+    size_t                recordSize;       // for internal use only, length of the TLV record split over blocks, 0 until its header is complete
+    size_t                receivedSize;     // for internal use only, bytes of the TLV transfer received so far
 };
 
 typedef struct _lwm2m_server_
@@ -546,6 +611,12 @@ typedef struct _lwm2m_server_
     bool                    dirty;
     uint8_t                 regUpdateOptions; // bitmap of parameters to be sent in a registration update message
     lwm2m_block1_data_t *   block1Data;   // buffer to handle block1 data, should be replace by a list to support several block1 transfer by server.
+    uint8_t                 notifyMaxPending; // confirmable notifications waiting for an ACK at most, 0 to send them non confirmable
+    uint8_t                 notifyPending;    // for internal use only
+    struct _lwm2m_watcher_ * notifyBlocked;   // for internal use only, watchers waiting for one of the pending notifications to complete
+    uint32_t                notifyCollapsed;  // notifications replaced by a newer value before being sent or acknowledged
+    uint32_t                notifyDropped;    // observations cancelled as their confirmable notification was never acknowledged
+    int64_t                 registrationMs;   // for internal use only, registration on the clock of the library timers, in ms
 } lwm2m_server_t;
 
 
@@ -554,7 +625,7 @@ typedef struct _lwm2m_server_
  *
  * When used with an observe, if 'data' is not nil, 'status' holds the observe counter.
  */
-typedef void (*lwm2m_result_callback_t) (uint16_t clientID, lwm2m_uri_t * uriP, int status, lwm2m_media_type_t format, uint8_t * data, int dataLength, void * userData);
+typedef void (*lwm2m_result_callback_t) (uint32_t clientID, lwm2m_uri_t * uriP, int status, lwm2m_media_type_t format, uint8_t * data, int dataLength, void * userData);
 
 /*
  * LWM2M Observations
@@ -565,6 +636,8 @@ typedef void (*lwm2m_result_callback_t) (uint16_t clientID, lwm2m_uri_t * uriP,
  * status STATE_DEREG_PENDING means the user canceled the request before the client answered it.
  */
 
+typedef struct _lwm2m_observation_table_ lwm2m_observation_table_t;
+
 typedef struct _lwm2m_observation_
 {
     struct _lwm2m_observation_ * next;  // matches lwm2m_list_t::next
@@ -574,8 +647,32 @@ typedef struct _lwm2m_observation_
     lwm2m_status_t          status;
     lwm2m_result_callback_t callback;
     void *                  userData;
+    lwm2m_observation_table_t * tableP; // for internal use only, holding the slot
+    uint32_t                slot;       // for internal use only
 } lwm2m_observation_t;
 
+/*
+ * LWM2M observation table
+ *
+ * Slab of the observations of a context, indexed by the slot number carried in
+ * their token. The generation of a slot changes each time the slot is released,
+ * so the token of a removed observation does not match the next one in the slot.
+ */
+typedef struct
+{
+    lwm2m_observation_t * observationP; // NULL when the slot is free
+    uint32_t              generation;
+    uint32_t              nextFree;     // when the slot is free
+} lwm2m_observation_slot_t;
+
+struct _lwm2m_observation_table_
+{
+    lwm2m_observation_slot_t * slots;
+    uint32_t                   size;
+    uint32_t                   count;
+    uint32_t                   firstFree;   // size when no slot is free
+};
+
 /*
  * LWM2M Link Attributes
  *
@@ -608,17 +705,27 @@ typedef struct
  *
  */
 
-typedef struct _lwm2m_client_object_
+typedef struct
 {
-    struct _lwm2m_client_object_ * next; // matches lwm2m_list_t::next
-    uint16_t                 id;         // matches lwm2m_list_t::id
-    lwm2m_list_t *           instanceList;
+    uint16_t    id;
+    uint16_t    instanceCount;  // 0 when the object was registered without instance
+    uint16_t *  instances;      // instance IDs, sorted
 } lwm2m_client_object_t;
 
+/*
+ * Objects registered by a client, sorted by ID. The list, its objects and
+ * their instance IDs are packed in a single allocation.
+ */
+typedef struct
+{
+    size_t                  count;
+    lwm2m_client_object_t * objects;
+} lwm2m_client_object_list_t;
+
 typedef struct _lwm2m_client_
 {
-    struct _lwm2m_client_ * next;       // matches lwm2m_list_t::next
-    uint16_t                internalID; // matches lwm2m_list_t::id
+    struct _lwm2m_client_ * next;
+    uint32_t                internalID; // also the ID of the location path /rd/<internalID>
     char *                  name;
     lwm2m_binding_t         binding;
     char *                  msisdn;
@@ -627,10 +734,30 @@ typedef struct _lwm2m_client_
     uint32_t                lifetime;
     time_t                  endOfLife;
     void *                  sessionH;
-    lwm2m_client_object_t * objectList;
+    lwm2m_client_object_list_t * objectList;
     lwm2m_observation_t *   observationList;
+    struct _lwm2m_client_ * prev;       // for internal use only
+    uint32_t                nameHash;   // for internal use only
+    lwm2m_deadline_t        expiry;     // for internal use only, at endOfLife
+    uint64_t                payloadHash;    // for internal use only, of the payload which gave objectList
 } lwm2m_client_t;
 
+/*
+ * LWM2M client ID allocator
+ *
+ * Two-level bitmap of the internal IDs in use. A bit of 'full' is set when
+ * the matching word of 'used' has no clear bit, so the lowest free ID is
+ * found without visiting the words already full.
+ */
+typedef struct
+{
+    uint32_t * used;
+    uint32_t * full;
+    size_t     size;        // IDs covered, a multiple of 1024
+    size_t     count;       // IDs in use
+    size_t     firstFree;   // the words of full before this one have all their bits set
+} lwm2m_client_id_map_t;
+
 
 /*
  * LWM2M transaction
@@ -646,11 +773,14 @@ struct _lwm2m_transaction_
 {
     lwm2m_transaction_t * next;  // matches lwm2m_list_t::next
     uint16_t              mID;   // matches lwm2m_list_t::id
+    lwm2m_transaction_t * prev;  // for internal use only.
     void *                peerH;
     uint8_t               ack_received; // indicates, that the ACK was received
     time_t                response_timeout; // timeout to wait for response, if token is used. When 0, use calculated acknowledge timeout.
     uint8_t  retrans_counter;
-    time_t   retrans_time;
+    int64_t  retrans_time;  // in ms
+    uint32_t ack_timeout;   // initial retransmission timeout in ms, randomized as per RFC 7252
+    lwm2m_deadline_t retrans_deadline; // for internal use only.
     void * message;
     uint16_t buffer_len;
     uint8_t * buffer;
@@ -672,7 +802,7 @@ typedef struct _lwm2m_watcher_
     lwm2m_media_type_t format;
     uint8_t token[8];
     size_t tokenLen;
-    time_t lastTime;
+    int64_t lastTime;   // in ms
     uint32_t counter;
     uint16_t lastMid;
     union
@@ -680,6 +810,12 @@ typedef struct _lwm2m_watcher_
         int64_t asInteger;
         double  asFloat;
     } lastValue;
+    struct _lwm2m_observed_ * observedP;    // for internal use only
+    lwm2m_deadline_t deadline;  // for internal use only, at the end of the pending pmin or of pmax
+    lwm2m_transaction_t * pendingP;         // for internal use only, confirmable notification waiting for an ACK
+    struct _lwm2m_watcher_ * blockedNext;   // for internal use only, in the notifyBlocked list of the server
+    bool blocked;   // for internal use only, the server has too many notifications pending
+    struct _lwm2m_context_ * contextP;      // for internal use only, to cancel the watcher when its notification times out
 } lwm2m_watcher_t;
 
 typedef struct _lwm2m_observed_
@@ -688,8 +824,25 @@ typedef struct _lwm2m_observed_
 
     lwm2m_uri_t uri;
     lwm2m_watcher_t * watcherList;
+    struct _lwm2m_observed_ * dirtyNext;    // for internal use only
+    bool dirty;     // for internal use only, in the dirty set of the context
 } lwm2m_observed_t;
 
+/*
+ * Index of the observed resources by path. The root holds the observed objects,
+ * an object node its observed instances and an instance node its observed
+ * resources, each sorted by ID. A node exists as long as its path or a path
+ * below it is observed.
+ */
+typedef struct _lwm2m_observed_node_
+{
+    uint16_t                       id;
+    lwm2m_observed_t *             observedP;   // observation of this exact path, or NULL
+    struct _lwm2m_observed_node_ * children;    // sorted by id
+    uint32_t                       childCount;
+    uint32_t                       childSize;
+} lwm2m_observed_node_t;
+
 #ifdef LWM2M_CLIENT_MODE
 
 typedef enum
@@ -718,7 +871,19 @@ typedef enum
 typedef int (*lwm2m_bootstrap_callback_t) (void * sessionH, uint8_t status, lwm2m_uri_t * uriP, char * name, void * userData);
 #endif
 
-typedef struct
+/*
+ * Size of the per-context buffer in which the headers of outgoing messages are serialized.
+ * Without LWM2M_WITH_SENDV, messages whose header and payload fit in it are also sent from it.
+ * The default holds a header and a payload of the default REST_MAX_CHUNK_SIZE.
+ */
+#ifndef LWM2M_SEND_BUFFER_SIZE
+#define LWM2M_SEND_BUFFER_SIZE 1152
+#endif
+
+// Per-context state of the packet layer, opaque to the application
+typedef struct _lwm2m_packet_state_ lwm2m_packet_state_t;
+
+typedef struct _lwm2m_context_
 {
 #ifdef LWM2M_CLIENT_MODE
     lwm2m_client_state_t state;
@@ -729,9 +894,22 @@ typedef struct
     lwm2m_server_t *     serverList;
     lwm2m_object_t *     objectList;
     lwm2m_observed_t *   observedList;
+    lwm2m_observed_node_t observedIndex;    // observedList by path
+    lwm2m_observed_t *   observedDirty;     // to check at the next step, not sorted
+    lwm2m_observed_t *   observedStepping;  // for internal use only, dirty observations left to check by the running step
+    lwm2m_observed_t *   observedCurrent;   // for internal use only, observation checked by the running step
+    lwm2m_watcher_t *    watcherCurrent;    // for internal use only, watcher checked by the running step
+    lwm2m_watcher_t *    watcherNext;       // for internal use only, next watcher to check by the running step
+    lwm2m_deadline_heap_t watcherDeadlines; // watchers ordered by their next pmin or pmax expiry
 #endif
 #ifdef LWM2M_SERVER_MODE
-    lwm2m_client_t *        clientList;
+    lwm2m_client_t *        clientList;         // not sorted, the last registered client first
+    lwm2m_hash_index_t      clientById;         // registered clients keyed by internalID
+    lwm2m_hash_index_t      clientByName;       // registered clients keyed by endpoint name
+    lwm2m_hash_index_t      clientBySession;    // registered clients keyed by sessionH
+    lwm2m_client_id_map_t   clientIds;
+    lwm2m_deadline_heap_t   clientDeadlines;    // registered clients ordered by endOfLife
+    lwm2m_observation_table_t observations;     // observations of the registered clients by token slot
     lwm2m_result_callback_t monitorCallback;
     void *                  monitorUserData;
 #endif
@@ -741,6 +919,11 @@ typedef struct
 #endif
     uint16_t                nextMID;
     lwm2m_transaction_t *   transactionList;
+    lwm2m_hash_index_t      transactionByMid;     // in-flight transactions keyed by message ID
+    lwm2m_hash_index_t      transactionByToken;   // in-flight transactions keyed by token
+    lwm2m_deadline_heap_t   transactionDeadlines; // in-flight transactions ordered by retrans_time
+    uint8_t                 sendBuffer[LWM2M_SEND_BUFFER_SIZE]; // outgoing CoAP headers, for internal use only.
+    lwm2m_packet_state_t *  packetStateP; // for internal use only.
     void *                  userData;
 } lwm2m_context_t;
 
@@ -753,6 +936,8 @@ void lwm2m_followClosure(lwm2m_context_t * contextP);
 
 // perform any required pending operation and adjust timeoutP to the maximal time interval to wait in seconds.
 int lwm2m_step(lwm2m_context_t * contextP, time_t * timeoutP);
+// same as lwm2m_step() with timeoutP in milliseconds.
+int lwm2m_step_ms(lwm2m_context_t * contextP, int64_t * timeoutP);
 // dispatch received data to liblwm2m
 void lwm2m_handle_packet(lwm2m_context_t * contextP, uint8_t * buffer, int length, void * fromSessionH);
 
@@ -770,6 +955,11 @@ int lwm2m_remove_object(lwm2m_context_t * contextP, uint16_t id);
 // If withObjects is true, the registration update contains the object list.
 int lwm2m_update_registration(lwm2m_context_t * contextP, uint16_t shortServerID, uint8_t regUpdateOptions);
 
+// send the notifications to the server specified by the server short identifier, or to all if the ID is 0,
+// as confirmable messages with at most maxPending of them waiting for an ACK, or as non confirmable if 0.
+// A newer value replaces a notification not acknowledged yet instead of being queued behind it.
+int lwm2m_set_notification_mode(lwm2m_context_t * contextP, uint16_t shortServerID, uint8_t maxPending);
+
 void lwm2m_resource_value_changed(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
 
 bool lwm2m_acl_deleteObjectInstance(lwm2m_object_t * objectP, uint16_t oiid);
@@ -783,9 +973,9 @@ int lwm2m_data_push(lwm2m_context_t * contextP,
                     uint16_t * midP
                     );
 
-void lwm2m_end_push(void);
+void lwm2m_end_push(lwm2m_context_t * contextP);
 
-void lwm2m_set_push_callback(lwm2m_push_ack_callback_t callbackP);
+void lwm2m_set_push_callback(lwm2m_context_t * contextP, lwm2m_push_ack_callback_t callbackP);
 
 bool lwm2m_async_response(lwm2m_context_t * contextP,
                           uint16_t shortServerId,
@@ -836,18 +1026,24 @@ bool lwm2m_send_empty_response(lwm2m_context_t * contextP,
 // The lwm2m_client_t is present in the lwm2m_context_t's clientList when the callback is called. On a deregistration, it deleted when the callback returns.
 void lwm2m_set_monitoring_callback(lwm2m_context_t * contextP, lwm2m_result_callback_t callback, void * userData);
 
+// Registered client with this internal ID, endpoint name or session handle, NULL if none. These take constant time.
+// A client is found by the sessionH pointer of its last Register or Update, not through lwm2m_session_is_equal().
+lwm2m_client_t * lwm2m_get_client(lwm2m_context_t * contextP, uint32_t clientID);
+lwm2m_client_t * lwm2m_get_client_by_name(lwm2m_context_t * contextP, const char * name);
+lwm2m_client_t * lwm2m_get_client_by_session(lwm2m_context_t * contextP, void * sessionH);
+
 // Device Management APIs
-int lwm2m_dm_read(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_discover(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_write(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_write_attributes(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_attributes_t * attrP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_execute(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_create(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_delete(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_read(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_discover(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_write(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_write_attributes(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_attributes_t * attrP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_execute(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_create(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_delete(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 
 // Information Reporting APIs
-int lwm2m_observe(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_observe_cancel(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_observe(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_observe_cancel(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 #endif
 
 #ifdef LWM2M_BOOTSTRAP_SERVER_MODE
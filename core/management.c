@@ -251,12 +251,33 @@ uint8_t dm_handleRequest(lwm2m_context_t * contextP,
             }
             else
             {
+                uint32_t block_num = 0;
+                uint16_t block_size = REST_MAX_CHUNK_SIZE;
+                uint32_t block_offset = 0;
+                bool isBlock;
+                size_t total;
+
                 if (IS_OPTION(message, COAP_OPTION_ACCEPT))
                 {
                     format = utils_convertMediaType((coap_content_type_t)message->accept[0]);
                 }
 
-                result = object_read(contextP, uriP, &format, &buffer, &length);
+                // only the requested block is serialized, the payload is not sliced again in packet.c
+                isBlock = coap_get_header_block2(message, &block_num, NULL, &block_size, &block_offset) != 0;
+                block_size = MIN(block_size, REST_MAX_CHUNK_SIZE);
+
+                result = object_readBlock(contextP, uriP, &format, block_offset, block_size, &buffer, &length, &total);
+                if (COAP_205_CONTENT == result)
+                {
+                    if (isBlock && block_offset >= total)
+                    {
+                        result = COAP_402_BAD_OPTION;
+                    }
+                    else if (isBlock || total > block_size)
+                    {
+                        coap_set_header_block2(response, block_num, block_offset + length < total, block_size);
+                    }
+                }
             }
             if (COAP_205_CONTENT == result)
             {
@@ -500,7 +521,7 @@ static void prv_resultCallback(lwm2m_transaction_t * transacP,
 }
 
 static int prv_makeOperation(lwm2m_context_t * contextP,
-                             uint16_t clientID,
+                             uint32_t clientID,
                              lwm2m_uri_t * uriP,
                              coap_method_t method,
                              lwm2m_media_type_t format,
@@ -513,7 +534,7 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transaction;
     dm_data_t * dataP;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = lwm2m_get_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, method, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
@@ -547,13 +568,11 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
         transaction->userData = (void *)dataP;
     }
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     return transaction_send(contextP, transaction);
 }
 
 int lwm2m_dm_read(lwm2m_context_t * contextP,
-                  uint16_t clientID,
+                  uint32_t clientID,
                   lwm2m_uri_t * uriP,
                   lwm2m_result_callback_t callback,
                   void * userData)
@@ -561,10 +580,10 @@ int lwm2m_dm_read(lwm2m_context_t * contextP,
     lwm2m_client_t * clientP;
     lwm2m_media_type_t format;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = lwm2m_get_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     if (clientP->supportJSON == true)
@@ -584,7 +603,7 @@ int lwm2m_dm_read(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_write(lwm2m_context_t * contextP,
-                   uint16_t clientID,
+                   uint32_t clientID,
                    lwm2m_uri_t * uriP,
                    lwm2m_media_type_t format,
                    uint8_t * buffer,
@@ -592,7 +611,7 @@ int lwm2m_dm_write(lwm2m_context_t * contextP,
                    lwm2m_result_callback_t callback,
                    void * userData)
 {
-    LOG_ARG("clientID: %d, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
+    LOG_ARG("clientID: %u, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
     LOG_URI(uriP);
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP)
      || length == 0)
@@ -617,7 +636,7 @@ int lwm2m_dm_write(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_execute(lwm2m_context_t * contextP,
-                     uint16_t clientID,
+                     uint32_t clientID,
                      lwm2m_uri_t * uriP,
                      lwm2m_media_type_t format,
                      uint8_t * buffer,
@@ -625,7 +644,7 @@ int lwm2m_dm_execute(lwm2m_context_t * contextP,
                      lwm2m_result_callback_t callback,
                      void * userData)
 {
-    LOG_ARG("clientID: %d, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
+    LOG_ARG("clientID: %u, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
     LOG_URI(uriP);
     if (!LWM2M_URI_IS_SET_RESOURCE(uriP))
     {
@@ -639,7 +658,7 @@ int lwm2m_dm_execute(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_create(lwm2m_context_t * contextP,
-                    uint16_t clientID,
+                    uint32_t clientID,
                     lwm2m_uri_t * uriP,
                     lwm2m_media_type_t format,
                     uint8_t * buffer,
@@ -647,7 +666,7 @@ int lwm2m_dm_create(lwm2m_context_t * contextP,
                     lwm2m_result_callback_t callback,
                     void * userData)
 {
-    LOG_ARG("clientID: %d, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
+    LOG_ARG("clientID: %u, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
     LOG_URI(uriP);
 
     if (LWM2M_URI_IS_SET_INSTANCE(uriP)
@@ -663,12 +682,12 @@ int lwm2m_dm_create(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_delete(lwm2m_context_t * contextP,
-                    uint16_t clientID,
+                    uint32_t clientID,
                     lwm2m_uri_t * uriP,
                     lwm2m_result_callback_t callback,
                     void * userData)
 {
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP)
      || LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -683,7 +702,7 @@ int lwm2m_dm_delete(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
-                              uint16_t clientID,
+                              uint32_t clientID,
                               lwm2m_uri_t * uriP,
                               lwm2m_attributes_t * attrP,
                               lwm2m_result_callback_t callback,
@@ -696,7 +715,7 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
     uint8_t buffer[_PRV_BUFFER_SIZE];
     size_t length;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
     if (attrP == NULL) return COAP_400_BAD_REQUEST;
 
@@ -705,7 +724,7 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
     if (ATTR_FLAG_NUMERIC == (attrP->toSet & ATTR_FLAG_NUMERIC)
      && (attrP->lessThan + 2 * attrP->step >= attrP->greaterThan)) return COAP_400_BAD_REQUEST;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = lwm2m_get_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, COAP_PUT, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
@@ -818,13 +837,11 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
         SET_OPTION(coap_pkt, COAP_OPTION_URI_QUERY);
     }
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     return transaction_send(contextP, transaction);
 }
 
 int lwm2m_dm_discover(lwm2m_context_t * contextP,
-                      uint16_t clientID,
+                      uint32_t clientID,
                       lwm2m_uri_t * uriP,
                       lwm2m_result_callback_t callback,
                       void * userData)
@@ -833,9 +850,9 @@ int lwm2m_dm_discover(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transaction;
     dm_data_t * dataP;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = lwm2m_get_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
@@ -860,8 +877,6 @@ int lwm2m_dm_discover(lwm2m_context_t * contextP,
         transaction->userData = (void *)dataP;
     }
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     return transaction_send(contextP, transaction);
 }
 
@@ -242,6 +242,46 @@ uint8_t object_read(lwm2m_context_t * contextP,
     return result;
 }
 
+uint8_t object_readBlock(lwm2m_context_t * contextP,
+                         lwm2m_uri_t * uriP,
+                         lwm2m_media_type_t * formatP,
+                         size_t offset,
+                         size_t blockSize,
+                         uint8_t ** bufferP,
+                         size_t * lengthP,
+                         size_t * totalP)
+{
+    uint8_t result;
+    lwm2m_data_t * dataP = NULL;
+    int size = 0;
+    int res;
+
+    LOG_URI(uriP);
+    LOG_ARG("offset: %u, blockSize: %u", offset, blockSize);
+
+    *lengthP = 0;
+    *totalP = 0;
+    result = object_readData(contextP, uriP, &size, &dataP);
+
+    if (result == COAP_205_CONTENT)
+    {
+        res = data_serializeBlock(uriP, size, dataP, formatP, offset, blockSize, bufferP, totalP);
+        if (res < 0)
+        {
+            result = COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        else
+        {
+            *lengthP = (size_t)res;
+        }
+    }
+    lwm2m_data_free(size, dataP);
+
+    LOG_ARG("result: %u.%2u, length: %d, total: %d", (result & 0xFF) >> 5, (result & 0x1F), *lengthP, *totalP);
+
+    return result;
+}
+
 uint8_t object_write(lwm2m_context_t * contextP,
                      lwm2m_uri_t * uriP,
                      lwm2m_media_type_t format,
@@ -52,22 +52,263 @@
 
 
 #ifdef LWM2M_CLIENT_MODE
+// Children allocated for a node at first, the array doubles when full
+#define OBSERVE_INDEX_MIN_SIZE  4
+
+// Binary search of a child, *positionP receives the position where it is or would be inserted
+static lwm2m_observed_node_t * prv_findChild(lwm2m_observed_node_t * nodeP,
+                                             uint16_t id,
+                                             uint32_t * positionP)
+{
+    uint32_t low = 0;
+    uint32_t high = nodeP->childCount;
+
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (nodeP->children[middle].id < id) low = middle + 1;
+        else high = middle;
+    }
+
+    if (positionP != NULL) *positionP = low;
+    if (low < nodeP->childCount && nodeP->children[low].id == id) return nodeP->children + low;
+
+    return NULL;
+}
+
+static lwm2m_observed_node_t * prv_getChild(lwm2m_observed_node_t * nodeP,
+                                            uint16_t id)
+{
+    lwm2m_observed_node_t * childP;
+    uint32_t position;
+
+    childP = prv_findChild(nodeP, id, &position);
+    if (childP != NULL) return childP;
+
+    if (nodeP->childCount == nodeP->childSize)
+    {
+        lwm2m_observed_node_t * children;
+        uint32_t size;
+
+        size = nodeP->childSize == 0 ? OBSERVE_INDEX_MIN_SIZE : nodeP->childSize * 2;
+        children = (lwm2m_observed_node_t *)lwm2m_malloc(size * sizeof(lwm2m_observed_node_t));
+        if (children == NULL) return NULL;
+        if (nodeP->children != NULL)
+        {
+            memcpy(children, nodeP->children, nodeP->childCount * sizeof(lwm2m_observed_node_t));
+            lwm2m_free(nodeP->children);
+        }
+        nodeP->children = children;
+        nodeP->childSize = size;
+    }
+
+    childP = nodeP->children + position;
+    memmove(childP + 1, childP, (nodeP->childCount - position) * sizeof(lwm2m_observed_node_t));
+    memset(childP, 0, sizeof(lwm2m_observed_node_t));
+    childP->id = id;
+    nodeP->childCount++;
+
+    return childP;
+}
+
+// Node of the exact path of uriP, NULL if neither this path nor a path below it is observed
+static lwm2m_observed_node_t * prv_findNode(lwm2m_context_t * contextP,
+                                            lwm2m_uri_t * uriP)
+{
+    lwm2m_observed_node_t * nodeP;
+
+    nodeP = prv_findChild(&contextP->observedIndex, uriP->objectId, NULL);
+    if (nodeP != NULL && LWM2M_URI_IS_SET_INSTANCE(uriP))
+    {
+        nodeP = prv_findChild(nodeP, uriP->instanceId, NULL);
+        if (nodeP != NULL && LWM2M_URI_IS_SET_RESOURCE(uriP))
+        {
+            nodeP = prv_findChild(nodeP, uriP->resourceId, NULL);
+        }
+    }
+
+    return nodeP;
+}
+
+static void prv_removeChild(lwm2m_observed_node_t * nodeP,
+                            lwm2m_observed_node_t * childP)
+{
+    uint32_t position = childP - nodeP->children;
+
+    if (childP->children != NULL) lwm2m_free(childP->children);
+    memmove(childP, childP + 1, (nodeP->childCount - position - 1) * sizeof(lwm2m_observed_node_t));
+    nodeP->childCount--;
+    if (nodeP->childCount == 0)
+    {
+        lwm2m_free(nodeP->children);
+        nodeP->children = NULL;
+        nodeP->childSize = 0;
+    }
+}
+
+// Remove the nodes of the path of uriP left without observation, from the deepest one
+static void prv_prunePath(lwm2m_context_t * contextP,
+                          lwm2m_uri_t * uriP)
+{
+    lwm2m_observed_node_t * path[4];
+    int depth;
+
+    path[0] = &contextP->observedIndex;
+    path[1] = prv_findChild(path[0], uriP->objectId, NULL);
+    depth = 1;
+    if (path[1] != NULL)
+    {
+        depth = 2;
+        if (LWM2M_URI_IS_SET_INSTANCE(uriP))
+        {
+            path[2] = prv_findChild(path[1], uriP->instanceId, NULL);
+            if (path[2] != NULL)
+            {
+                depth = 3;
+                if (LWM2M_URI_IS_SET_RESOURCE(uriP))
+                {
+                    path[3] = prv_findChild(path[2], uriP->resourceId, NULL);
+                    if (path[3] != NULL) depth = 4;
+                }
+            }
+        }
+    }
+
+    while (depth > 1
+        && path[depth - 1]->observedP == NULL
+        && path[depth - 1]->childCount == 0)
+    {
+        prv_removeChild(path[depth - 2], path[depth - 1]);
+        depth--;
+    }
+}
+
+static bool prv_indexObserved(lwm2m_context_t * contextP,
+                              lwm2m_observed_t * observedP)
+{
+    lwm2m_observed_node_t * nodeP;
+
+    nodeP = prv_getChild(&contextP->observedIndex, observedP->uri.objectId);
+    if (nodeP != NULL && LWM2M_URI_IS_SET_INSTANCE(&observedP->uri))
+    {
+        nodeP = prv_getChild(nodeP, observedP->uri.instanceId);
+        if (nodeP != NULL && LWM2M_URI_IS_SET_RESOURCE(&observedP->uri))
+        {
+            nodeP = prv_getChild(nodeP, observedP->uri.resourceId);
+        }
+    }
+    if (nodeP == NULL)
+    {
+        prv_prunePath(contextP, &observedP->uri);
+        return false;
+    }
+
+    nodeP->observedP = observedP;
+
+    return true;
+}
+
+static void prv_unindexObserved(lwm2m_context_t * contextP,
+                                lwm2m_observed_t * observedP)
+{
+    lwm2m_observed_node_t * nodeP;
+
+    nodeP = prv_findNode(contextP, &observedP->uri);
+    if (nodeP == NULL || nodeP->observedP != observedP) return;
+
+    nodeP->observedP = NULL;
+    prv_prunePath(contextP, &observedP->uri);
+}
+
+static void prv_freeNode(lwm2m_observed_node_t * nodeP)
+{
+    uint32_t i;
+
+    for (i = 0 ; i < nodeP->childCount ; i++)
+    {
+        prv_freeNode(nodeP->children + i);
+    }
+    if (nodeP->children != NULL) lwm2m_free(nodeP->children);
+}
+
+void observe_freeIndex(lwm2m_context_t * contextP)
+{
+    prv_freeNode(&contextP->observedIndex);
+    memset(&contextP->observedIndex, 0, sizeof(lwm2m_observed_node_t));
+}
+
 static lwm2m_observed_t * prv_findObserved(lwm2m_context_t * contextP,
                                            lwm2m_uri_t * uriP)
 {
-    lwm2m_observed_t * targetP;
+    lwm2m_observed_node_t * nodeP;
 
-    targetP = contextP->observedList;
-    while (targetP != NULL
-        && (targetP->uri.objectId != uriP->objectId
-         || targetP->uri.flag != uriP->flag
-         || (LWM2M_URI_IS_SET_INSTANCE(uriP) && targetP->uri.instanceId != uriP->instanceId)
-         || (LWM2M_URI_IS_SET_RESOURCE(uriP) && targetP->uri.resourceId != uriP->resourceId)))
+    nodeP = prv_findNode(contextP, uriP);
+    if (nodeP == NULL) return NULL;
+
+    return nodeP->observedP;
+}
+
+// Check the watchers of observedP at the next step
+static void prv_markDirty(lwm2m_context_t * contextP,
+                          lwm2m_observed_t * observedP)
+{
+    if (observedP->dirty) return;
+
+    observedP->dirty = true;
+    observedP->dirtyNext = contextP->observedDirty;
+    contextP->observedDirty = observedP;
+}
+
+static void prv_unmarkDirty(lwm2m_context_t * contextP,
+                            lwm2m_observed_t * observedP)
+{
+    lwm2m_observed_t ** observedH;
+
+    if (!observedP->dirty) return;
+
+    // it is either to check at the next step or left to check by the running one
+    for (observedH = &contextP->observedDirty ; *observedH != NULL ; observedH = &(*observedH)->dirtyNext)
     {
-        targetP = targetP->next;
+        if (*observedH == observedP) break;
     }
+    if (*observedH == NULL)
+    {
+        for (observedH = &contextP->observedStepping ; *observedH != NULL ; observedH = &(*observedH)->dirtyNext)
+        {
+            if (*observedH == observedP) break;
+        }
+    }
+    if (*observedH != NULL) *observedH = observedP->dirtyNext;
+    observedP->dirty = false;
+    observedP->dirtyNext = NULL;
+}
 
-    return targetP;
+// Free a watcher, its pending notification is abandoned
+static void prv_freeWatcher(lwm2m_context_t * contextP,
+                            lwm2m_watcher_t * watcherP)
+{
+    lwm2m_server_t * serverP = watcherP->server;
+
+    // a callback of the running step may free the watcher it is checking
+    if (contextP->watcherCurrent == watcherP) contextP->watcherCurrent = NULL;
+    if (contextP->watcherNext == watcherP) contextP->watcherNext = watcherP->next;
+
+    deadline_cancel(&contextP->watcherDeadlines, &watcherP->deadline);
+    if (watcherP->pendingP != NULL)
+    {
+        transaction_remove(contextP, watcherP->pendingP);
+        serverP->notifyPending--;
+    }
+    if (watcherP->blocked == true)
+    {
+        lwm2m_watcher_t ** blockedP = &serverP->notifyBlocked;
+
+        while (*blockedP != watcherP) blockedP = &(*blockedP)->blockedNext;
+        *blockedP = watcherP->blockedNext;
+    }
+    if (watcherP->parameters != NULL) lwm2m_free(watcherP->parameters);
+    lwm2m_free(watcherP);
 }
 
 static void prv_unlinkObserved(lwm2m_context_t * contextP,
@@ -94,6 +335,34 @@ static void prv_unlinkObserved(lwm2m_context_t * contextP,
     }
 }
 
+// Free an observation without watchers
+static void prv_freeObserved(lwm2m_context_t * contextP,
+                             lwm2m_observed_t * observedP)
+{
+    if (contextP->observedCurrent == observedP) contextP->observedCurrent = NULL;
+    prv_unmarkDirty(contextP, observedP);
+    prv_unindexObserved(contextP, observedP);
+    prv_unlinkObserved(contextP, observedP);
+    lwm2m_free(observedP);
+}
+
+// Remove a watcher from its observation, which is freed with its last watcher
+static void prv_cancelWatcher(lwm2m_context_t * contextP,
+                              lwm2m_watcher_t * watcherP)
+{
+    lwm2m_observed_t * observedP = watcherP->observedP;
+    lwm2m_watcher_t ** watcherH;
+
+    for (watcherH = &observedP->watcherList ; *watcherH != watcherP ; watcherH = &(*watcherH)->next);
+    *watcherH = watcherP->next;
+
+    prv_freeWatcher(contextP, watcherP);
+    if (observedP->watcherList == NULL)
+    {
+        prv_freeObserved(contextP, observedP);
+    }
+}
+
 static lwm2m_watcher_t * prv_findWatcher(lwm2m_observed_t * observedP,
                                          lwm2m_server_t * serverP)
 {
@@ -127,6 +396,11 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         allocatedObserver = true;
         memset(observedP, 0, sizeof(lwm2m_observed_t));
         memcpy(&(observedP->uri), uriP, sizeof(lwm2m_uri_t));
+        if (!prv_indexObserved(contextP, observedP))
+        {
+            lwm2m_free(observedP);
+            return NULL;
+        }
         observedP->next = contextP->observedList;
         contextP->observedList = observedP;
     }
@@ -139,6 +413,8 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         {
             if (allocatedObserver == true)
             {
+                prv_unindexObserved(contextP, observedP);
+                prv_unlinkObserved(contextP, observedP);
                 lwm2m_free(observedP);
             }
             return NULL;
@@ -146,6 +422,8 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         memset(watcherP, 0, sizeof(lwm2m_watcher_t));
         watcherP->active = false;
         watcherP->server = serverP;
+        watcherP->observedP = observedP;
+        watcherP->contextP = contextP;
         watcherP->next = observedP->watcherList;
         observedP->watcherList = watcherP;
     }
@@ -182,8 +460,9 @@ uint8_t observe_handleRequest(lwm2m_context_t * contextP,
         watcherP->tokenLen = message->token_len;
         memcpy(watcherP->token, message->token, message->token_len);
         watcherP->active = true;
-        watcherP->lastTime = lwm2m_gettime();
+        watcherP->lastTime = utils_gettimeMs();
         watcherP->lastMid = response->mid;
+        prv_markDirty(contextP, watcherP->observedP);
         if (IS_OPTION(message, COAP_OPTION_ACCEPT))
         {
             watcherP->format = utils_convertMediaType((coap_content_type_t)message->accept[0]);
@@ -242,41 +521,16 @@ void observe_cancel(lwm2m_context_t * contextP,
          observedP != NULL;
          observedP = observedP->next)
     {
-        lwm2m_watcher_t * targetP = NULL;
+        lwm2m_watcher_t * targetP;
 
-        if (observedP->watcherList->lastMid == mid
-         && lwm2m_session_is_equal(observedP->watcherList->server->sessionH, fromSessionH, contextP->userData))
+        for (targetP = observedP->watcherList ; targetP != NULL ; targetP = targetP->next)
         {
-            targetP = observedP->watcherList;
-            observedP->watcherList = observedP->watcherList->next;
-        }
-        else
-        {
-            lwm2m_watcher_t * parentP;
-
-            parentP = observedP->watcherList;
-            while (parentP->next != NULL
-                && (parentP->next->lastMid != mid
-                 || !lwm2m_session_is_equal(parentP->next->server->sessionH, fromSessionH, contextP->userData)))
+            if (targetP->lastMid == mid
+             && lwm2m_session_is_equal(targetP->server->sessionH, fromSessionH, contextP->userData))
             {
-                parentP = parentP->next;
-            }
-            if (parentP->next != NULL)
-            {
-                targetP = parentP->next;
-                parentP->next = parentP->next->next;
-            }
-        }
-        if (targetP != NULL)
-        {
-            if (targetP->parameters != NULL) lwm2m_free(targetP->parameters);
-            lwm2m_free(targetP);
-            if (observedP->watcherList == NULL)
-            {
-                prv_unlinkObserved(contextP, observedP);
-                lwm2m_free(observedP);
+                prv_cancelWatcher(contextP, targetP);
+                return;
             }
-            return;
         }
     }
 }
@@ -300,14 +554,14 @@ void observe_clear(lwm2m_context_t * contextP,
 
             nextP = observedP->next;
 
-            for (watcherP = observedP->watcherList; watcherP != NULL; watcherP = watcherP->next)
+            while (observedP->watcherList != NULL)
             {
-                if (watcherP->parameters != NULL) lwm2m_free(watcherP->parameters);
+                watcherP = observedP->watcherList;
+                observedP->watcherList = watcherP->next;
+                prv_freeWatcher(contextP, watcherP);
             }
-            LWM2M_LIST_FREE(observedP->watcherList);
 
-            prv_unlinkObserved(contextP, observedP);
-            lwm2m_free(observedP);
+            prv_freeObserved(contextP, observedP);
 
             observedP = nextP;
         }
@@ -419,6 +673,9 @@ uint8_t observe_setParameters(lwm2m_context_t * contextP,
             watcherP->parameters->maxPeriod, watcherP->parameters->greaterThan,
             watcherP->parameters->lessThan, watcherP->parameters->step);
 
+    // the periods changed, the deadline of the watcher is computed again
+    prv_markDirty(contextP, watcherP->observedP);
+
     return COAP_204_CHANGED;
 }
 
@@ -428,351 +685,683 @@ lwm2m_observed_t * observe_findByUri(lwm2m_context_t * contextP,
     lwm2m_observed_t * targetP;
 
     LOG_URI(uriP);
-    targetP = contextP->observedList;
-    while (targetP != NULL)
+    targetP = prv_findObserved(contextP, uriP);
+    if (targetP != NULL)
     {
-        if (targetP->uri.objectId == uriP->objectId)
-        {
-            if ((!LWM2M_URI_IS_SET_INSTANCE(uriP) && !LWM2M_URI_IS_SET_INSTANCE(&(targetP->uri)))
-             || (LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_INSTANCE(&(targetP->uri)) && (uriP->instanceId == targetP->uri.instanceId)))
-             {
-                 if ((!LWM2M_URI_IS_SET_RESOURCE(uriP) && !LWM2M_URI_IS_SET_RESOURCE(&(targetP->uri)))
-                     || (LWM2M_URI_IS_SET_RESOURCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(&(targetP->uri)) && (uriP->resourceId == targetP->uri.resourceId)))
-                 {
-                     LOG_ARG("Found one with%s observers.", targetP->watcherList ? "" : " no");
-                     LOG_URI(&(targetP->uri));
-                     return targetP;
-                 }
-             }
-        }
-        targetP = targetP->next;
+        LOG_ARG("Found one with%s observers.", targetP->watcherList ? "" : " no");
+        LOG_URI(&(targetP->uri));
+        return targetP;
     }
 
     LOG("Found nothing");
     return NULL;
 }
 
+static void prv_tagObserved(lwm2m_context_t * contextP,
+                            lwm2m_observed_t * observedP)
+{
+    lwm2m_watcher_t * watcherP;
+
+    if (observedP == NULL) return;
+
+    LOG("Found an observation");
+    LOG_URI(&(observedP->uri));
+
+    for (watcherP = observedP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        if (watcherP->active == true)
+        {
+            LOG("Tagging a watcher");
+            // the value waiting for the server to acknowledge a notification is replaced by this one
+            if (watcherP->blocked == true) watcherP->server->notifyCollapsed++;
+            watcherP->update = true;
+            prv_markDirty(contextP, observedP);
+        }
+    }
+}
+
+// Tag the observation of a node and the ones of all the paths below it
+static void prv_tagNode(lwm2m_context_t * contextP,
+                        lwm2m_observed_node_t * nodeP)
+{
+    uint32_t i;
+
+    prv_tagObserved(contextP, nodeP->observedP);
+    for (i = 0 ; i < nodeP->childCount ; i++)
+    {
+        prv_tagNode(contextP, nodeP->children + i);
+    }
+}
+
 void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
                                   lwm2m_uri_t * uriP)
 {
-    lwm2m_observed_t * targetP;
+    lwm2m_observed_node_t * nodeP;
 
     LOG_URI(uriP);
-    targetP = contextP->observedList;
-    while (targetP != NULL)
+
+    // the observations of the changed path, of the paths above it and of the paths below it
+    nodeP = prv_findChild(&contextP->observedIndex, uriP->objectId, NULL);
+    if (nodeP == NULL) return;
+    if (!LWM2M_URI_IS_SET_INSTANCE(uriP))
+    {
+        prv_tagNode(contextP, nodeP);
+        return;
+    }
+    prv_tagObserved(contextP, nodeP->observedP);
+
+    nodeP = prv_findChild(nodeP, uriP->instanceId, NULL);
+    if (nodeP == NULL) return;
+    if (!LWM2M_URI_IS_SET_RESOURCE(uriP))
+    {
+        prv_tagNode(contextP, nodeP);
+        return;
+    }
+    prv_tagObserved(contextP, nodeP->observedP);
+
+    nodeP = prv_findChild(nodeP, uriP->resourceId, NULL);
+    if (nodeP != NULL) prv_tagNode(contextP, nodeP);
+}
+
+// Time at which the watcher can next notify without a new value change, 0 if none
+static int64_t prv_watcherDeadline(lwm2m_watcher_t * watcherP)
+{
+    int64_t deadline = 0;
+
+    if (watcherP->active == false || watcherP->parameters == NULL) return 0;
+
+    if (watcherP->update == true
+     && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0)
+    {
+        deadline = watcherP->lastTime + (int64_t)watcherP->parameters->minPeriod * MS_PER_SECOND;
+    }
+    if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
     {
-        if (targetP->uri.objectId == uriP->objectId)
+        int64_t maxDeadline = watcherP->lastTime + (int64_t)watcherP->parameters->maxPeriod * MS_PER_SECOND;
+
+        if (deadline == 0 || maxDeadline < deadline) deadline = maxDeadline;
+    }
+
+    return deadline;
+}
+
+// Whether a watcher of targetP notifies if checked at currentTime, the resource is not read otherwise
+static bool prv_isDue(lwm2m_observed_t * targetP,
+                      int64_t currentTime)
+{
+    lwm2m_watcher_t * watcherP;
+
+    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        if (watcherP->active == false || watcherP->blocked == true) continue;
+
+        if (watcherP->update == true)
         {
-            if (!LWM2M_URI_IS_SET_INSTANCE(uriP)
-             || (targetP->uri.flag & LWM2M_URI_FLAG_INSTANCE_ID) == 0
-             || uriP->instanceId == targetP->uri.instanceId)
+            if (watcherP->parameters == NULL
+             || (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) == 0
+             || watcherP->lastTime + (int64_t)watcherP->parameters->minPeriod * MS_PER_SECOND <= currentTime)
             {
-                if (!LWM2M_URI_IS_SET_RESOURCE(uriP)
-                 || (targetP->uri.flag & LWM2M_URI_FLAG_RESOURCE_ID) == 0
-                 || uriP->resourceId == targetP->uri.resourceId)
-                {
-                    lwm2m_watcher_t * watcherP;
+                return true;
+            }
+        }
+        else if (watcherP->parameters != NULL
+              && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0
+              && watcherP->lastTime + (int64_t)watcherP->parameters->maxPeriod * MS_PER_SECOND <= currentTime)
+        {
+            return true;
+        }
+    }
 
-                    LOG("Found an observation");
-                    LOG_URI(&(targetP->uri));
+    return false;
+}
 
-                    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
-                    {
-                        if (watcherP->active == true)
-                        {
-                            LOG("Tagging a watcher");
-                            watcherP->update = true;
-                        }
-                    }
-                }
-            }
+static void prv_scheduleWatchers(lwm2m_context_t * contextP,
+                                 lwm2m_observed_t * targetP,
+                                 int64_t currentTime,
+                                 bool retry)
+{
+    lwm2m_watcher_t * watcherP;
+
+    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        int64_t deadline = prv_watcherDeadline(watcherP);
+
+        // a blocked watcher is checked again once the server acknowledged a notification
+        if (watcherP->blocked == true) deadline = 0;
+        else if (retry && watcherP->active) deadline = currentTime;
+        if (deadline == 0)
+        {
+            deadline_cancel(&contextP->watcherDeadlines, &watcherP->deadline);
+            continue;
+        }
+        // the resource could not be read or a notification could not be sent, it is tried again later
+        if (deadline <= currentTime) deadline = currentTime + MS_PER_SECOND;
+
+        if (!deadline_schedule(&contextP->watcherDeadlines, &watcherP->deadline, deadline))
+        {
+            prv_markDirty(contextP, targetP);
         }
-        targetP = targetP->next;
     }
 }
 
-void observe_step(lwm2m_context_t * contextP,
-                  time_t currentTime,
-                  time_t * timeoutP)
+// Representations of an observed path serialized during a step, one per requested content format
+#define OBSERVE_PAYLOAD_CACHE_SIZE  4
+
+typedef struct
 {
-    lwm2m_observed_t * targetP;
+    lwm2m_media_type_t requested;
+    lwm2m_media_type_t format;  // may differ from requested, as text only holds a single resource
+    uint8_t *          buffer;
+    size_t             length;
+} observe_payload_t;
+
+// Returns the representation of targetP in the format of the watcher, serialized at first use
+static observe_payload_t * prv_getPayload(lwm2m_context_t * contextP,
+                                          lwm2m_observed_t * targetP,
+                                          int size,
+                                          lwm2m_data_t * dataP,
+                                          lwm2m_media_type_t requested,
+                                          observe_payload_t * cache,
+                                          size_t * countP)
+{
+    observe_payload_t * payloadP;
+    size_t i;
 
-    LOG("Entering");
-    for (targetP = contextP->observedList ; targetP != NULL ; targetP = targetP->next)
-    {
-        lwm2m_watcher_t * watcherP;
-        uint8_t * buffer = NULL;
-        size_t length = 0;
-        lwm2m_data_t * dataP = NULL;
-        int size = 0;
-        double floatValue = 0;
-        int64_t integerValue = 0;
-        bool storeValue = false;
-        coap_packet_t message[1];
-        time_t interval;
+    for (i = 0 ; i < *countP ; i++)
+    {
+        if (cache[i].requested == requested) return cache + i;
+    }
 
-        LOG_URI(&(targetP->uri));
-        if (LWM2M_URI_IS_SET_RESOURCE(&targetP->uri))
+    // more formats than expected, the last representation is dropped
+    if (*countP == OBSERVE_PAYLOAD_CACHE_SIZE)
+    {
+        (*countP)--;
+        if (cache[*countP].buffer != NULL) lwm2m_free(cache[*countP].buffer);
+    }
+    payloadP = cache + *countP;
+    payloadP->requested = requested;
+    payloadP->format = requested;
+    payloadP->buffer = NULL;
+    payloadP->length = 0;
+
+    if (dataP != NULL)
+    {
+        int res;
+
+        res = lwm2m_data_serialize(&targetP->uri, size, dataP, &payloadP->format, &payloadP->buffer);
+        if (res < 0) return NULL;
+        payloadP->length = (size_t)res;
+    }
+    else
+    {
+        if (COAP_205_CONTENT != object_read(contextP, &targetP->uri,
+             &payloadP->format, &payloadP->buffer, &payloadP->length))
         {
-            if (COAP_205_CONTENT != object_readData(contextP, &targetP->uri, &size, &dataP)) continue;
-            if (!dataP)
+            if (payloadP->buffer != NULL) lwm2m_free(payloadP->buffer);
+            return NULL;
+        }
+    }
+    (*countP)++;
+
+    return payloadP;
+}
+
+static void prv_notifyReplyCallback(lwm2m_transaction_t * transacP,
+                                    void * message)
+{
+    lwm2m_watcher_t * watcherP = (lwm2m_watcher_t *)transacP->userData;
+
+    // the transaction is removed by the caller
+    watcherP->pendingP = NULL;
+    watcherP->server->notifyPending--;
+
+    // a reset cancels the observation before reaching here, a NULL message is a timeout: as per
+    // RFC 7641 section 4.5, the server is then no longer interested in the resource
+    if (message == NULL)
+    {
+        LOG("Notification not acknowledged, cancelling the observation");
+        watcherP->server->notifyDropped++;
+        prv_cancelWatcher(watcherP->contextP, watcherP);
+    }
+}
+
+// Returns false when the notification could not be sent, watcherP->blocked is then set if the server has
+// too many notifications pending
+static bool prv_sendNotification(lwm2m_context_t * contextP,
+                                 lwm2m_watcher_t * watcherP,
+                                 observe_payload_t * payloadP,
+                                 int64_t currentTime)
+{
+    lwm2m_server_t * serverP = watcherP->server;
+    lwm2m_transaction_t * previousP = watcherP->pendingP;
+    lwm2m_transaction_t * transacP;
+    coap_packet_t message[1];
+    int result;
+
+    if (serverP->notifyMaxPending == 0)
+    {
+        coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, contextP->nextMID++);
+        coap_set_header_content_type(message, payloadP->format);
+        coap_set_payload(message, payloadP->buffer, payloadP->length);
+        coap_set_header_token(message, watcherP->token, watcherP->tokenLen);
+        coap_set_header_observe(message, watcherP->counter++);
+        watcherP->lastMid = message->mid;
+        (void)message_send(contextP, message, serverP->sessionH);
+        return true;
+    }
+
+    if (previousP == NULL && serverP->notifyPending >= serverP->notifyMaxPending)
+    {
+        lwm2m_watcher_t ** blockedP = &serverP->notifyBlocked;
+
+        // the watchers are woken up in the order they were blocked
+        LOG_ARG("%d notifications pending, waiting for an acknowledgement", serverP->notifyPending);
+        while (*blockedP != NULL) blockedP = &(*blockedP)->blockedNext;
+        *blockedP = watcherP;
+        watcherP->blockedNext = NULL;
+        watcherP->blocked = true;
+        return false;
+    }
+
+    transacP = transaction_new(serverP->sessionH, COAP_GET, NULL, NULL, contextP->nextMID++, (uint8_t)watcherP->tokenLen, watcherP->token);
+    if (transacP == NULL) return false;
+
+    coap_set_status_code(transacP->message, COAP_205_CONTENT);
+    coap_set_header_content_type(transacP->message, payloadP->format);
+    coap_set_payload(transacP->message, payloadP->buffer, payloadP->length);
+    coap_set_header_observe(transacP->message, watcherP->counter++);
+    transacP->callback = prv_notifyReplyCallback;
+    transacP->userData = (void *)watcherP;
+
+    if (previousP != NULL)
+    {
+        // the previous value is not acknowledged yet: it is replaced by the new one, which keeps
+        // its retransmission state so that an absent server is still detected in time
+        LOG("Replacing the pending notification");
+        transacP->ack_timeout = previousP->ack_timeout;
+        transacP->retrans_counter = previousP->retrans_counter;
+        transacP->retrans_time = currentTime;
+        transaction_remove(contextP, previousP);
+        serverP->notifyCollapsed++;
+    }
+    else
+    {
+        serverP->notifyPending++;
+    }
+    watcherP->pendingP = transacP;
+    watcherP->lastMid = transacP->mID;
+
+    // the transaction is freed on failure. When it reached its last retransmission, its callback
+    // was called first and cancelled the watcher.
+    result = transaction_send(contextP, transacP);
+    if (result != 0)
+    {
+        if (result > 0)
+        {
+            watcherP->pendingP = NULL;
+            serverP->notifyPending--;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+// Wake up as many blocked watchers of serverP as it can take notifications
+static void prv_unblockWatchers(lwm2m_context_t * contextP,
+                                lwm2m_server_t * serverP)
+{
+    int available;
+
+    if (serverP->notifyBlocked == NULL) return;
+
+    // all of them when the notifications are not confirmable anymore
+    if (serverP->notifyMaxPending == 0) available = -1;
+    else if (serverP->notifyPending < serverP->notifyMaxPending) available = serverP->notifyMaxPending - serverP->notifyPending;
+    else return;
+
+    while (serverP->notifyBlocked != NULL && available != 0)
+    {
+        lwm2m_watcher_t * watcherP = serverP->notifyBlocked;
+
+        serverP->notifyBlocked = watcherP->blockedNext;
+        watcherP->blockedNext = NULL;
+        watcherP->blocked = false;
+        prv_markDirty(contextP, watcherP->observedP);
+        if (available > 0) available--;
+    }
+}
+
+// Returns false when the resource could not be read or a notification could not be built
+static bool prv_notifyObserved(lwm2m_context_t * contextP,
+                               lwm2m_observed_t * targetP,
+                               int64_t currentTime)
+{
+    lwm2m_watcher_t * watcherP;
+    observe_payload_t cache[OBSERVE_PAYLOAD_CACHE_SIZE];
+    size_t cacheCount = 0;
+    lwm2m_data_t * dataP = NULL;
+    int size = 0;
+    double floatValue = 0;
+    int64_t integerValue = 0;
+    bool storeValue = false;
+    bool result = true;
+
+    LOG_URI(&(targetP->uri));
+    if (LWM2M_URI_IS_SET_RESOURCE(&targetP->uri))
+    {
+        if (COAP_205_CONTENT != object_readData(contextP, &targetP->uri, &size, &dataP)) return false;
+        // the read callback may have cancelled the observation
+        if (contextP->observedCurrent != targetP)
+        {
+            lwm2m_data_free(size, dataP);
+            return true;
+        }
+        if (!dataP)
+        {
+            LOG("dataP is NULL !!!");
+            return false;
+        }
+
+        switch (dataP->type)
+        {
+        case LWM2M_TYPE_INTEGER:
+            if (1 != lwm2m_data_decode_int(dataP, &integerValue))
             {
-                LOG("dataP is NULL !!!");
-                return;
+                lwm2m_data_free(size, dataP);
+                return false;
             }
-
-            switch (dataP->type)
+            storeValue = true;
+            break;
+        case LWM2M_TYPE_FLOAT:
+            if (1 != lwm2m_data_decode_float(dataP, &floatValue))
             {
-            case LWM2M_TYPE_INTEGER:
-                if (1 != lwm2m_data_decode_int(dataP, &integerValue))
-                {
-                    lwm2m_data_free(size, dataP);
-                    continue;
-                }
-                storeValue = true;
-                break;
-            case LWM2M_TYPE_FLOAT:
-                if (1 != lwm2m_data_decode_float(dataP, &floatValue))
-                {
-                    lwm2m_data_free(size, dataP);
-                    continue;
-                }
-                storeValue = true;
-                break;
-            default:
-                break;
+                lwm2m_data_free(size, dataP);
+                return false;
             }
+            storeValue = true;
+            break;
+        default:
+            break;
         }
-        for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    }
+    // the watchers are walked through the context, as the callbacks may free them
+    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = contextP->watcherNext)
+    {
+        contextP->watcherCurrent = watcherP;
+        contextP->watcherNext = watcherP->next;
+
+        if (watcherP->active == true && watcherP->blocked == false)
         {
-            if (watcherP->active == true)
+            bool notify = false;
+
+            if (watcherP->update == true)
             {
-                bool notify = false;
+                // value changed, should we notify the server ?
 
-                if (watcherP->update == true)
+                if (watcherP->parameters == NULL || watcherP->parameters->toSet == 0)
                 {
-                    // value changed, should we notify the server ?
-
-                    if (watcherP->parameters == NULL || watcherP->parameters->toSet == 0)
-                    {
-                        // no conditions
-                        notify = true;
-                        LOG("Notify with no conditions");
-                        LOG_URI(&(targetP->uri));
-                    }
+                    // no conditions
+                    notify = true;
+                    LOG("Notify with no conditions");
+                    LOG_URI(&(targetP->uri));
+                }
 
-                    if (notify == false
-                     && watcherP->parameters != NULL
-                     && (watcherP->parameters->toSet & ATTR_FLAG_NUMERIC) != 0)
+                if (notify == false
+                 && watcherP->parameters != NULL
+                 && (watcherP->parameters->toSet & ATTR_FLAG_NUMERIC) != 0)
+                {
+                    if ((NULL != dataP)
+                        && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_LESS_THAN) != 0)
                     {
-                        if ((NULL != dataP)
-                            && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_LESS_THAN) != 0)
+                        LOG("Checking lower threshold");
+                        // Did we cross the lower threshold ?
+                        switch (dataP->type)
                         {
-                            LOG("Checking lower threshold");
-                            // Did we cross the lower threshold ?
-                            switch (dataP->type)
+                        case LWM2M_TYPE_INTEGER:
+                            if ((integerValue <= watcherP->parameters->lessThan
+                              && watcherP->lastValue.asInteger > watcherP->parameters->lessThan)
+                             || (integerValue >= watcherP->parameters->lessThan
+                              && watcherP->lastValue.asInteger < watcherP->parameters->lessThan))
                             {
-                            case LWM2M_TYPE_INTEGER:
-                                if ((integerValue <= watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asInteger > watcherP->parameters->lessThan)
-                                 || (integerValue >= watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asInteger < watcherP->parameters->lessThan))
-                                {
-                                    LOG("Notify on lower threshold crossing");
-                                    notify = true;
-                                }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                                if ((floatValue <= watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asFloat > watcherP->parameters->lessThan)
-                                 || (floatValue >= watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asFloat < watcherP->parameters->lessThan))
-                                {
-                                    LOG("Notify on lower threshold crossing");
-                                    notify = true;
-                                }
-                                break;
-                            default:
-                                break;
+                                LOG("Notify on lower threshold crossing");
+                                notify = true;
                             }
-                        }
-                        if ((NULL != dataP)
-                            && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_GREATER_THAN) != 0)
-                        {
-                            LOG("Checking upper threshold");
-                            // Did we cross the upper threshold ?
-                            switch (dataP->type)
+                            break;
+                        case LWM2M_TYPE_FLOAT:
+                            if ((floatValue <= watcherP->parameters->lessThan
+                              && watcherP->lastValue.asFloat > watcherP->parameters->lessThan)
+                             || (floatValue >= watcherP->parameters->lessThan
+                              && watcherP->lastValue.asFloat < watcherP->parameters->lessThan))
                             {
-                            case LWM2M_TYPE_INTEGER:
-                                if ((integerValue <= watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asInteger > watcherP->parameters->greaterThan)
-                                 || (integerValue >= watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asInteger < watcherP->parameters->greaterThan))
-                                {
-                                    LOG("Notify on lower upper crossing");
-                                    notify = true;
-                                }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                                if ((floatValue <= watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asFloat > watcherP->parameters->greaterThan)
-                                 || (floatValue >= watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asFloat < watcherP->parameters->greaterThan))
-                                {
-                                    LOG("Notify on lower upper crossing");
-                                    notify = true;
-                                }
-                                break;
-                            default:
-                                break;
+                                LOG("Notify on lower threshold crossing");
+                                notify = true;
                             }
+                            break;
+                        default:
+                            break;
                         }
-                        if ((NULL != dataP)
-                            && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_STEP) != 0)
+                    }
+                    if ((NULL != dataP)
+                        && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_GREATER_THAN) != 0)
+                    {
+                        LOG("Checking upper threshold");
+                        // Did we cross the upper threshold ?
+                        switch (dataP->type)
                         {
-                            LOG("Checking step");
-
-                            switch (dataP->type)
+                        case LWM2M_TYPE_INTEGER:
+                            if ((integerValue <= watcherP->parameters->greaterThan
+                              && watcherP->lastValue.asInteger > watcherP->parameters->greaterThan)
+                             || (integerValue >= watcherP->parameters->greaterThan
+                              && watcherP->lastValue.asInteger < watcherP->parameters->greaterThan))
                             {
-                            case LWM2M_TYPE_INTEGER:
-                            {
-                                int64_t diff;
-
-                                diff = integerValue - watcherP->lastValue.asInteger;
-                                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
-                                 || (diff >= 0 && diff >= watcherP->parameters->step))
-                                {
-                                    LOG("Notify on step condition");
-                                    notify = true;
-                                }
+                                LOG("Notify on lower upper crossing");
+                                notify = true;
                             }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
+                            break;
+                        case LWM2M_TYPE_FLOAT:
+                            if ((floatValue <= watcherP->parameters->greaterThan
+                              && watcherP->lastValue.asFloat > watcherP->parameters->greaterThan)
+                             || (floatValue >= watcherP->parameters->greaterThan
+                              && watcherP->lastValue.asFloat < watcherP->parameters->greaterThan))
                             {
-                                double diff;
-
-                                diff = floatValue - watcherP->lastValue.asFloat;
-                                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
-                                 || (diff >= 0 && diff >= watcherP->parameters->step))
-                                {
-                                    LOG("Notify on step condition");
-                                    notify = true;
-                                }
-                            }
-                                break;
-                            default:
-                                break;
+                                LOG("Notify on lower upper crossing");
+                                notify = true;
                             }
+                            break;
+                        default:
+                            break;
                         }
                     }
-
-                    if (watcherP->parameters != NULL
-                     && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0)
+                    if ((NULL != dataP)
+                        && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_STEP) != 0)
                     {
-                        LOG_ARG("Checking minimal period (%d s)", watcherP->parameters->minPeriod);
+                        LOG("Checking step");
 
-                        if (watcherP->lastTime + watcherP->parameters->minPeriod > currentTime)
+                        switch (dataP->type)
                         {
-                            // Minimum Period did not elapse yet
-                            interval = watcherP->lastTime + watcherP->parameters->minPeriod - currentTime;
-                            if (*timeoutP > interval) *timeoutP = interval;
-                            notify = false;
+                        case LWM2M_TYPE_INTEGER:
+                        {
+                            int64_t diff;
+
+                            diff = integerValue - watcherP->lastValue.asInteger;
+                            if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
+                             || (diff >= 0 && diff >= watcherP->parameters->step))
+                            {
+                                LOG("Notify on step condition");
+                                notify = true;
+                            }
                         }
-                        else
+                            break;
+                        case LWM2M_TYPE_FLOAT:
                         {
-                            LOG("Notify on minimal period");
-                            notify = true;
+                            double diff;
+
+                            diff = floatValue - watcherP->lastValue.asFloat;
+                            if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
+                             || (diff >= 0 && diff >= watcherP->parameters->step))
+                            {
+                                LOG("Notify on step condition");
+                                notify = true;
+                            }
+                        }
+                            break;
+                        default:
+                            break;
                         }
                     }
                 }
 
-                // Is the Maximum Period reached ?
-                if (notify == false
-                 && watcherP->parameters != NULL
-                 && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+                if (watcherP->parameters != NULL
+                 && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0)
                 {
-                    LOG_ARG("Checking maximal period (%d s)", watcherP->parameters->maxPeriod);
+                    LOG_ARG("Checking minimal period (%d s)", watcherP->parameters->minPeriod);
 
-                    if (watcherP->lastTime + watcherP->parameters->maxPeriod <= currentTime)
+                    if (watcherP->lastTime + (int64_t)watcherP->parameters->minPeriod * MS_PER_SECOND > currentTime)
                     {
-                        LOG("Notify on maximal period");
+                        // Minimum Period did not elapse yet
+                        notify = false;
+                    }
+                    else
+                    {
+                        LOG("Notify on minimal period");
                         notify = true;
                     }
                 }
+            }
 
-                if (notify == true)
-                {
-                    if (buffer == NULL)
-                    {
-                        if (dataP != NULL)
-                        {
-                            int res;
+            // Is the Maximum Period reached ?
+            if (notify == false
+             && watcherP->parameters != NULL
+             && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+            {
+                LOG_ARG("Checking maximal period (%d s)", watcherP->parameters->maxPeriod);
 
-                            res = lwm2m_data_serialize(&targetP->uri, size, dataP, &(watcherP->format), &buffer);
-                            if (res < 0)
-                            {
-                                break;
-                            }
-                            else
-                            {
-                                length = (size_t)res;
-                            }
+                if (watcherP->lastTime + (int64_t)watcherP->parameters->maxPeriod * MS_PER_SECOND <= currentTime)
+                {
+                    LOG("Notify on maximal period");
+                    notify = true;
+                }
+            }
 
-                        }
-                        else
-                        {
-                            if (COAP_205_CONTENT != object_read(contextP, &targetP->uri,
-                                 &(watcherP->format), &buffer, &length))
-                            {
-                                if (buffer)
-                                {
-                                   lwm2m_free(buffer);
-                                }
+            if (notify == true)
+            {
+                observe_payload_t * payloadP;
+                bool sent;
 
-                                buffer = NULL;
-                                break;
-                            }
-                        }
-                        coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
-                        coap_set_header_content_type(message, watcherP->format);
-                        coap_set_payload(message, buffer, length);
-                    }
-                    watcherP->lastTime = currentTime;
-                    watcherP->lastMid = contextP->nextMID++;
-                    message->mid = watcherP->lastMid;
-                    coap_set_header_token(message, watcherP->token, watcherP->tokenLen);
-                    coap_set_header_observe(message, watcherP->counter++);
-                    (void)message_send(contextP, message, watcherP->server->sessionH);
-                    watcherP->update = false;
+                payloadP = prv_getPayload(contextP, targetP, size, dataP, watcherP->format, cache, &cacheCount);
+                if (payloadP == NULL)
+                {
+                    result = false;
+                    break;
                 }
+                if (contextP->watcherCurrent == NULL) continue;
+                watcherP->format = payloadP->format;
 
-                // Store this value
-                if (notify == true && storeValue == true)
+                sent = prv_sendNotification(contextP, watcherP, payloadP, currentTime);
+                if (contextP->watcherCurrent == NULL) continue;
+                if (!sent)
                 {
-                    switch (dataP->type)
-                    {
-                    case LWM2M_TYPE_INTEGER:
-                        watcherP->lastValue.asInteger = integerValue;
-                        break;
-                    case LWM2M_TYPE_FLOAT:
-                        watcherP->lastValue.asFloat = floatValue;
-                        break;
-                    default:
-                        break;
-                    }
+                    // a blocked watcher reads the value again once it can send it
+                    if (watcherP->blocked == false) result = false;
+                    continue;
                 }
+                watcherP->lastTime = currentTime;
+                watcherP->update = false;
+            }
 
-                if (watcherP->parameters != NULL && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+            // Store this value
+            if (notify == true && storeValue == true)
+            {
+                switch (dataP->type)
                 {
-                    // update timers
-                    interval = watcherP->lastTime + watcherP->parameters->maxPeriod - currentTime;
-                    if (*timeoutP > interval) *timeoutP = interval;
+                case LWM2M_TYPE_INTEGER:
+                    watcherP->lastValue.asInteger = integerValue;
+                    break;
+                case LWM2M_TYPE_FLOAT:
+                    watcherP->lastValue.asFloat = floatValue;
+                    break;
+                default:
+                    break;
                 }
             }
         }
-        if (dataP != NULL) lwm2m_data_free(size, dataP);
-        if (buffer != NULL) lwm2m_free(buffer);
     }
+    contextP->watcherCurrent = NULL;
+    contextP->watcherNext = NULL;
+    if (dataP != NULL) lwm2m_data_free(size, dataP);
+    while (cacheCount > 0)
+    {
+        cacheCount--;
+        if (cache[cacheCount].buffer != NULL) lwm2m_free(cache[cacheCount].buffer);
+    }
+
+    return result;
+}
+
+void observe_step(lwm2m_context_t * contextP,
+                  int64_t currentTime,
+                  int64_t * timeoutP)
+{
+    lwm2m_deadline_t * nodeP;
+    lwm2m_server_t * serverP;
+
+    LOG("Entering");
+    for (serverP = contextP->serverList ; serverP != NULL ; serverP = serverP->next)
+    {
+        prv_unblockWatchers(contextP, serverP);
+    }
+    // only the observations with a value change or a watcher at the end of its pmin or pmax are checked
+    for (nodeP = deadline_expire(&contextP->watcherDeadlines, currentTime) ; nodeP != NULL ; nodeP = nodeP->next)
+    {
+        prv_markDirty(contextP, LWM2M_CONTAINER_OF(nodeP, lwm2m_watcher_t, deadline)->observedP);
+    }
+
+    // the dirty observations are walked through the context, as the callbacks may free them
+    contextP->observedStepping = contextP->observedDirty;
+    contextP->observedDirty = NULL;
+    while (contextP->observedStepping != NULL)
+    {
+        lwm2m_observed_t * targetP = contextP->observedStepping;
+        bool retry = false;
+
+        contextP->observedStepping = targetP->dirtyNext;
+        targetP->dirty = false;
+        targetP->dirtyNext = NULL;
+
+        if (prv_isDue(targetP, currentTime))
+        {
+            contextP->observedCurrent = targetP;
+            retry = !prv_notifyObserved(contextP, targetP, currentTime);
+            if (contextP->observedCurrent == NULL) continue;
+            contextP->observedCurrent = NULL;
+        }
+        prv_scheduleWatchers(contextP, targetP, currentTime, retry);
+    }
+
+    *timeoutP = deadline_interval(&contextP->watcherDeadlines, currentTime, *timeoutP);
+}
+
+int lwm2m_set_notification_mode(lwm2m_context_t * contextP,
+                                uint16_t shortServerID,
+                                uint8_t maxPending)
+{
+    lwm2m_server_t * serverP;
+    int result = COAP_404_NOT_FOUND;
+
+    LOG_ARG("shortServerID: %d, maxPending: %d", shortServerID, maxPending);
+
+    for (serverP = contextP->serverList ; serverP != NULL ; serverP = serverP->next)
+    {
+        if (shortServerID == 0 || serverP->shortID == shortServerID)
+        {
+            // the notifications already pending complete as they were sent
+            serverP->notifyMaxPending = maxPending;
+            result = COAP_NO_ERROR;
+        }
+    }
+
+    return result;
 }
 
 #endif
@@ -808,11 +1397,81 @@ static lwm2m_observation_t * prv_findObservationByURI(lwm2m_client_t * clientP,
     return targetP;
 }
 
+// Slots of an observation table allocated at first, the table doubles when full
+#define OBSERVE_TABLE_MIN_SIZE  16
+
+static bool prv_acquireSlot(lwm2m_observation_table_t * tableP,
+                            lwm2m_observation_t * observationP)
+{
+    lwm2m_observation_slot_t * slotP;
+
+    if (tableP->firstFree == tableP->size)
+    {
+        lwm2m_observation_slot_t * slots;
+        uint32_t size;
+        uint32_t i;
+
+        if (tableP->size > UINT32_MAX / 2) return false;
+        size = tableP->size == 0 ? OBSERVE_TABLE_MIN_SIZE : tableP->size * 2;
+
+        slots = (lwm2m_observation_slot_t *)lwm2m_malloc(size * sizeof(lwm2m_observation_slot_t));
+        if (slots == NULL) return false;
+        if (tableP->slots != NULL)
+        {
+            memcpy(slots, tableP->slots, tableP->size * sizeof(lwm2m_observation_slot_t));
+            lwm2m_free(tableP->slots);
+        }
+
+        // the new slots are chained in order, the table was full so they are the only free ones
+        for (i = tableP->size ; i < size ; i++)
+        {
+            slots[i].observationP = NULL;
+            slots[i].generation = 0;
+            slots[i].nextFree = i + 1;
+        }
+        tableP->slots = slots;
+        tableP->firstFree = tableP->size;
+        tableP->size = size;
+    }
+
+    slotP = tableP->slots + tableP->firstFree;
+    observationP->tableP = tableP;
+    observationP->slot = tableP->firstFree;
+    tableP->firstFree = slotP->nextFree;
+    slotP->observationP = observationP;
+    tableP->count++;
+
+    return true;
+}
+
+void observe_free(lwm2m_observation_t * observationP)
+{
+    lwm2m_observation_table_t * tableP = observationP->tableP;
+
+    if (tableP != NULL)
+    {
+        lwm2m_observation_slot_t * slotP = tableP->slots + observationP->slot;
+
+        slotP->observationP = NULL;
+        slotP->generation++;
+        slotP->nextFree = tableP->firstFree;
+        tableP->firstFree = observationP->slot;
+        tableP->count--;
+    }
+    lwm2m_free(observationP);
+}
+
+void observe_freeTable(lwm2m_context_t * contextP)
+{
+    if (contextP->observations.slots != NULL) lwm2m_free(contextP->observations.slots);
+    memset(&contextP->observations, 0, sizeof(lwm2m_observation_table_t));
+}
+
 void observe_remove(lwm2m_observation_t * observationP)
 {
     LOG("Entering");
     observationP->clientP->observationList = (lwm2m_observation_t *) LWM2M_LIST_RM(observationP->clientP->observationList, observationP->id, NULL);
-    lwm2m_free(observationP);
+    observe_free(observationP);
 }
 
 static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
@@ -910,8 +1569,27 @@ static void prv_obsCancelRequestCallback(lwm2m_transaction_t * transacP,
 }
 
 
+// The token of an observation holds its slot in the observation table and the slot generation
+#define OBSERVE_TOKEN_LEN   8
+
+static void prv_makeToken(lwm2m_observation_t * observationP,
+                          uint8_t token[OBSERVE_TOKEN_LEN])
+{
+    uint32_t slot = observationP->slot;
+    uint32_t generation = observationP->tableP->slots[slot].generation;
+
+    token[0] = slot >> 24;
+    token[1] = slot >> 16;
+    token[2] = slot >> 8;
+    token[3] = slot & 0xFF;
+    token[4] = generation >> 24;
+    token[5] = generation >> 16;
+    token[6] = generation >> 8;
+    token[7] = generation & 0xFF;
+}
+
 int lwm2m_observe(lwm2m_context_t * contextP,
-                  uint16_t clientID,
+                  uint32_t clientID,
                   lwm2m_uri_t * uriP,
                   lwm2m_result_callback_t callback,
                   void * userData)
@@ -919,14 +1597,14 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     lwm2m_client_t * clientP;
     lwm2m_transaction_t * transactionP;
     lwm2m_observation_t * observationP;
-    uint8_t token[4];
+    uint8_t token[OBSERVE_TOKEN_LEN];
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
 
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = lwm2m_get_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     for (observationP = clientP->observationList; observationP != NULL; observationP = observationP->next)
@@ -946,6 +1624,11 @@ int lwm2m_observe(lwm2m_context_t * contextP,
         if (observationP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
         memset(observationP, 0, sizeof(lwm2m_observation_t));
 
+        if (!prv_acquireSlot(&contextP->observations, observationP))
+        {
+            lwm2m_free(observationP);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
         observationP->id = lwm2m_list_newId((lwm2m_list_t *)clientP->observationList);
         memcpy(&observationP->uri, uriP, sizeof(lwm2m_uri_t));
         observationP->clientP = clientP;
@@ -956,16 +1639,12 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     observationP->callback = callback;
     observationP->userData = userData;
 
-    token[0] = clientP->internalID >> 8;
-    token[1] = clientP->internalID & 0xFF;
-    token[2] = observationP->id >> 8;
-    token[3] = observationP->id & 0xFF;
+    prv_makeToken(observationP, token);
 
-    transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, token);
+    transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, OBSERVE_TOKEN_LEN, token);
     if (transactionP == NULL)
     {
-        observationP->clientP->observationList = (lwm2m_observation_t *)LWM2M_LIST_RM(observationP->clientP->observationList, observationP->id, NULL);
-        lwm2m_free(observationP);
+        observe_remove(observationP);
         return COAP_500_INTERNAL_SERVER_ERROR;
     }
 
@@ -982,13 +1661,11 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     transactionP->callback = prv_obsRequestCallback;
     transactionP->userData = (void *)observationP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transactionP);
-
     return transaction_send(contextP, transactionP);
 }
 
 int lwm2m_observe_cancel(lwm2m_context_t * contextP,
-                         uint16_t clientID,
+                         uint32_t clientID,
                          lwm2m_uri_t * uriP,
                          lwm2m_result_callback_t callback,
                          void * userData)
@@ -996,10 +1673,10 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     lwm2m_client_t * clientP;
     lwm2m_observation_t * observationP;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = lwm2m_get_client(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     observationP = prv_findObservationByURI(clientP, uriP);
@@ -1011,14 +1688,11 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     {
         lwm2m_transaction_t * transactionP;
         cancellation_data_t * cancelP;
-        uint8_t token[4];
+        uint8_t token[OBSERVE_TOKEN_LEN];
 
-        token[0] = clientP->internalID >> 8;
-        token[1] = clientP->internalID & 0xFF;
-        token[2] = observationP->id >> 8;
-        token[3] = observationP->id & 0xFF;
+        prv_makeToken(observationP, token);
 
-        transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, token);
+        transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, OBSERVE_TOKEN_LEN, token);
         if (transactionP == NULL)
         {
             return COAP_500_INTERNAL_SERVER_ERROR;
@@ -1039,8 +1713,6 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
         transactionP->callback = prv_obsCancelRequestCallback;
         transactionP->userData = (void *)cancelP;
 
-        contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transactionP);
-
         return transaction_send(contextP, transactionP);
     }
 
@@ -1063,26 +1735,24 @@ bool observe_handleNotify(lwm2m_context_t * contextP,
 {
     uint8_t * tokenP;
     int token_len;
-    uint16_t clientID;
-    uint16_t obsID;
-    lwm2m_client_t * clientP;
+    uint32_t slot;
+    uint32_t generation;
     lwm2m_observation_t * observationP;
     uint32_t count;
 
     LOG("Entering");
     token_len = coap_get_header_token(message, (const uint8_t **)&tokenP);
-    if (token_len != sizeof(uint32_t)) return false;
+    if (token_len != OBSERVE_TOKEN_LEN) return false;
 
     if (1 != coap_get_header_observe(message, &count)) return false;
 
-    clientID = (tokenP[0] << 8) | tokenP[1];
-    obsID = (tokenP[2] << 8) | tokenP[3];
+    slot = ((uint32_t)tokenP[0] << 24) | ((uint32_t)tokenP[1] << 16) | ((uint32_t)tokenP[2] << 8) | tokenP[3];
+    generation = ((uint32_t)tokenP[4] << 24) | ((uint32_t)tokenP[5] << 16) | ((uint32_t)tokenP[6] << 8) | tokenP[7];
+    if (slot >= contextP->observations.size) return false;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
-    if (clientP == NULL) return false;
-
-    observationP = (lwm2m_observation_t *)lwm2m_list_find((lwm2m_list_t *)clientP->observationList, obsID);
-    if (observationP == NULL)
+    // a token of a removed observation has the generation of the slot before its release
+    observationP = contextP->observations.slots[slot].observationP;
+    if (observationP == NULL || contextP->observations.slots[slot].generation != generation)
     {
         coap_init_message(response, COAP_TYPE_RST, 0, message->mid);
         message_send(contextP, response, fromSessionH);
@@ -1093,7 +1763,7 @@ bool observe_handleNotify(lwm2m_context_t * contextP,
             coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
             message_send(contextP, response, fromSessionH);
         }
-        observationP->callback(clientID,
+        observationP->callback(observationP->clientP->internalID,
                                &observationP->uri,
                                (int)count,
                                message->content_type, message->payload, message->payload_len,
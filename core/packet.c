@@ -98,28 +98,6 @@ Contains code snippets which are:
 
 #define PRV_QUERY_BUFFER_LENGTH 200
 
-typedef struct
-{
-    lwm2m_context_t * contextP;
-    lwm2m_server_t * serverP;
-    uint16_t firstBlockMid;
-    uint8_t * bufferP;
-    size_t buffer_len;
-    unsigned int content_type;
-    lwm2m_push_ack_callback_t callbackP;
-} push_state_t;
-
-typedef struct
-{
-    uint8_t * bufferP;
-    size_t length;
-    unsigned int content_type;
-} async_state_t;
-
-static push_state_t current_push_state;
-static async_state_t current_async_state;
-static uint32_t Block1Num = 0;
-
 #endif
 
 static void handle_reset(lwm2m_context_t * contextP,
@@ -133,9 +111,9 @@ static void handle_reset(lwm2m_context_t * contextP,
 }
 
 #if SIERRA
-static bool is_block_transfer(coap_packet_t * message, uint32_t * block_num, uint16_t * block_size, uint32_t * block_offset )
+static bool is_block_transfer(lwm2m_context_t * contextP, coap_packet_t * message, uint32_t * block_num, uint16_t * block_size, uint32_t * block_offset )
 {
-    async_state_t * async_stateP = &current_async_state;
+    async_state_t * async_stateP = &contextP->packetStateP->asyncState;
     if (async_stateP->bufferP != NULL)
     {
         return coap_get_header_block2(message, block_num, NULL, block_size, block_offset);
@@ -220,6 +198,32 @@ bool IsCoapUri
 }
 #endif
 
+#ifdef LWM2M_CLIENT_MODE
+// A TLV Write on an instance can be applied record by record as its blocks are received
+static bool prv_isTlvWrite(lwm2m_context_t * contextP,
+                           coap_packet_t * message)
+{
+    lwm2m_media_type_t format;
+    lwm2m_uri_t * uriP;
+    bool result;
+
+    format = IS_OPTION(message, COAP_OPTION_CONTENT_TYPE) ? utils_convertMediaType(message->content_type) : LWM2M_CONTENT_TLV;
+    if (format != LWM2M_CONTENT_TLV && format != LWM2M_CONTENT_TLV_OLD) return false;
+
+    uriP = uri_decode(contextP->altPath, message->uri_path);
+    if (NULL == uriP) return false;
+
+    result = (uriP->flag & LWM2M_URI_MASK_TYPE) == LWM2M_URI_FLAG_DM
+          && LWM2M_URI_IS_SET_INSTANCE(uriP)
+          && !LWM2M_URI_IS_SET_RESOURCE(uriP)
+          && ((message->code == COAP_PUT && !IS_OPTION(message, COAP_OPTION_URI_QUERY))
+           || message->code == COAP_POST);
+    lwm2m_free(uriP);
+
+    return result;
+}
+#endif
+
 static uint8_t handle_request(lwm2m_context_t * contextP,
                               void * fromSessionH,
                               coap_packet_t * message,
@@ -252,7 +256,7 @@ static uint8_t handle_request(lwm2m_context_t * contextP,
         {
             if (coap_get_header_block2(message, &block_num, NULL, &block_size, &block_offset))
             {
-                return coap_block2_stream_handler(message, response);
+                return coap_block2_stream_handler(contextP, message, response);
             }
             else
             {
@@ -265,10 +269,10 @@ static uint8_t handle_request(lwm2m_context_t * contextP,
             // Check if the prefix matches the legato app objects
             if (IsCoapUri(message->uri_path))
             {
-                if (is_block_transfer(message, &block_num, &block_size,
+                if (is_block_transfer(contextP, message, &block_num, &block_size,
                                       &block_offset) &&  (block_num != 0))
                 {
-                    async_state_t * async_stateP = &current_async_state;
+                    async_state_t * async_stateP = &contextP->packetStateP->asyncState;
                     coap_set_header_content_type(response, async_stateP->content_type);
                     coap_set_payload(response, async_stateP->bufferP, async_stateP->length);
 
@@ -451,9 +455,9 @@ static void prv_end_push(push_state_t * push_stateP)
     }
 }
 
-static void prv_end_async()
+static void prv_end_async(lwm2m_context_t * contextP)
 {
-    async_state_t * async_stateP = &current_async_state;
+    async_state_t * async_stateP = &contextP->packetStateP->asyncState;
 
     if (async_stateP->bufferP != NULL)
     {
@@ -506,7 +510,8 @@ static void prv_ack_callback(lwm2m_transaction_t * transacP, void * message)
 
 static void prv_push_callback(lwm2m_transaction_t * transacP, void * message)
 {
-    push_state_t * push_stateP = &current_push_state;
+    lwm2m_context_t * contextP = (lwm2m_context_t *)transacP->userData;
+    push_state_t * push_stateP = &contextP->packetStateP->pushState;
     coap_packet_t * ack_message = transacP->message;
     coap_packet_t * packet = (coap_packet_t *)message;
 
@@ -580,8 +585,8 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                          void * fromSessionH)
 {
     uint8_t coap_error_code = NO_ERROR;
-    static coap_packet_t message[1];
-    static coap_packet_t response[1];
+    coap_packet_t * message = contextP->packetStateP->message;
+    coap_packet_t * response = contextP->packetStateP->response;
     uint16_t payload_length;
     uint8_t* payloadP = NULL;
     uint32_t block1_num;
@@ -590,9 +595,12 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
     uint8_t * complete_buffer = NULL;
     size_t complete_buffer_size;
     lwm2m_server_t * serverP;
+#ifdef LWM2M_CLIENT_MODE
+    bool block1_stream = false;
+#endif
 
 #if SIERRA
-    push_state_t * push_stateP = &current_push_state;
+    push_state_t * push_stateP = &contextP->packetStateP->pushState;
 #endif
 
     LOG("Entering");
@@ -644,6 +652,8 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
 #ifdef LWM2M_CLIENT_MODE
                 // get server
                 serverP = utils_findServer(contextP, fromSessionH);
+                // the records of a TLV Write are written as their blocks are received
+                block1_stream = serverP != NULL && prv_isTlvWrite(contextP, message);
 #ifdef LWM2M_BOOTSTRAP
                 if (serverP == NULL)
                 {
@@ -674,6 +684,11 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                     }
                     else
 #endif
+                    if (block1_stream)
+                    {
+                        coap_error_code = coap_block1_tlv_handler(&serverP->block1Data, message->mid, message->payload, message->payload_len, block1_size, block1_num, block1_more, &complete_buffer, &complete_buffer_size);
+                    }
+                    else
                     {
                         coap_error_code = coap_block1_handler(&serverP->block1Data, message->mid, message->payload, message->payload_len, block1_size, block1_num, block1_more, &complete_buffer, &complete_buffer_size);
                     }
@@ -698,15 +713,47 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
             {
                 coap_error_code = handle_request(contextP, fromSessionH, message, response);
             }
+#ifdef LWM2M_CLIENT_MODE
+            if (block1_stream)
+            {
+                if (coap_error_code == NO_ERROR && block1_more)
+                {
+                    // the records of this block are written, ask for the next one
+                    coap_set_status_code(response, COAP_231_CONTINUE);
+                    coap_set_header_block1(response, block1_num, block1_more, MIN(block1_size, REST_MAX_CHUNK_SIZE));
+                }
+                else if (coap_error_code != NO_ERROR
+                      && coap_error_code != COAP_231_CONTINUE
+                      && coap_error_code != COAP_204_CHANGED
+                      && coap_error_code != COAP_408_REQ_ENTITY_INCOMPLETE)
+                {
+                    // the records could not be written, the next blocks are rejected
+                    free_block1_buffer(serverP->block1Data);
+                    serverP->block1Data = NULL;
+                }
+            }
+#endif
             if (coap_error_code==NO_ERROR)
             {
                 /* Save original payload pointer for later freeing. Payload in response may be updated. */
                 uint8_t *payload = response->payload;
 #if SIERRA
                 bool can_free_payload = ((response->payload != NULL)
-                                     && ((&current_async_state)->bufferP != response->payload));
+                                     && (contextP->packetStateP->asyncState.bufferP != response->payload));
+#endif
+                if ( IS_OPTION(response, COAP_OPTION_BLOCK2) )
+                {
+                    /* resource already answered with the requested block */
+                    LOG_ARG("Blockwise: block %u of %u bytes already set", response->block2_num, response->payload_len);
+#if SIERRA
+                    if(!(response->block2_more))
+                    {
+                        LOG("End of block2 transfer");
+                        prv_end_async(contextP);
+                    }
 #endif
-                if ( IS_OPTION(message, COAP_OPTION_BLOCK2) )
+                }
+                else if ( IS_OPTION(message, COAP_OPTION_BLOCK2) )
                 {
                     /* unchanged new_offset indicates that resource is unaware of blockwise transfer */
                     if (new_offset==block_offset)
@@ -731,11 +778,13 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                             memcpy(payloadP,response->payload+block_offset, payload_length);
                             coap_set_payload(response, payloadP, payload_length);
 
+#if SIERRA
                             if(!response->block2_more)
                             {
                                 LOG("End of block2 transfer");
-                                prv_end_async();
+                                prv_end_async(contextP);
                             }
+#endif
                         } /* if (valid offset) */
                     }
                     else
@@ -753,11 +802,13 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                             memcpy(payloadP,response->payload, block_size);
                             coap_set_payload(response, payloadP, block_size);
 
+#if SIERRA
                             if(!(response->block2_more))
                             {
                                 LOG("End of block2 transfer");
-                                prv_end_async();
+                                prv_end_async(contextP);
                             }
+#endif
                         }
                     } /* if (resource aware of blockwise) */
                 }
@@ -925,9 +976,9 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
 
                     // Notify when data push is acked or timed out
                     transaction->callback = prv_push_callback;
+                    transaction->userData = contextP;
 
                     // Initiate the transaction.
-                    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
                     if (transaction_send(contextP, transaction) != 0)
                     {
                         LOG("transaction failed");
@@ -961,8 +1012,10 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
     if (coap_error_code != NO_ERROR && coap_error_code != COAP_IGNORE)
 #endif
     {
+        const char * error_message = (message->error_message != NULL) ? message->error_message : "";
+
         REPORT_COAP(coap_error_code);
-        LOG_ARG("ERROR %u: %s", coap_error_code, coap_error_message);
+        LOG_ARG("ERROR %u: %s", coap_error_code, error_message);
 
         /* Set to sendable error code. */
         if (coap_error_code >= 192)
@@ -971,7 +1024,7 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
         }
         /* Reuse input buffer for error message. */
         coap_init_message(message, COAP_TYPE_ACK, coap_error_code, message->mid);
-        coap_set_payload(message, coap_error_message, strlen(coap_error_message));
+        coap_set_payload(message, error_message, strlen(error_message));
         message_send(contextP, message, fromSessionH);
     }
 }
@@ -1003,8 +1056,7 @@ bool prv_send_response(lwm2m_context_t * contextP,
                        uint16_t blockSize
                        )
 {
-    static coap_packet_t response;
-    coap_packet_t* reponsePtr = &response;
+    coap_packet_t* reponsePtr = contextP->packetStateP->appResponse;
     uint16_t block1_size;
 
     /* initialize the response */
@@ -1086,7 +1138,7 @@ bool prv_send_response(lwm2m_context_t * contextP,
     {
         coap_set_header_content_type(reponsePtr, content_type);
         coap_set_payload(reponsePtr, payload, MIN(payload_len, REST_MAX_CHUNK_SIZE));
-        coap_block2_handle_response(reponsePtr, streamStatus);
+        coap_block2_handle_response(contextP, reponsePtr, streamStatus);
     }
 
     LOG_ARG("Response code = %d", reponsePtr->code);
@@ -1121,7 +1173,7 @@ bool prv_async_response(lwm2m_context_t * contextP,
                        )
 {
     lwm2m_transaction_t * transaction;
-    async_state_t * async_stateP = &current_async_state;
+    async_state_t * async_stateP = &contextP->packetStateP->asyncState;
     coap_packet_t * response;
 
     /* initialize the transaction */
@@ -1177,7 +1229,6 @@ bool prv_async_response(lwm2m_context_t * contextP,
                                 response->block2_offset);
 
     /* send transaction */
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
     if (transaction_send(contextP, transaction) != 0) return false;
 
     return true;
@@ -1195,6 +1246,7 @@ bool prv_send_notification(lwm2m_context_t * contextP,
                            )
 {
     lwm2m_transaction_t * transaction;
+    uint32_t * block1NumP = &contextP->packetStateP->block1Num;
     bool isMore = false;
 
     if ((payloadP == NULL) || (payload_len == 0))
@@ -1222,33 +1274,33 @@ bool prv_send_notification(lwm2m_context_t * contextP,
                 break;
 
             case LWM2MCORE_TX_STREAM_START:
-                Block1Num = 0;
+                *block1NumP = 0;
                 isMore = true;
-                coap_set_header_block1(transaction->message, Block1Num, isMore, REST_MAX_CHUNK_SIZE);
-                LOG_ARG("TX Stream Status %d BlockNum %d isMore %d", streamStatus, Block1Num, isMore);
+                coap_set_header_block1(transaction->message, *block1NumP, isMore, REST_MAX_CHUNK_SIZE);
+                LOG_ARG("TX Stream Status %d BlockNum %d isMore %d", streamStatus, *block1NumP, isMore);
                 break;
 
             case LWM2MCORE_TX_STREAM_IN_PROGRESS:
-                Block1Num++;
+                (*block1NumP)++;
                 isMore = true;
-                coap_set_header_block1(transaction->message, Block1Num, isMore, REST_MAX_CHUNK_SIZE);
-                LOG_ARG("TX Stream Status %d BlockNum %d isMore %d", streamStatus, Block1Num, isMore);
+                coap_set_header_block1(transaction->message, *block1NumP, isMore, REST_MAX_CHUNK_SIZE);
+                LOG_ARG("TX Stream Status %d BlockNum %d isMore %d", streamStatus, *block1NumP, isMore);
                 break;
 
             case LWM2MCORE_TX_STREAM_END:
-                Block1Num++;
+                (*block1NumP)++;
                 isMore = false;
-                coap_set_header_block1(transaction->message, Block1Num, isMore, REST_MAX_CHUNK_SIZE);
-                LOG_ARG("TX Stream Status %d BlockNum %d isMore %d", streamStatus, Block1Num, isMore);
+                coap_set_header_block1(transaction->message, *block1NumP, isMore, REST_MAX_CHUNK_SIZE);
+                LOG_ARG("TX Stream Status %d BlockNum %d isMore %d", streamStatus, *block1NumP, isMore);
 
-                Block1Num = 0;
+                *block1NumP = 0;
 
                 // Notify when data push is acked or timed out
                 transaction->callback = prv_ack_callback;
                 break;
 
             case LWM2MCORE_TX_STREAM_ERROR:
-                Block1Num = 0;
+                *block1NumP = 0;
                 break;
 
             default:
@@ -1260,8 +1312,6 @@ bool prv_send_notification(lwm2m_context_t * contextP,
     }
 
     /* Initiate the transaction */
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     if (transaction_send(contextP, transaction) != 0)
     {
         return false;
@@ -1433,36 +1483,61 @@ uint8_t message_send(lwm2m_context_t * contextP,
                      coap_packet_t * message,
                      void * sessionH)
 {
-    uint8_t result = COAP_500_INTERNAL_SERVER_ERROR;
-    uint8_t * pktBuffer;
-    size_t pktBufferLen = 0;
-    size_t allocLen;
+    uint8_t result;
+    size_t headerLen;
+    bool firstBlock;
 
     LOG("Entering");
-    allocLen = coap_serialize_get_size(message);
-    LOG_ARG("Size to allocate: %d", allocLen);
-    if (allocLen == 0) return COAP_500_INTERNAL_SERVER_ERROR;
+    firstBlock = (message->block1_num == 0);
+
+    // The header is serialized once in the context buffer, the payload stays where it is
+    headerLen = coap_serialize_header(message, contextP->sendBuffer, sizeof(contextP->sendBuffer));
+    LOG_ARG("coap_serialize_header() returned %d", headerLen);
+    if (headerLen == 0) return COAP_500_INTERNAL_SERVER_ERROR;
+
+#ifdef LWM2M_WITH_SENDV
+    {
+        lwm2m_iovec_t vector[2];
 
-    pktBuffer = (uint8_t *)lwm2m_malloc(allocLen);
-    if (pktBuffer != NULL)
+        vector[0].buffer = contextP->sendBuffer;
+        vector[0].length = headerLen;
+        vector[1].buffer = message->payload;
+        vector[1].length = message->payload_len;
+
+        result = lwm2m_buffer_sendv(sessionH, vector, message->payload_len ? 2 : 1, contextP->userData, firstBlock);
+    }
+#else
+    if (headerLen + message->payload_len <= sizeof(contextP->sendBuffer))
     {
-        pktBufferLen = coap_serialize_message(message, pktBuffer);
-        LOG_ARG("coap_serialize_message() returned %d", pktBufferLen);
-        if (0 != pktBufferLen)
+        if (message->payload_len != 0)
         {
-            result = lwm2m_buffer_send(sessionH, pktBuffer, pktBufferLen, contextP->userData, message->block1_num == 0);
+            memcpy(contextP->sendBuffer + headerLen, message->payload, message->payload_len);
         }
+        result = lwm2m_buffer_send(sessionH, contextP->sendBuffer, headerLen + message->payload_len, contextP->userData, firstBlock);
+    }
+    else
+    {
+        uint8_t * pktBuffer;
+
+        pktBuffer = (uint8_t *)lwm2m_malloc(headerLen + message->payload_len);
+        if (pktBuffer == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+
+        memcpy(pktBuffer, contextP->sendBuffer, headerLen);
+        memcpy(pktBuffer + headerLen, message->payload, message->payload_len);
+        result = lwm2m_buffer_send(sessionH, pktBuffer, headerLen + message->payload_len, contextP->userData, firstBlock);
         lwm2m_free(pktBuffer);
     }
+#endif
 
     return result;
 }
 
 #if SIERRA
 
-void lwm2m_set_push_callback(lwm2m_push_ack_callback_t callbackP)
+void lwm2m_set_push_callback(lwm2m_context_t * contextP,
+                             lwm2m_push_ack_callback_t callbackP)
 {
-    push_state_t * push_stateP = &current_push_state;
+    push_state_t * push_stateP = &contextP->packetStateP->pushState;
     push_stateP->callbackP = callbackP;
 }
 
@@ -1475,7 +1550,7 @@ static int prv_data_push(lwm2m_context_t * contextP,
                        )
 {
     lwm2m_transaction_t * transaction;
-    push_state_t * push_stateP = &current_push_state;
+    push_state_t * push_stateP = &contextP->packetStateP->pushState;
 
     if ((payloadP == NULL) || (payload_len == 0))
     {
@@ -1532,9 +1607,9 @@ static int prv_data_push(lwm2m_context_t * contextP,
 
     // Notify when data push is acked or timed out
     transaction->callback = prv_push_callback;
+    transaction->userData = contextP;
 
     // Initiate the transaction.
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
     if (transaction_send(contextP, transaction) != 0)
     {
         return COAP_500_INTERNAL_SERVER_ERROR;
@@ -1553,9 +1628,9 @@ static int prv_data_push(lwm2m_context_t * contextP,
 }
 
 // End lwm2m data push
-void lwm2m_end_push(void)
+void lwm2m_end_push(lwm2m_context_t * contextP)
 {
-    push_state_t * push_stateP = &current_push_state;
+    push_state_t * push_stateP = &contextP->packetStateP->pushState;
     prv_end_push(push_stateP);
 }
 
@@ -192,6 +192,22 @@ static int prv_getRegistrationQuery(lwm2m_context_t * contextP,
     return index;
 }
 
+// registration is the date exposed to the application, registrationMs drives the updates
+static void prv_setRegistrationTime(lwm2m_server_t * targetP)
+{
+    time_t tv_sec = lwm2m_gettime();
+    int64_t currentTime = utils_gettimeMs();
+
+    if ((int32_t)tv_sec >= 0)
+    {
+        targetP->registration = tv_sec;
+    }
+    if (currentTime >= 0)
+    {
+        targetP->registrationMs = currentTime;
+    }
+}
+
 static void prv_handleRegistrationReply(lwm2m_transaction_t * transacP,
                                         void * message)
 {
@@ -200,12 +216,7 @@ static void prv_handleRegistrationReply(lwm2m_transaction_t * transacP,
 
     if (targetP->status == STATE_REG_PENDING)
     {
-        time_t tv_sec = lwm2m_gettime();
-
-        if ((int32_t)tv_sec >= 0)
-        {
-            targetP->registration = tv_sec;
-        }
+        prv_setRegistrationTime(targetP);
 
         if (packet != NULL && packet->code == COAP_201_CREATED)
         {
@@ -306,7 +317,6 @@ static uint8_t prv_register(lwm2m_context_t * contextP,
     transaction->callback = prv_handleRegistrationReply;
     transaction->userData = (void *) server;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
     if (transaction_send(contextP, transaction) != 0)
     {
         lwm2m_free(payload);
@@ -329,12 +339,7 @@ static void prv_handleRegistrationUpdateReply(lwm2m_transaction_t * transacP,
 
     if (targetP->status == STATE_REG_UPDATE_PENDING)
     {
-        time_t tv_sec = lwm2m_gettime();
-
-        if ((int32_t)tv_sec >= 0)
-        {
-            targetP->registration = tv_sec;
-        }
+        prv_setRegistrationTime(targetP);
 
         if (packet != NULL && packet->code == COAP_204_CHANGED)
         {
@@ -656,8 +661,6 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
     transaction->callback = prv_handleRegistrationUpdateReply;
     transaction->userData = (void *) server;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
-
     if (transaction_send(contextP, transaction) == 0)
     {
         server->status = STATE_REG_UPDATE_PENDING;
@@ -899,7 +902,6 @@ bool registration_deregister(lwm2m_context_t * contextP,
     transaction->callback = prv_handleDeregistrationReply;
     transaction->userData = (void *) serverP;
 
-    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
     if (transaction_send(contextP, transaction) == 0)
     {
         serverP->status = STATE_DEREG_PENDING;
@@ -910,25 +912,61 @@ bool registration_deregister(lwm2m_context_t * contextP,
 #endif
 
 #ifdef LWM2M_SERVER_MODE
-static void prv_freeClientObjectList(lwm2m_client_object_t * objects)
+static void prv_freeClientObjectList(lwm2m_client_object_list_t * objects)
 {
-    while (objects != NULL)
+    // the objects and their instances share the allocation of the list
+    if (objects != NULL) lwm2m_free(objects);
+}
+
+static lwm2m_client_object_t * prv_findClientObject(lwm2m_client_object_list_t * objects,
+                                                    uint16_t id)
+{
+    size_t low = 0;
+    size_t high = objects->count;
+
+    while (low < high)
     {
-        lwm2m_client_object_t * objP;
+        size_t middle = low + (high - low) / 2;
 
-        while (objects->instanceList != NULL)
-        {
-            lwm2m_list_t * target;
+        if (objects->objects[middle].id == id) return objects->objects + middle;
+        if (objects->objects[middle].id < id) low = middle + 1;
+        else high = middle;
+    }
 
-            target = objects->instanceList;
-            objects->instanceList = objects->instanceList->next;
-            lwm2m_free(target);
-        }
+    return NULL;
+}
 
-        objP = objects;
-        objects = objects->next;
-        lwm2m_free(objP);
+static bool prv_hasClientInstance(lwm2m_client_object_t * objectP,
+                                  uint16_t id)
+{
+    size_t low = 0;
+    size_t high = objectP->instanceCount;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (objectP->instances[middle] == id) return true;
+        if (objectP->instances[middle] < id) low = middle + 1;
+        else high = middle;
     }
+
+    return false;
+}
+
+// FNV-1a, 64 bits so that a changed object list is not mistaken for the previous one
+static uint64_t prv_hashPayload(const uint8_t * payload,
+                                size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t i;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        hash = (hash ^ payload[i]) * 1099511628211ull;
+    }
+
+    return hash;
 }
 
 static int prv_getParameters(multi_option_t * query,
@@ -1218,21 +1256,111 @@ static int prv_getId(uint8_t * data,
     return 1;
 }
 
-static lwm2m_client_object_t * prv_decodeRegisterPayload(uint8_t * payload,
-                                                         uint16_t payloadLength,
-                                                         bool * supportJSON,
-                                                         char ** altPath)
+// Links kept on the stack while decoding a Register payload, larger payloads use the heap
+#define PRV_LINK_STACK_COUNT    64
+
+// A link is keyed by (object ID << 16 | instance ID), LWM2M_MAX_ID as instance for an object link
+static int prv_compareLinks(const void * link1,
+                            const void * link2)
+{
+    uint32_t key1 = *(const uint32_t *)link1;
+    uint32_t key2 = *(const uint32_t *)link2;
+
+    return (key1 > key2) - (key1 < key2);
+}
+
+// Pack sorted links in a single allocation
+static lwm2m_client_object_list_t * prv_packLinks(uint32_t * links,
+                                                  size_t count)
+{
+    lwm2m_client_object_list_t * objects;
+    uint16_t * instanceP;
+    size_t objectCount;
+    size_t instanceCount;
+    size_t i;
+
+    objectCount = 0;
+    instanceCount = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        if (i > 0 && links[i] == links[i - 1]) continue;
+        if (i == 0 || (links[i] >> 16) != (links[i - 1] >> 16)) objectCount++;
+        if ((links[i] & 0xFFFF) != LWM2M_MAX_ID) instanceCount++;
+    }
+
+    objects = (lwm2m_client_object_list_t *)lwm2m_malloc(sizeof(lwm2m_client_object_list_t)
+                                                         + objectCount * sizeof(lwm2m_client_object_t)
+                                                         + instanceCount * sizeof(uint16_t));
+    if (objects == NULL) return NULL;
+
+    objects->count = 0;
+    objects->objects = (lwm2m_client_object_t *)(objects + 1);
+    instanceP = (uint16_t *)(objects->objects + objectCount);
+    for (i = 0 ; i < count ; i++)
+    {
+        lwm2m_client_object_t * objectP;
+
+        if (i > 0 && links[i] == links[i - 1]) continue;
+
+        if (i == 0 || (links[i] >> 16) != (links[i - 1] >> 16))
+        {
+            objectP = objects->objects + objects->count;
+            objectP->id = (uint16_t)(links[i] >> 16);
+            objectP->instanceCount = 0;
+            objectP->instances = instanceP;
+            objects->count++;
+        }
+        else
+        {
+            objectP = objects->objects + objects->count - 1;
+        }
+
+        if ((links[i] & 0xFFFF) != LWM2M_MAX_ID)
+        {
+            *instanceP = (uint16_t)(links[i] & 0xFFFF);
+            instanceP++;
+            objectP->instanceCount++;
+        }
+    }
+
+    return objects;
+}
+
+static lwm2m_client_object_list_t * prv_decodeRegisterPayload(uint8_t * payload,
+                                                              uint16_t payloadLength,
+                                                              bool * supportJSON,
+                                                              char ** altPath)
 {
+    uint32_t stackLinks[PRV_LINK_STACK_COUNT];
+    uint32_t * links;
+    lwm2m_client_object_list_t * objects;
+    size_t linkCount;
+    size_t maxCount;
     uint16_t index;
-    lwm2m_client_object_t * objList;
     bool linkAttrFound;
+    bool sorted;
 
     *altPath = NULL;
     *supportJSON = false;
-    objList = NULL;
+    objects = NULL;
     linkAttrFound = false;
-    index = 0;
+    sorted = true;
+    linkCount = 0;
+
+    // one link at most between two delimiters
+    maxCount = 1;
+    for (index = 0 ; index < payloadLength ; index++)
+    {
+        if (payload[index] == REG_DELIMITER) maxCount++;
+    }
+    links = stackLinks;
+    if (maxCount > PRV_LINK_STACK_COUNT)
+    {
+        links = (uint32_t *)lwm2m_malloc(maxCount * sizeof(uint32_t));
+        if (links == NULL) return NULL;
+    }
 
+    index = 0;
     while (index <= payloadLength)
     {
         uint16_t start;
@@ -1251,30 +1379,12 @@ static lwm2m_client_object_t * prv_decodeRegisterPayload(uint8_t * payload,
         result = prv_getId(payload + start, length, &id, &instance);
         if (result != 0)
         {
-            lwm2m_client_object_t * objectP;
-
-            objectP = (lwm2m_client_object_t *)lwm2m_list_find((lwm2m_list_t *)objList, id);
-            if (objectP == NULL)
-            {
-                objectP = (lwm2m_client_object_t *)lwm2m_malloc(sizeof(lwm2m_client_object_t));
-                memset(objectP, 0, sizeof(lwm2m_client_object_t));
-                if (objectP == NULL) goto error;
-                objectP->id = id;
-                objList = (lwm2m_client_object_t *)LWM2M_LIST_ADD(objList, objectP);
-            }
-            if (result == 2)
-            {
-                lwm2m_list_t * instanceP;
+            uint32_t link;
 
-                instanceP = lwm2m_list_find(objectP->instanceList, instance);
-                if (instanceP == NULL)
-                {
-                    instanceP = (lwm2m_list_t *)lwm2m_malloc(sizeof(lwm2m_list_t));
-                    memset(instanceP, 0, sizeof(lwm2m_list_t));
-                    instanceP->id = instance;
-                    objectP->instanceList = LWM2M_LIST_ADD(objectP->instanceList, instanceP);
-                }
-            }
+            link = ((uint32_t)id << 16) | (result == 2 ? instance : LWM2M_MAX_ID);
+            if (linkCount > 0 && link < links[linkCount - 1]) sorted = false;
+            links[linkCount] = link;
+            linkCount++;
         }
         else if (linkAttrFound == false)
         {
@@ -1288,7 +1398,16 @@ static lwm2m_client_object_t * prv_decodeRegisterPayload(uint8_t * payload,
         index++;
     }
 
-    return objList;
+    if (linkCount > 0)
+    {
+        // clients usually list their objects in order, the sort is then skipped
+        if (!sorted) qsort(links, linkCount, sizeof(uint32_t), prv_compareLinks);
+        objects = prv_packLinks(links, linkCount);
+        if (objects == NULL) goto error;
+    }
+
+    if (links != stackLinks) lwm2m_free(links);
+    return objects;
 
 error:
     if (*altPath != NULL)
@@ -1296,23 +1415,318 @@ error:
         lwm2m_free(*altPath);
         *altPath = NULL;
     }
-    prv_freeClientObjectList(objList);
+    if (links != stackLinks) lwm2m_free(links);
 
     return NULL;
 }
 
-static lwm2m_client_t * prv_getClientByName(lwm2m_context_t * contextP,
-                                            char * name)
+/*
+ * Client registry
+ *
+ * The registered clients are linked in contextP->clientList, the last registered one
+ * first, and indexed by internal ID, endpoint name and session handle in hash indexes,
+ * see hashindex.c. Each Register, Update, Deregister,
+ * device management request or notification thus finds its client in constant time.
+ */
+
+static uint32_t prv_hashId(uint32_t id)
 {
-    lwm2m_client_t * targetP;
+    uint32_t hash;
+
+    hash = (uint32_t)id * 2654435761u;
+    return hash ^ (hash >> 16);
+}
 
-    targetP = contextP->clientList;
-    while (targetP != NULL && strcmp(name, targetP->name) != 0)
+static uint32_t prv_hashName(const char * name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name != 0)
     {
-        targetP = targetP->next;
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+        name++;
+    }
+
+    return hash;
+}
+
+static uint32_t prv_hashSession(void * sessionH)
+{
+    uint64_t value = (uint64_t)(uintptr_t)sessionH;
+
+    value *= 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(value >> 32);
+}
+
+static uint32_t prv_idKey(void * entryP)
+{
+    return prv_hashId(((lwm2m_client_t *)entryP)->internalID);
+}
+
+static uint32_t prv_nameKey(void * entryP)
+{
+    return ((lwm2m_client_t *)entryP)->nameHash;
+}
+
+static uint32_t prv_sessionKey(void * entryP)
+{
+    return prv_hashSession(((lwm2m_client_t *)entryP)->sessionH);
+}
+
+/*
+ * Client ID allocator
+ *
+ * As lwm2m_list_newId() did, a new client gets the lowest ID not in use, so the IDs stay
+ * dense. The bitmap of the IDs in use doubles when full, and the lowest free ID is found
+ * through the bitmap of the full words, one bit for 32 IDs.
+ */
+
+#define PRV_CLIENT_ID_MIN_SIZE  1024
+#define PRV_CLIENT_ID_MAX       UINT32_MAX
+
+static uint32_t prv_lowestClearBit(uint32_t word)
+{
+    uint32_t bit = 0;
+
+    word = ~word;
+    if ((word & 0xFFFF) == 0) { word >>= 16; bit += 16; }
+    if ((word & 0xFF) == 0) { word >>= 8; bit += 8; }
+    if ((word & 0x0F) == 0) { word >>= 4; bit += 4; }
+    if ((word & 0x03) == 0) { word >>= 2; bit += 2; }
+    if ((word & 0x01) == 0) { bit += 1; }
+
+    return bit;
+}
+
+static bool prv_clientIdGrow(lwm2m_client_id_map_t * mapP)
+{
+    uint32_t * used;
+    uint32_t * full;
+    size_t newSize;
+
+    if (mapP->size > PRV_CLIENT_ID_MAX / 2) return false;
+    newSize = (mapP->size == 0) ? PRV_CLIENT_ID_MIN_SIZE : mapP->size * 2;
+
+    used = (uint32_t *)lwm2m_malloc(newSize / 8);
+    full = (uint32_t *)lwm2m_malloc(newSize / 256);
+    if (NULL == used || NULL == full)
+    {
+        if (NULL != used) lwm2m_free(used);
+        if (NULL != full) lwm2m_free(full);
+        return false;
+    }
+    memset(used, 0, newSize / 8);
+    memset(full, 0, newSize / 256);
+    if (0 != mapP->size)
+    {
+        memcpy(used, mapP->used, mapP->size / 8);
+        memcpy(full, mapP->full, mapP->size / 256);
+        lwm2m_free(mapP->used);
+        lwm2m_free(mapP->full);
+    }
+    mapP->used = used;
+    mapP->full = full;
+    mapP->size = newSize;
+
+    return true;
+}
+
+static bool prv_newClientId(lwm2m_context_t * contextP,
+                            uint32_t * idP)
+{
+    lwm2m_client_id_map_t * mapP = &contextP->clientIds;
+    size_t fullCount;
+    size_t word;
+    uint32_t bit;
+
+    fullCount = mapP->size / 1024;
+    while (mapP->firstFree < fullCount && mapP->full[mapP->firstFree] == 0xFFFFFFFF)
+    {
+        mapP->firstFree++;
+    }
+    if (mapP->firstFree == fullCount)
+    {
+        if (!prv_clientIdGrow(mapP)) return false;
+    }
+
+    word = mapP->firstFree * 32 + prv_lowestClearBit(mapP->full[mapP->firstFree]);
+    bit = prv_lowestClearBit(mapP->used[word]);
+    if (word * 32 + bit > PRV_CLIENT_ID_MAX) return false;
+
+    mapP->used[word] |= (uint32_t)1 << bit;
+    if (mapP->used[word] == 0xFFFFFFFF)
+    {
+        mapP->full[word / 32] |= (uint32_t)1 << (word % 32);
+    }
+    mapP->count++;
+
+    *idP = (uint32_t)(word * 32 + bit);
+    return true;
+}
+
+static void prv_freeClientId(lwm2m_context_t * contextP,
+                             uint32_t id)
+{
+    lwm2m_client_id_map_t * mapP = &contextP->clientIds;
+    size_t word = id / 32;
+
+    if (id >= mapP->size) return;
+    if ((mapP->used[word] & ((uint32_t)1 << (id % 32))) == 0) return;
+
+    mapP->used[word] &= ~((uint32_t)1 << (id % 32));
+    mapP->full[word / 32] &= ~((uint32_t)1 << (word % 32));
+    mapP->count--;
+    if (word / 32 < mapP->firstFree) mapP->firstFree = word / 32;
+}
+
+// Allocate the internal ID of clientP and index it, its name and sessionH must be set
+static bool prv_addClient(lwm2m_context_t * contextP,
+                          lwm2m_client_t * clientP)
+{
+    clientP->nameHash = prv_hashName(clientP->name);
+
+    if (!prv_newClientId(contextP, &clientP->internalID)) return false;
+    if (!hashindex_insert(&contextP->clientById, clientP, prv_idKey))
+    {
+        prv_freeClientId(contextP, clientP->internalID);
+        return false;
+    }
+    if (!hashindex_insert(&contextP->clientByName, clientP, prv_nameKey))
+    {
+        hashindex_remove(&contextP->clientById, clientP, prv_idKey);
+        prv_freeClientId(contextP, clientP->internalID);
+        return false;
+    }
+    if (!hashindex_insert(&contextP->clientBySession, clientP, prv_sessionKey))
+    {
+        hashindex_remove(&contextP->clientById, clientP, prv_idKey);
+        hashindex_remove(&contextP->clientByName, clientP, prv_nameKey);
+        prv_freeClientId(contextP, clientP->internalID);
+        return false;
+    }
+
+    clientP->prev = NULL;
+    clientP->next = contextP->clientList;
+    if (NULL != clientP->next) clientP->next->prev = clientP;
+    contextP->clientList = clientP;
+
+    return true;
+}
+
+static void prv_removeClient(lwm2m_context_t * contextP,
+                             lwm2m_client_t * clientP)
+{
+    hashindex_remove(&contextP->clientById, clientP, prv_idKey);
+    hashindex_remove(&contextP->clientByName, clientP, prv_nameKey);
+    hashindex_remove(&contextP->clientBySession, clientP, prv_sessionKey);
+    prv_freeClientId(contextP, clientP->internalID);
+    deadline_cancel(&contextP->clientDeadlines, &clientP->expiry);
+
+    if (NULL != clientP->prev) clientP->prev->next = clientP->next;
+    else contextP->clientList = clientP->next;
+    if (NULL != clientP->next) clientP->next->prev = clientP->prev;
+    clientP->next = NULL;
+    clientP->prev = NULL;
+}
+
+// (Re)schedule the expiry of clientP, lifetime seconds after currentTime. This only fails for a client not yet scheduled.
+static bool prv_scheduleExpiry(lwm2m_context_t * contextP,
+                               lwm2m_client_t * clientP,
+                               int64_t currentTime)
+{
+    return deadline_schedule(&contextP->clientDeadlines, &clientP->expiry, currentTime + (int64_t)clientP->lifetime * MS_PER_SECOND);
+}
+
+static bool prv_setClientSession(lwm2m_context_t * contextP,
+                                 lwm2m_client_t * clientP,
+                                 void * sessionH)
+{
+    if (clientP->sessionH == sessionH) return true;
+
+    hashindex_remove(&contextP->clientBySession, clientP, prv_sessionKey);
+    clientP->sessionH = sessionH;
+
+    return hashindex_insert(&contextP->clientBySession, clientP, prv_sessionKey);
+}
+
+lwm2m_client_t * lwm2m_get_client(lwm2m_context_t * contextP,
+                                  uint32_t clientID)
+{
+    lwm2m_hash_index_t * indexP = &contextP->clientById;
+    size_t mask = indexP->size - 1;
+    size_t i;
+
+    if (0 == indexP->size) return NULL;
+
+    for (i = prv_hashId(clientID) & mask ; NULL != indexP->slots[i] ; i = (i + 1) & mask)
+    {
+        lwm2m_client_t * clientP = (lwm2m_client_t *)indexP->slots[i];
+
+        if (clientP->internalID == clientID) return clientP;
+    }
+
+    return NULL;
+}
+
+lwm2m_client_t * lwm2m_get_client_by_name(lwm2m_context_t * contextP,
+                                          const char * name)
+{
+    lwm2m_hash_index_t * indexP = &contextP->clientByName;
+    size_t mask = indexP->size - 1;
+    uint32_t hash;
+    size_t i;
+
+    if (0 == indexP->size) return NULL;
+
+    hash = prv_hashName(name);
+    for (i = hash & mask ; NULL != indexP->slots[i] ; i = (i + 1) & mask)
+    {
+        lwm2m_client_t * clientP = (lwm2m_client_t *)indexP->slots[i];
+
+        if (clientP->nameHash == hash && strcmp(clientP->name, name) == 0) return clientP;
+    }
+
+    return NULL;
+}
+
+lwm2m_client_t * lwm2m_get_client_by_session(lwm2m_context_t * contextP,
+                                             void * sessionH)
+{
+    lwm2m_hash_index_t * indexP = &contextP->clientBySession;
+    size_t mask = indexP->size - 1;
+    size_t i;
+
+    if (0 == indexP->size) return NULL;
+
+    for (i = prv_hashSession(sessionH) & mask ; NULL != indexP->slots[i] ; i = (i + 1) & mask)
+    {
+        lwm2m_client_t * clientP = (lwm2m_client_t *)indexP->slots[i];
+
+        if (clientP->sessionH == sessionH) return clientP;
     }
 
-    return targetP;
+    return NULL;
+}
+
+void registration_freeClientList(lwm2m_context_t * contextP)
+{
+    deadline_free(&contextP->clientDeadlines);
+    while (NULL != contextP->clientList)
+    {
+        lwm2m_client_t * clientP;
+
+        clientP = contextP->clientList;
+        contextP->clientList = contextP->clientList->next;
+
+        registration_freeClient(clientP);
+    }
+    observe_freeTable(contextP);
+    hashindex_free(&contextP->clientById);
+    hashindex_free(&contextP->clientByName);
+    hashindex_free(&contextP->clientBySession);
+    if (NULL != contextP->clientIds.used) lwm2m_free(contextP->clientIds.used);
+    if (NULL != contextP->clientIds.full) lwm2m_free(contextP->clientIds.full);
+    memset(&contextP->clientIds, 0, sizeof(lwm2m_client_id_map_t));
 }
 
 void registration_freeClient(lwm2m_client_t * clientP)
@@ -1328,12 +1742,12 @@ void registration_freeClient(lwm2m_client_t * clientP)
 
         targetP = clientP->observationList;
         clientP->observationList = clientP->observationList->next;
-        lwm2m_free(targetP);
+        observe_free(targetP);
     }
     lwm2m_free(clientP);
 }
 
-static int prv_getLocationString(uint16_t id,
+static int prv_getLocationString(uint32_t id,
                                  char location[MAX_LOCATION_LENGTH])
 {
     int index;
@@ -1359,10 +1773,14 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
 {
     uint8_t result;
     time_t tv_sec;
+    int64_t currentTime;
 
     LOG_URI(uriP);
+    // endOfLife is a date for the application, the expiry is scheduled on the library clock
     tv_sec = lwm2m_gettime();
     if (tv_sec < 0) return COAP_500_INTERNAL_SERVER_ERROR;
+    currentTime = utils_gettimeMs();
+    if (currentTime < 0) return COAP_500_INTERNAL_SERVER_ERROR;
 
     switch(message->code)
     {
@@ -1374,7 +1792,8 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
         char * altPath;
         char * version;
         lwm2m_binding_t binding;
-        lwm2m_client_object_t * objects;
+        lwm2m_client_object_list_t * objects;
+        uint64_t payloadHash;
         bool supportJSON;
         lwm2m_client_t * clientP;
         char location[MAX_LOCATION_LENGTH];
@@ -1389,12 +1808,14 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             return COAP_400_BAD_REQUEST;
         }
 
-        objects = prv_decodeRegisterPayload(message->payload, message->payload_len, &supportJSON, &altPath);
+        payloadHash = prv_hashPayload(message->payload, message->payload_len);
 
-        switch (uriP->flag & LWM2M_URI_MASK_ID)
+        switch (uriP->flag & (LWM2M_URI_MASK_ID | LWM2M_URI_FLAG_REGISTRATION_ID))
         {
         case 0:
             // Register operation
+            objects = prv_decodeRegisterPayload(message->payload, message->payload_len, &supportJSON, &altPath);
+
             // Version is mandatory
             if (version == NULL)
             {
@@ -1426,21 +1847,37 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                 if (msisdn != NULL) lwm2m_free(msisdn);
                 return COAP_412_PRECONDITION_FAILED;
             }
+            lwm2m_free(version);
 
             if (lifetime == 0)
             {
                 lifetime = LWM2M_DEFAULT_LIFETIME;
             }
 
-            clientP = prv_getClientByName(contextP, name);
+            clientP = lwm2m_get_client_by_name(contextP, name);
             if (clientP != NULL)
             {
-                // we reset this registration
+                // we reset this registration, the new name is the same string
                 lwm2m_free(clientP->name);
                 if (clientP->msisdn != NULL) lwm2m_free(clientP->msisdn);
                 if (clientP->altPath != NULL) lwm2m_free(clientP->altPath);
                 prv_freeClientObjectList(clientP->objectList);
                 clientP->objectList = NULL;
+                clientP->name = name;
+                if (!prv_setClientSession(contextP, clientP, fromSessionH))
+                {
+                    // the previous registration is lost as well
+                    prv_removeClient(contextP, clientP);
+                    if (contextP->monitorCallback != NULL)
+                    {
+                        contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
+                    }
+                    clientP->altPath = altPath;
+                    clientP->msisdn = msisdn;
+                    clientP->objectList = objects;
+                    registration_freeClient(clientP);
+                    return COAP_500_INTERNAL_SERVER_ERROR;
+                }
             }
             else
             {
@@ -1454,10 +1891,17 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                     return COAP_500_INTERNAL_SERVER_ERROR;
                 }
                 memset(clientP, 0, sizeof(lwm2m_client_t));
-                clientP->internalID = lwm2m_list_newId((lwm2m_list_t *)contextP->clientList);
-                contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_ADD(contextP->clientList, clientP);
+                clientP->name = name;
+                clientP->sessionH = fromSessionH;
+                if (!prv_addClient(contextP, clientP))
+                {
+                    clientP->altPath = altPath;
+                    clientP->msisdn = msisdn;
+                    clientP->objectList = objects;
+                    registration_freeClient(clientP);
+                    return COAP_500_INTERNAL_SERVER_ERROR;
+                }
             }
-            clientP->name = name;
             clientP->binding = binding;
             clientP->msisdn = msisdn;
             clientP->altPath = altPath;
@@ -1465,15 +1909,24 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             clientP->lifetime = lifetime;
             clientP->endOfLife = tv_sec + lifetime;
             clientP->objectList = objects;
-            clientP->sessionH = fromSessionH;
+            clientP->payloadHash = payloadHash;
+
+            if (!prv_scheduleExpiry(contextP, clientP, currentTime))
+            {
+                prv_removeClient(contextP, clientP);
+                registration_freeClient(clientP);
+                return COAP_500_INTERNAL_SERVER_ERROR;
+            }
 
             if (prv_getLocationString(clientP->internalID, location) == 0)
             {
+                prv_removeClient(contextP, clientP);
                 registration_freeClient(clientP);
                 return COAP_500_INTERNAL_SERVER_ERROR;
             }
             if (coap_set_header_location_path(response, location) == 0)
             {
+                prv_removeClient(contextP, clientP);
                 registration_freeClient(clientP);
                 return COAP_500_INTERNAL_SERVER_ERROR;
             }
@@ -1485,10 +1938,19 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             result = COAP_201_CREATED;
             break;
 
-        case LWM2M_URI_FLAG_OBJECT_ID:
-            clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, uriP->objectId);
+        case LWM2M_URI_FLAG_REGISTRATION_ID:
+            clientP = lwm2m_get_client(contextP, uriP->registrationId);
             if (clientP == NULL) return COAP_404_NOT_FOUND;
 
+            objects = NULL;
+            // most clients send the same object list again, it is then neither decoded nor compared
+            if (message->payload_len != 0 && payloadHash != clientP->payloadHash)
+            {
+                objects = prv_decodeRegisterPayload(message->payload, message->payload_len, &supportJSON, &altPath);
+                // the alternate path cannot change during a registration
+                if (altPath != NULL) lwm2m_free(altPath);
+            }
+
             // Endpoint client name MUST NOT be present
             if (name != NULL)
             {
@@ -1511,7 +1973,18 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                 clientP->lifetime = lifetime;
             }
             // client IP address, port or MSISDN may have changed
-            clientP->sessionH = fromSessionH;
+            if (!prv_setClientSession(contextP, clientP, fromSessionH))
+            {
+                // not reachable through its new session, the client must register again
+                prv_removeClient(contextP, clientP);
+                if (contextP->monitorCallback != NULL)
+                {
+                    contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
+                }
+                registration_freeClient(clientP);
+                if (objects != NULL) prv_freeClientObjectList(objects);
+                return COAP_500_INTERNAL_SERVER_ERROR;
+            }
 
             if (objects != NULL)
             {
@@ -1526,7 +1999,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
 
                     nextP = observationP->next;
 
-                    objP = (lwm2m_client_object_t *)lwm2m_list_find((lwm2m_list_t *)objects, observationP->uri.objectId);
+                    objP = prv_findClientObject(objects, observationP->uri.objectId);
                     if (objP == NULL)
                     {
                         observationP->callback(clientP->internalID,
@@ -1540,7 +2013,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                     {
                         if ((observationP->uri.flag & LWM2M_URI_FLAG_INSTANCE_ID) != 0)
                         {
-                            if (lwm2m_list_find((lwm2m_list_t *)objP->instanceList, observationP->uri.instanceId) == NULL)
+                            if (!prv_hasClientInstance(objP, observationP->uri.instanceId))
                             {
                                 observationP->callback(clientP->internalID,
                                                        &observationP->uri,
@@ -1557,9 +2030,11 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
 
                 prv_freeClientObjectList(clientP->objectList);
                 clientP->objectList = objects;
+                clientP->payloadHash = payloadHash;
             }
 
             clientP->endOfLife = tv_sec + clientP->lifetime;
+            (void)prv_scheduleExpiry(contextP, clientP, currentTime);
 
             if (contextP->monitorCallback != NULL)
             {
@@ -1578,10 +2053,11 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
     {
         lwm2m_client_t * clientP;
 
-        if ((uriP->flag & LWM2M_URI_MASK_ID) != LWM2M_URI_FLAG_OBJECT_ID) return COAP_400_BAD_REQUEST;
+        if ((uriP->flag & LWM2M_URI_FLAG_REGISTRATION_ID) == 0) return COAP_400_BAD_REQUEST;
 
-        contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, uriP->objectId, &clientP);
+        clientP = lwm2m_get_client(contextP, uriP->registrationId);
         if (clientP == NULL) return COAP_400_BAD_REQUEST;
+        prv_removeClient(contextP, clientP);
         if (contextP->monitorCallback != NULL)
         {
             contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
@@ -1611,8 +2087,8 @@ void lwm2m_set_monitoring_callback(lwm2m_context_t * contextP,
 // for each server update the registration if needed
 // for each client check if the registration expired
 void registration_step(lwm2m_context_t * contextP,
-                       time_t currentTime,
-                       time_t * timeoutP)
+                       int64_t currentTime,
+                       int64_t * timeoutP)
 {
 #ifdef LWM2M_CLIENT_MODE
     lwm2m_server_t * targetP = contextP->serverList;
@@ -1627,7 +2103,7 @@ void registration_step(lwm2m_context_t * contextP,
         case STATE_REGISTERED:
         {
             time_t nextUpdate;
-            time_t interval;
+            int64_t interval;
 
             nextUpdate = targetP->lifetime;
             if (COAP_MAX_TRANSMIT_WAIT < nextUpdate)
@@ -1639,7 +2115,7 @@ void registration_step(lwm2m_context_t * contextP,
                 nextUpdate = nextUpdate >> 1;
             }
 
-            interval = targetP->registration + nextUpdate - currentTime;
+            interval = targetP->registrationMs + (int64_t)nextUpdate * MS_PER_SECOND - currentTime;
             if (0 >= interval)
             {
                 LOG("Updating registration");
@@ -1653,7 +2129,7 @@ void registration_step(lwm2m_context_t * contextP,
         break;
 
         case STATE_REG_UPDATE_FAILED:
-            *timeoutP = 1;
+            *timeoutP = MS_PER_SECOND;
             break;
 
         case STATE_REG_UPDATE_NEEDED:
@@ -1680,37 +2156,23 @@ void registration_step(lwm2m_context_t * contextP,
 
 #endif
 #ifdef LWM2M_SERVER_MODE
-    lwm2m_client_t * clientP;
+    lwm2m_deadline_t * nodeP;
 
     LOG("Entering");
-    // monitor clients lifetime
-    clientP = contextP->clientList;
-    while (clientP != NULL)
+    // monitor clients lifetime, only the clients due are visited
+    while (NULL != (nodeP = deadline_first(&contextP->clientDeadlines))
+        && nodeP->deadline <= currentTime)
     {
-        lwm2m_client_t * nextP = clientP->next;
+        lwm2m_client_t * clientP = LWM2M_CONTAINER_OF(nodeP, lwm2m_client_t, expiry);
 
-        if (clientP->endOfLife <= currentTime)
-        {
-            contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, clientP->internalID, NULL);
-            if (contextP->monitorCallback != NULL)
-            {
-                contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
-            }
-            registration_freeClient(clientP);
-        }
-        else
+        prv_removeClient(contextP, clientP);
+        if (contextP->monitorCallback != NULL)
         {
-            time_t interval;
-
-            interval = clientP->endOfLife - currentTime;
-
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
+            contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
         }
-        clientP = nextP;
+        registration_freeClient(clientP);
     }
+    *timeoutP = deadline_interval(&contextP->clientDeadlines, currentTime, *timeoutP);
 #endif
 
 }
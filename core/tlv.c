@@ -301,6 +301,81 @@ int lwm2m_decode_TLV(const uint8_t * buffer,
 }
 
 
+// Number of records at the top level of buffer, up to the first malformed one
+static int prv_countRecords(const uint8_t * buffer,
+                            size_t bufferLen)
+{
+    lwm2m_data_type_t type;
+    uint16_t id;
+    size_t dataIndex;
+    size_t dataLen;
+    size_t index = 0;
+    int result;
+    int count = 0;
+
+    while (0 != (result = lwm2m_decode_TLV(buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen)))
+    {
+        count++;
+        index += result;
+    }
+
+    return count;
+}
+
+// Full length of the record starting at buffer, 0 as long as its header is not complete
+static size_t prv_getRecordLength(const uint8_t * buffer,
+                                  size_t bufferLen)
+{
+    size_t headerLen;
+    size_t lengthLen;
+    size_t dataLen;
+    size_t i;
+
+    if (bufferLen == 0) return 0;
+
+    lengthLen = (buffer[0] & 0x18) >> 3;
+    headerLen = ((buffer[0] & 0x20) == 0x20 ? 3 : 2) + lengthLen;
+    if (bufferLen < headerLen) return 0;
+
+    if (lengthLen == 0)
+    {
+        dataLen = buffer[0] & 0x07;
+    }
+    else
+    {
+        dataLen = 0;
+        for (i = headerLen - lengthLen ; i < headerLen ; i++)
+        {
+            dataLen = (dataLen << 8) + buffer[i];
+        }
+    }
+
+    return headerLen + dataLen;
+}
+
+size_t tlv_getCompleteLength(const uint8_t * buffer,
+                             size_t bufferLen,
+                             size_t * nextLengthP)
+{
+    size_t length = 0;
+
+    *nextLengthP = 0;
+    while (length < bufferLen)
+    {
+        size_t recordLength;
+
+        recordLength = prv_getRecordLength(buffer + length, bufferLen - length);
+        if (recordLength == 0 || recordLength > bufferLen - length)
+        {
+            *nextLengthP = recordLength;
+            break;
+        }
+        length += recordLength;
+    }
+
+    return length;
+}
+
 int tlv_parse(uint8_t * buffer,
               size_t bufferLen,
               lwm2m_data_t ** dataP)
@@ -311,7 +386,8 @@ int tlv_parse(uint8_t * buffer,
     size_t dataLen;
     int index = 0;
     int result;
-    int size = 0;
+    int size;
+    int i;
 
     LOG_ARG("bufferLen: %d", bufferLen);
 
@@ -323,50 +399,35 @@ int tlv_parse(uint8_t * buffer,
 
     *dataP = NULL;
 
-    while (0 != (result = lwm2m_decode_TLV((uint8_t*)buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen)))
-    {
-        lwm2m_data_t * newTlvP;
+    // the records are counted first so that the array is allocated once
+    size = prv_countRecords(buffer, bufferLen);
+    if (size == 0) return 0;
 
-        newTlvP = lwm2m_data_new(size + 1);
-        if (size >= 1)
-        {
-            if (newTlvP == NULL)
-            {
-                lwm2m_data_free(size, *dataP);
-                return 0;
-            }
-            else
-            {
-                memcpy(newTlvP, *dataP, size * sizeof(lwm2m_data_t));
-                lwm2m_free(*dataP);
-            }
-        }
+    *dataP = lwm2m_data_new(size);
+    if (*dataP == NULL) return 0;
 
-        *dataP = newTlvP;
-        if (dataP == NULL)
-        {
-           LOG("dataP is NULL.");
-           return 0;
-        }
+    for (i = 0 ; i < size ; i++)
+    {
+        result = lwm2m_decode_TLV((uint8_t*)buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen);
 
-        (*dataP)[size].type = type;
-        (*dataP)[size].id = id;
+        (*dataP)[i].type = type;
+        (*dataP)[i].id = id;
         if (type == LWM2M_TYPE_OBJECT_INSTANCE || type == LWM2M_TYPE_MULTIPLE_RESOURCE)
         {
-            (*dataP)[size].value.asChildren.count = tlv_parse(buffer + index + dataIndex,
-                                                          dataLen,
-                                                          &((*dataP)[size].value.asChildren.array));
-            if ((*dataP)[size].value.asChildren.count == 0)
+            (*dataP)[i].value.asChildren.count = tlv_parse(buffer + index + dataIndex,
+                                                       dataLen,
+                                                       &((*dataP)[i].value.asChildren.array));
+            if ((*dataP)[i].value.asChildren.count == 0)
             {
-                lwm2m_data_free(size + 1, *dataP);
+                lwm2m_data_free(i + 1, *dataP);
+                *dataP = NULL;
                 return 0;
             }
         }
         else
         {
-            lwm2m_data_encode_opaque(buffer + index + dataIndex, dataLen, (*dataP) + size);
+            lwm2m_data_encode_opaque(buffer + index + dataIndex, dataLen, (*dataP) + i);
         }
-        size++;
         index += result;
     }
 
@@ -374,8 +435,56 @@ int tlv_parse(uint8_t * buffer,
 }
 
 
+// Content length of a container of the serialization
+typedef struct
+{
+    int    length;
+    size_t next;            // index of the container following this one and the ones it holds
+} tlv_container_t;
+
+// Part of the serialization to produce: the bytes from offset to offset + length
+typedef struct
+{
+    size_t    position;     // serialized bytes before the current one
+    size_t    offset;
+    size_t    length;
+    uint8_t * buffer;       // receives the bytes of the window
+    tlv_container_t * containers;   // every container in the order of the serialization
+    size_t    containerCount;
+    size_t    containerSize;
+    size_t    containerIndex;       // next container to serialize
+} tlv_window_t;
+
+// Record a new container, its length is set once its records are measured
+static bool prv_addContainer(tlv_window_t * windowP,
+                             size_t * indexP)
+{
+    if (windowP->containerCount == windowP->containerSize)
+    {
+        tlv_container_t * containersP;
+        size_t size;
+
+        size = windowP->containerSize == 0 ? 16 : windowP->containerSize * 2;
+        containersP = (tlv_container_t *)lwm2m_malloc(size * sizeof(tlv_container_t));
+        if (containersP == NULL) return false;
+        if (windowP->containerCount > 0)
+        {
+            memcpy(containersP, windowP->containers, windowP->containerCount * sizeof(tlv_container_t));
+        }
+        lwm2m_free(windowP->containers);
+        windowP->containers = containersP;
+        windowP->containerSize = size;
+    }
+    *indexP = windowP->containerCount;
+    windowP->containerCount++;
+
+    return true;
+}
+
+// When windowP is not NULL, the length of every container is recorded in it
 static int prv_getLength(int size,
-                         lwm2m_data_t * dataP)
+                         lwm2m_data_t * dataP,
+                         tlv_window_t * windowP)
 {
     int length;
     int i;
@@ -390,14 +499,25 @@ static int prv_getLength(int size,
         case LWM2M_TYPE_MULTIPLE_RESOURCE:
             {
                 int subLength;
+                size_t index = 0;
 
-                subLength = prv_getLength(dataP[i].value.asChildren.count, dataP[i].value.asChildren.array);
+                if (windowP != NULL && !prv_addContainer(windowP, &index))
+                {
+                    length = -1;
+                    break;
+                }
+                subLength = prv_getLength(dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, windowP);
                 if (subLength == -1)
                 {
                     length = -1;
                 }
                 else
                 {
+                    if (windowP != NULL)
+                    {
+                        windowP->containers[index].length = subLength;
+                        windowP->containers[index].next = windowP->containerCount;
+                    }
                     length += prv_getHeaderLength(dataP[i].id, subLength) + subLength;
                 }
             }
@@ -456,137 +576,272 @@ static int prv_getLength(int size,
 }
 
 
+// Write the records backward so that the length of a container is known when its header is written.
+// The records end at index end of buffer, returns the index where they start or -1 on error.
+static int prv_writeRecords(bool isResourceInstance,
+                            int size,
+                            lwm2m_data_t * dataP,
+                            uint8_t * buffer,
+                            int end)
+{
+    int i;
+
+    for (i = size - 1 ; i >= 0 && end >= 0 ; i--)
+    {
+        uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
+        const uint8_t * valueP = data_buffer;
+        size_t data_len;
+        bool isInstance;
+
+        isInstance = isResourceInstance;
+        switch (dataP[i].type)
+        {
+        case LWM2M_TYPE_MULTIPLE_RESOURCE:
+            isInstance = true;
+            // fall through
+        case LWM2M_TYPE_OBJECT_INSTANCE:
+            {
+                int start;
+
+                start = prv_writeRecords(isInstance, dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, buffer, end);
+                if (start < 0) return -1;
+
+                data_len = (size_t)(end - start);
+                end = start - prv_getHeaderLength(dataP[i].id, data_len);
+                if (end < 0) return -1;
+                prv_createHeader(buffer + end, false, dataP[i].type, dataP[i].id, data_len);
+            }
+            continue;
+
+        case LWM2M_TYPE_OBJECT_LINK:
+            // keep encoding as buffer
+            data_buffer[0] = (uint8_t)(dataP[i].value.asObjLink.objectId >> 8);
+            data_buffer[1] = (uint8_t)dataP[i].value.asObjLink.objectId;
+            data_buffer[2] = (uint8_t)(dataP[i].value.asObjLink.objectInstanceId >> 8);
+            data_buffer[3] = (uint8_t)dataP[i].value.asObjLink.objectInstanceId;
+            data_len = 4;
+            break;
+
+        case LWM2M_TYPE_STRING:
+        case LWM2M_TYPE_OPAQUE:
+            valueP = dataP[i].value.asBuffer.buffer;
+            data_len = dataP[i].value.asBuffer.length;
+            break;
+
+        case LWM2M_TYPE_INTEGER:
+            data_len = prv_encodeInt(dataP[i].value.asInteger, data_buffer);
+            break;
+
+        case LWM2M_TYPE_FLOAT:
+            data_len = prv_encodeFloat(dataP[i].value.asFloat, data_buffer);
+            break;
+
+        case LWM2M_TYPE_BOOLEAN:
+            data_buffer[0] = dataP[i].value.asBoolean ? 1 : 0;
+            data_len = 1;
+            break;
+
+        default:
+            return -1;
+        }
+
+        end -= (int)data_len;
+        if (end < 0) return -1;
+        if (data_len > 0) memcpy(buffer + end, valueP, data_len);
+        end -= prv_getHeaderLength(dataP[i].id, data_len);
+        if (end < 0) return -1;
+        prv_createHeader(buffer + end, isInstance, dataP[i].type, dataP[i].id, data_len);
+    }
+
+    return end;
+}
+
 int tlv_serialize(bool isResourceInstance, 
                   int size,
                   lwm2m_data_t * dataP,
                   uint8_t ** bufferP)
 {
     int length;
-    int index;
-    int i;
 
     LOG_ARG("isResourceInstance: %s, size: %d", isResourceInstance?"true":"false", size);
 
     *bufferP = NULL;
-    length = prv_getLength(size, dataP);
+    length = prv_getLength(size, dataP, NULL);
     if (length <= 0) return length;
 
     *bufferP = (uint8_t *)lwm2m_malloc(length);
     if (*bufferP == NULL) return 0;
 
-    index = 0;
-    for (i = 0 ; i < size && length != 0 ; i++)
+    // every record is written once, at its final place in the buffer
+    if (0 != prv_writeRecords(isResourceInstance, size, dataP, *bufferP, length))
     {
+        lwm2m_free(*bufferP);
+        *bufferP = NULL;
+        length = -1;
+    }
+
+    LOG_ARG("returning %u", length);
+
+    return length;
+}
+
+static void prv_emit(tlv_window_t * windowP,
+                     const uint8_t * data,
+                     size_t length)
+{
+    size_t from;
+    size_t to;
+
+    if (length > 0
+     && windowP->position + length > windowP->offset
+     && windowP->position < windowP->offset + windowP->length)
+    {
+        from = windowP->position < windowP->offset ? windowP->offset - windowP->position : 0;
+        to = windowP->offset + windowP->length - windowP->position;
+        if (to > length) to = length;
+        memcpy(windowP->buffer + windowP->position + from - windowP->offset, data + from, to - from);
+    }
+    windowP->position += length;
+}
+
+// Write the records in order, the ones before the window are skipped without being encoded
+static int prv_emitRecords(tlv_window_t * windowP,
+                           bool isResourceInstance,
+                           int size,
+                           lwm2m_data_t * dataP)
+{
+    int i;
+
+    for (i = 0 ; i < size && windowP->position < windowP->offset + windowP->length ; i++)
+    {
+        uint8_t header[_PRV_TLV_HEADER_MAX_LENGTH];
+        uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
+        const uint8_t * valueP = data_buffer;
+        size_t data_len;
         int headerLen;
-        bool isInstance;
 
-        isInstance = isResourceInstance;
         switch (dataP[i].type)
         {
-        case LWM2M_TYPE_MULTIPLE_RESOURCE:
-            isInstance = true;
-            // fall through
         case LWM2M_TYPE_OBJECT_INSTANCE:
+        case LWM2M_TYPE_MULTIPLE_RESOURCE:
             {
-                uint8_t * tmpBuffer;
-                int res;
+                tlv_container_t * containerP = windowP->containers + windowP->containerIndex;
 
-                res = tlv_serialize(isInstance, dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, &tmpBuffer);
-                if (res < 0)
+                // the containers come in the order they were measured
+                headerLen = prv_createHeader(header, false, dataP[i].type, dataP[i].id, (size_t)containerP->length);
+                if (windowP->position + headerLen + containerP->length <= windowP->offset)
                 {
-                    length = -1;
+                    windowP->position += headerLen + containerP->length;
+                    windowP->containerIndex = containerP->next;
+                    continue;
                 }
-                else
+                windowP->containerIndex++;
+                prv_emit(windowP, header, headerLen);
+                if (0 != prv_emitRecords(windowP,
+                                         dataP[i].type == LWM2M_TYPE_MULTIPLE_RESOURCE ? true : isResourceInstance,
+                                         dataP[i].value.asChildren.count, dataP[i].value.asChildren.array))
                 {
-                    size_t tmpLength;
-
-                    tmpLength = (size_t)res;
-                    headerLen = prv_createHeader(*bufferP + index, false, dataP[i].type, dataP[i].id, tmpLength);
-                    index += headerLen;
-                    if (tmpLength > 0)
-                    {
-                        memcpy(*bufferP + index, tmpBuffer, tmpLength);
-                        index += tmpLength;
-                        lwm2m_free(tmpBuffer);
-                    }
+                    return -1;
                 }
             }
-            break;
+            continue;
 
         case LWM2M_TYPE_OBJECT_LINK:
-            {
-                int k;
-                uint8_t buf[4];
-                uint32_t v = dataP[i].value.asObjLink.objectId;
-                v <<= 16;
-                v |= (((uint32_t) dataP[i].value.asObjLink.objectInstanceId) & 0x0000FFFF);
-                for (k = 3; k >= 0; --k) {
-                    buf[k] = (uint8_t)(v & 0xFF);
-                    v >>= 8;
-                }
-                // keep encoding as buffer
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, 4);
-                index += headerLen;
-                memcpy(*bufferP + index, buf, 4);
-                index += 4;
-            }
+            // keep encoding as buffer
+            data_buffer[0] = (uint8_t)(dataP[i].value.asObjLink.objectId >> 8);
+            data_buffer[1] = (uint8_t)dataP[i].value.asObjLink.objectId;
+            data_buffer[2] = (uint8_t)(dataP[i].value.asObjLink.objectInstanceId >> 8);
+            data_buffer[3] = (uint8_t)dataP[i].value.asObjLink.objectInstanceId;
+            data_len = 4;
             break;
 
         case LWM2M_TYPE_STRING:
         case LWM2M_TYPE_OPAQUE:
-            headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, dataP[i].value.asBuffer.length);
-            index += headerLen;
-            memcpy(*bufferP + index, dataP[i].value.asBuffer.buffer, dataP[i].value.asBuffer.length);
-            index += dataP[i].value.asBuffer.length;
+            valueP = dataP[i].value.asBuffer.buffer;
+            data_len = dataP[i].value.asBuffer.length;
             break;
 
         case LWM2M_TYPE_INTEGER:
-            {
-                size_t data_len;
-                uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
-
-                data_len = prv_encodeInt(dataP[i].value.asInteger, data_buffer);
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, data_len);
-                index += headerLen;
-                memcpy(*bufferP + index, data_buffer, data_len);
-                index += data_len;
-            }
+            data_len = prv_encodeInt(dataP[i].value.asInteger, data_buffer);
             break;
 
         case LWM2M_TYPE_FLOAT:
-            {
-                size_t data_len;
-                uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
-
-                data_len = prv_encodeFloat(dataP[i].value.asFloat, data_buffer);
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, data_len);
-                index += headerLen;
-                memcpy(*bufferP + index, data_buffer, data_len);
-                index += data_len;
-            }
+            data_len = prv_encodeFloat(dataP[i].value.asFloat, data_buffer);
             break;
 
         case LWM2M_TYPE_BOOLEAN:
-            headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, 1);
-            index += headerLen;
-            (*bufferP)[index] = dataP[i].value.asBoolean ? 1 : 0;
-            index += 1;
+            data_buffer[0] = dataP[i].value.asBoolean ? 1 : 0;
+            data_len = 1;
             break;
 
         default:
-            length = -1;
-            break;
+            return -1;
         }
+
+        headerLen = prv_createHeader(header, isResourceInstance, dataP[i].type, dataP[i].id, data_len);
+        prv_emit(windowP, header, headerLen);
+        prv_emit(windowP, valueP, data_len);
     }
 
-    if (length < 0)
+    return 0;
+}
+
+int tlv_serializeBlock(bool isResourceInstance,
+                       int size,
+                       lwm2m_data_t * dataP,
+                       size_t offset,
+                       size_t length,
+                       uint8_t ** bufferP,
+                       size_t * totalP)
+{
+    tlv_window_t window;
+    int total;
+
+    LOG_ARG("isResourceInstance: %s, size: %d, offset: %u, length: %u", isResourceInstance?"true":"false", size, offset, length);
+
+    *bufferP = NULL;
+    memset(&window, 0, sizeof(window));
+    // the containers are measured once, their records are not measured again when serialized
+    total = prv_getLength(size, dataP, &window);
+    if (total < 0)
     {
-        lwm2m_free(*bufferP);
-        *bufferP = NULL;
+        lwm2m_free(window.containers);
+        return -1;
+    }
+    *totalP = (size_t)total;
+    if (offset >= (size_t)total)
+    {
+        lwm2m_free(window.containers);
+        return 0;
     }
 
-    LOG_ARG("returning %u", length);
+    window.offset = offset;
+    window.length = (size_t)total - offset < length ? (size_t)total - offset : length;
+    window.buffer = (uint8_t *)lwm2m_malloc(window.length);
+    if (window.buffer == NULL)
+    {
+        lwm2m_free(window.containers);
+        return -1;
+    }
 
-    return length;
-}
+    if (window.length == (size_t)total)
+    {
+        // the window holds the whole serialization
+        if (0 != prv_writeRecords(isResourceInstance, size, dataP, window.buffer, total))
+        {
+            lwm2m_free(window.buffer);
+            window.buffer = NULL;
+        }
+    }
+    // only the records up to the end of the window are encoded
+    else if (0 != prv_emitRecords(&window, isResourceInstance, size, dataP))
+    {
+        lwm2m_free(window.buffer);
+        window.buffer = NULL;
+    }
+    lwm2m_free(window.containers);
+    if (window.buffer == NULL) return -1;
+    *bufferP = window.buffer;
 
+    return (int)window.length;
+}
@@ -108,11 +108,17 @@ Contains code snippets which are:
 
 
 /*
- * Modulo mask (+1 and +0.5 for rounding) for a random number to get the tick number for the random
- * retransmission time between COAP_RESPONSE_TIMEOUT and COAP_RESPONSE_TIMEOUT*COAP_RESPONSE_RANDOM_FACTOR.
+ * The initial retransmission timeout is a random duration between COAP_RESPONSE_TIMEOUT and
+ * COAP_RESPONSE_TIMEOUT*COAP_ACK_RANDOM_FACTOR (RFC 7252 section 4.8), so that peers which
+ * started together do not retransmit in lockstep.
  */
-#define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
-#define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  ((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * (COAP_RESPONSE_RANDOM_FACTOR - 1)) + 1.5)
+#define COAP_RESPONSE_TIMEOUT_MS            (COAP_RESPONSE_TIMEOUT * MS_PER_SECOND)
+#define COAP_RESPONSE_TIMEOUT_RANDOM_MS     ((uint32_t)(COAP_RESPONSE_TIMEOUT_MS * (COAP_ACK_RANDOM_FACTOR - 1)))
+
+static uint32_t prv_randomAckTimeout(void)
+{
+    return COAP_RESPONSE_TIMEOUT_MS + utils_random() % (COAP_RESPONSE_TIMEOUT_RANDOM_MS + 1);
+}
 
 static int prv_checkFinished(lwm2m_transaction_t * transacP,
                              coap_packet_t * receivedMessage)
@@ -178,6 +184,199 @@ static void prv_generate_token (lwm2m_transaction_t * transacP,
 
 }
 
+/*
+ * Transaction index
+ *
+ * Responses are matched against in-flight transactions through two hash indexes
+ * (see hashindex.c): one keyed by message ID (for ACK and RST) and one keyed by token (for
+ * separate and NON responses). The peer is not part of the hash as session handles
+ * are opaque and only comparable through lwm2m_session_is_equal(). Since message IDs
+ * are allocated from the context's nextMID counter, lookups are expected to compare
+ * one candidate only.
+ */
+
+static uint32_t prv_hashMid(uint16_t mID)
+{
+    uint32_t hash;
+
+    hash = (uint32_t)mID * 2654435761u;
+    return hash ^ (hash >> 16);
+}
+
+static uint32_t prv_hashToken(const uint8_t * token,
+                              size_t tokenLen)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0 ; i < tokenLen ; i++)
+    {
+        hash = (hash ^ token[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t prv_midKey(void * entryP)
+{
+    return prv_hashMid(((lwm2m_transaction_t *)entryP)->mID);
+}
+
+static uint32_t prv_tokenKey(void * entryP)
+{
+    coap_packet_t * message = (coap_packet_t *)((lwm2m_transaction_t *)entryP)->message;
+
+    return prv_hashToken(message->token, message->token_len);
+}
+
+static lwm2m_transaction_t * prv_findByMid(lwm2m_context_t * contextP,
+                                           void * fromSessionH,
+                                           uint16_t mID)
+{
+    lwm2m_hash_index_t * indexP = &contextP->transactionByMid;
+    size_t mask = indexP->size - 1;
+    size_t i;
+
+    if (0 == indexP->size) return NULL;
+
+    for (i = prv_hashMid(mID) & mask ; NULL != indexP->slots[i] ; i = (i + 1) & mask)
+    {
+        lwm2m_transaction_t * transacP = (lwm2m_transaction_t *)indexP->slots[i];
+
+        if (transacP->mID == mID
+         && !transacP->ack_received
+         && lwm2m_session_is_equal(fromSessionH, transacP->peerH, contextP->userData) == true)
+        {
+            return transacP;
+        }
+    }
+
+    return NULL;
+}
+
+static lwm2m_transaction_t * prv_findByToken(lwm2m_context_t * contextP,
+                                             void * fromSessionH,
+                                             coap_packet_t * message)
+{
+    lwm2m_hash_index_t * indexP = &contextP->transactionByToken;
+    size_t mask = indexP->size - 1;
+    size_t i;
+
+    if (0 == indexP->size || 0 == message->token_len) return NULL;
+
+    for (i = prv_hashToken(message->token, message->token_len) & mask ; NULL != indexP->slots[i] ; i = (i + 1) & mask)
+    {
+        lwm2m_transaction_t * transacP = (lwm2m_transaction_t *)indexP->slots[i];
+        coap_packet_t * transactionMessage = (coap_packet_t *)transacP->message;
+
+        if (transactionMessage->token_len == message->token_len
+         && memcmp(transactionMessage->token, message->token, message->token_len) == 0
+         && lwm2m_session_is_equal(fromSessionH, transacP->peerH, contextP->userData) == true
+         && prv_checkFinished(transacP, message))
+        {
+            return transacP;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * The transaction list is kept in sending order. The prev pointer of its head
+ * refers to its tail so that appending is O(1).
+ */
+static bool prv_isLinked(lwm2m_transaction_t * transacP)
+{
+    return (NULL != transacP->prev);
+}
+
+static bool prv_link(lwm2m_context_t * contextP,
+                     lwm2m_transaction_t * transacP)
+{
+    coap_packet_t * message = (coap_packet_t *)transacP->message;
+
+    if (!hashindex_insert(&contextP->transactionByMid, transacP, prv_midKey)) return false;
+    if (0 != message->token_len)
+    {
+        if (!hashindex_insert(&contextP->transactionByToken, transacP, prv_tokenKey))
+        {
+            hashindex_remove(&contextP->transactionByMid, transacP, prv_midKey);
+            return false;
+        }
+    }
+    if (!deadline_schedule(&contextP->transactionDeadlines, &transacP->retrans_deadline, transacP->retrans_time))
+    {
+        hashindex_remove(&contextP->transactionByMid, transacP, prv_midKey);
+        if (0 != message->token_len)
+        {
+            hashindex_remove(&contextP->transactionByToken, transacP, prv_tokenKey);
+        }
+        return false;
+    }
+
+    transacP->next = NULL;
+    if (NULL == contextP->transactionList)
+    {
+        transacP->prev = transacP;
+        contextP->transactionList = transacP;
+    }
+    else
+    {
+        transacP->prev = contextP->transactionList->prev;
+        transacP->prev->next = transacP;
+        contextP->transactionList->prev = transacP;
+    }
+
+    return true;
+}
+
+static void prv_unlink(lwm2m_context_t * contextP,
+                       lwm2m_transaction_t * transacP)
+{
+    coap_packet_t * message = (coap_packet_t *)transacP->message;
+
+    if (!prv_isLinked(transacP)) return;
+
+    hashindex_remove(&contextP->transactionByMid, transacP, prv_midKey);
+    if (NULL != message && 0 != message->token_len)
+    {
+        hashindex_remove(&contextP->transactionByToken, transacP, prv_tokenKey);
+    }
+    deadline_cancel(&contextP->transactionDeadlines, &transacP->retrans_deadline);
+
+    if (contextP->transactionList == transacP)
+    {
+        contextP->transactionList = transacP->next;
+        if (NULL != transacP->next) transacP->next->prev = transacP->prev;
+    }
+    else
+    {
+        transacP->prev->next = transacP->next;
+        if (NULL != transacP->next)
+        {
+            transacP->next->prev = transacP->prev;
+        }
+        else
+        {
+            contextP->transactionList->prev = transacP->prev;
+        }
+    }
+    transacP->next = NULL;
+    transacP->prev = NULL;
+}
+
+/*
+ * Propagates a change of retrans_time to the deadline heap. The node of a
+ * linked transaction is already in the heap so this never allocates.
+ */
+static void prv_reschedule(lwm2m_context_t * contextP,
+                           lwm2m_transaction_t * transacP)
+{
+    if (!prv_isLinked(transacP)) return;
+
+    (void)deadline_schedule(&contextP->transactionDeadlines, &transacP->retrans_deadline, transacP->retrans_time);
+}
+
 lwm2m_transaction_t * transaction_new(void * sessionH,
                                       coap_method_t method,
                                       char * altPath,
@@ -300,10 +499,17 @@ void transaction_remove(lwm2m_context_t * contextP,
                         lwm2m_transaction_t * transacP)
 {
     LOG("Entering");
-    contextP->transactionList = (lwm2m_transaction_t *) LWM2M_LIST_RM(contextP->transactionList, transacP->mID, NULL);
+    prv_unlink(contextP, transacP);
     transaction_free(transacP);
 }
 
+void transaction_freeIndex(lwm2m_context_t * contextP)
+{
+    hashindex_free(&contextP->transactionByMid);
+    hashindex_free(&contextP->transactionByToken);
+    deadline_free(&contextP->transactionDeadlines);
+}
+
 bool transaction_handleResponse(lwm2m_context_t * contextP,
                                  void * fromSessionH,
                                  coap_packet_t * message,
@@ -311,120 +517,116 @@ bool transaction_handleResponse(lwm2m_context_t * contextP,
 {
     bool found = false;
     bool reset = false;
-    lwm2m_transaction_t * transacP;
+    lwm2m_transaction_t * transacP = NULL;
 
     LOG("Entering");
-    transacP = contextP->transactionList;
+    if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
+    {
+        transacP = prv_findByMid(contextP, fromSessionH, message->mid);
+        if (NULL != transacP)
+        {
+            found = true;
+            transacP->ack_received = true;
+            reset = COAP_TYPE_RST == message->type;
+        }
+    }
+    if (NULL == transacP)
+    {
+        transacP = prv_findByToken(contextP, fromSessionH, message);
+    }
+
+    if (NULL == transacP) return false;
 
-    while (NULL != transacP)
+    if (reset || prv_checkFinished(transacP, message))
     {
-        if (lwm2m_session_is_equal(fromSessionH, transacP->peerH, contextP->userData) == true)
+#ifdef LWM2M_DEREGISTER
+        lwm2m_server_t *serverList;
+        lwm2m_server_t *bootstrapServerList;
+        bool isAllDeregistered = true;
+#endif
+
+        // HACK: If a message is sent from the monitor callback,
+        // it will arrive before the registration ACK.
+        // So we resend transaction that were denied for authentication reason.
+        if (!reset)
         {
-            if (!transacP->ack_received)
+            if (COAP_TYPE_CON == message->type && NULL != response)
             {
-                if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
-                {
-                    if (transacP->mID == message->mid)
-                    {
-                        found = true;
-                        transacP->ack_received = true;
-                        reset = COAP_TYPE_RST == message->type;
-                    }
-                }
+                coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
+                message_send(contextP, response, fromSessionH);
             }
 
-            if (reset || prv_checkFinished(transacP, message))
+            if ((COAP_401_UNAUTHORIZED == message->code) && (COAP_MAX_RETRANSMIT > transacP->retrans_counter))
             {
-#ifdef LWM2M_DEREGISTER
-                lwm2m_server_t *serverList;
-                lwm2m_server_t *bootstrapServerList;
-                bool isAllDeregistered = true;
-#endif
-
-                // HACK: If a message is sent from the monitor callback,
-                // it will arrive before the registration ACK.
-                // So we resend transaction that were denied for authentication reason.
-                if (!reset)
-                {
-                    if (COAP_TYPE_CON == message->type && NULL != response)
-                    {
-                        coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
-                        message_send(contextP, response, fromSessionH);
-                    }
-
-                    if ((COAP_401_UNAUTHORIZED == message->code) && (COAP_MAX_RETRANSMIT > transacP->retrans_counter))
-                    {
-                        transacP->ack_received = false;
-                        transacP->retrans_time += COAP_RESPONSE_TIMEOUT;
-                        return true;
-                    }
-                }
-                if (transacP->callback != NULL)
-                {
-                    transacP->callback(transacP, message);
-                }
-                transaction_remove(contextP, transacP);
+                transacP->ack_received = false;
+                transacP->retrans_time += COAP_RESPONSE_TIMEOUT_MS;
+                prv_reschedule(contextP, transacP);
+                return true;
+            }
+        }
+        if (transacP->callback != NULL)
+        {
+            transacP->callback(transacP, message);
+        }
+        transaction_remove(contextP, transacP);
 
 #ifdef LWM2M_DEREGISTER
-                serverList = contextP->serverList;
-                bootstrapServerList = contextP->bootstrapServerList;
-                LOG("Check if servers are deregistered");
-                if (!serverList)
-                {
-                    isAllDeregistered = false;
-                }
+        serverList = contextP->serverList;
+        bootstrapServerList = contextP->bootstrapServerList;
+        LOG("Check if servers are deregistered");
+        if (!serverList)
+        {
+            isAllDeregistered = false;
+        }
 
-                while(serverList)
-                {
-                    if (serverList->status != STATE_DEREGISTERED)
-                    {
-                        isAllDeregistered = false;
-                    }
-                    else
-                    {
-                        // Check if the client is connected to the BS
-                        if ((bootstrapServerList)
-                         && (STATE_BS_PENDING == bootstrapServerList->status))
-                        {
-                            LOG("Bootstrap pending");
-                            isAllDeregistered = false;
-                        }
-                    }
-                    serverList = serverList->next;
-                }
-                if (isAllDeregistered)
+        while(serverList)
+        {
+            if (serverList->status != STATE_DEREGISTERED)
+            {
+                isAllDeregistered = false;
+            }
+            else
+            {
+                // Check if the client is connected to the BS
+                if ((bootstrapServerList)
+                 && (STATE_BS_PENDING == bootstrapServerList->status))
                 {
-                    LOG("All servers are deregistered");
-                    lwm2m_followClosure(contextP);
+                    LOG("Bootstrap pending");
+                    isAllDeregistered = false;
                 }
+            }
+            serverList = serverList->next;
+        }
+        if (isAllDeregistered)
+        {
+            LOG("All servers are deregistered");
+            lwm2m_followClosure(contextP);
+        }
 #endif
 
 
-                return true;
-            }
-            // if we found our guy, exit
-            if (found)
-            {
-                time_t tv_sec = lwm2m_gettime();
-
-                if (0 <= (int32_t)tv_sec)
-                {
-                    transacP->retrans_time = tv_sec;
-                }
+        return true;
+    }
+    // if we found our guy, exit
+    if (found)
+    {
+        int64_t currentTime = utils_gettimeMs();
 
-                if (transacP->response_timeout)
-                {
-                    transacP->retrans_time += transacP->response_timeout;
-                }
-                else
-                {
-                    transacP->retrans_time += COAP_RESPONSE_TIMEOUT * transacP->retrans_counter;
-                }
-                return true;
-            }
+        if (0 <= currentTime)
+        {
+            transacP->retrans_time = currentTime;
         }
 
-        transacP = transacP->next;
+        if (transacP->response_timeout)
+        {
+            transacP->retrans_time += (int64_t)transacP->response_timeout * MS_PER_SECOND;
+        }
+        else
+        {
+            transacP->retrans_time += (int64_t)COAP_RESPONSE_TIMEOUT_MS * transacP->retrans_counter;
+        }
+        prv_reschedule(contextP, transacP);
+        return true;
     }
     return false;
 }
@@ -437,13 +639,19 @@ int transaction_send(lwm2m_context_t * contextP,
     LOG("Entering");
     if (transacP->buffer == NULL)
     {
-        transacP->buffer_len = coap_serialize_get_size(transacP->message);
-        if (transacP->buffer_len == 0)
+        coap_packet_t * message = (coap_packet_t *)transacP->message;
+        size_t headerLen;
+
+        // Serialize the header once in the context buffer. The datagram is then kept
+        // for the retransmissions as the caller may release the payload.
+        headerLen = coap_serialize_header(message, contextP->sendBuffer, sizeof(contextP->sendBuffer));
+        if (headerLen == 0 || headerLen + message->payload_len > UINT16_MAX)
         {
            transaction_remove(contextP, transacP);
            return COAP_500_INTERNAL_SERVER_ERROR;
         }
 
+        transacP->buffer_len = (uint16_t)(headerLen + message->payload_len);
         transacP->buffer = (uint8_t*)lwm2m_malloc(transacP->buffer_len);
         if (transacP->buffer == NULL)
         {
@@ -451,27 +659,33 @@ int transaction_send(lwm2m_context_t * contextP,
            return COAP_500_INTERNAL_SERVER_ERROR;
         }
 
-        transacP->buffer_len = coap_serialize_message(transacP->message, transacP->buffer);
-        if (transacP->buffer_len == 0)
+        memcpy(transacP->buffer, contextP->sendBuffer, headerLen);
+        if (message->payload_len != 0)
+        {
+            memcpy(transacP->buffer + headerLen, message->payload, message->payload_len);
+        }
+
+        // first transmission: make the transaction visible to transaction_handleResponse()
+        if (!prv_isLinked(transacP)
+         && !prv_link(contextP, transacP))
         {
-            lwm2m_free(transacP->buffer);
-            transacP->buffer = NULL;
-            transaction_remove(contextP, transacP);
+            transaction_free(transacP);
             return COAP_500_INTERNAL_SERVER_ERROR;
         }
     }
 
     if (!transacP->ack_received)
     {
-        long unsigned timeout = 0;
+        int64_t timeout = 0;
 
         if (0 == transacP->retrans_counter)
         {
-            time_t tv_sec = lwm2m_gettime();
+            int64_t currentTime = utils_gettimeMs();
 
-            if (0 <= (int32_t)tv_sec)
+            if (0 <= currentTime)
             {
-                transacP->retrans_time = tv_sec + COAP_RESPONSE_TIMEOUT;
+                transacP->ack_timeout = prv_randomAckTimeout();
+                transacP->retrans_time = currentTime + transacP->ack_timeout;
                 transacP->retrans_counter = 1;
                 timeout = 0;
             }
@@ -482,7 +696,7 @@ int transaction_send(lwm2m_context_t * contextP,
         }
         else
         {
-            timeout = COAP_RESPONSE_TIMEOUT << (transacP->retrans_counter - 1);
+            timeout = (int64_t)transacP->ack_timeout << (transacP->retrans_counter - 1);
         }
 
         if (COAP_MAX_RETRANSMIT + 1 >= transacP->retrans_counter)
@@ -521,51 +735,40 @@ int transaction_send(lwm2m_context_t * contextP,
         return -1;
     }
 
+    prv_reschedule(contextP, transacP);
     return 0;
 }
 
 void transaction_step(lwm2m_context_t * contextP,
-                      time_t currentTime,
-                      time_t * timeoutP)
+                      int64_t currentTime,
+                      int64_t * timeoutP)
 {
-    lwm2m_transaction_t * transacP;
+    lwm2m_deadline_t * nodeP;
+    int64_t interval;
 
     LOG("Entering");
-    transacP = contextP->transactionList;
-    while (transacP != NULL)
+    // only the due transactions are visited, each one at most once per step
+    nodeP = deadline_expire(&contextP->transactionDeadlines, currentTime);
+    while (nodeP != NULL)
     {
-        // transaction_send() may remove transaction from the linked list
-        lwm2m_transaction_t * nextP = transacP->next;
-        int removed = 0;
+        // transaction_send() may free the transaction
+        lwm2m_deadline_t * nextP = nodeP->next;
 
-        if (transacP->retrans_time <= currentTime)
+        if (0 != transaction_send(contextP, LWM2M_CONTAINER_OF(nodeP, lwm2m_transaction_t, retrans_deadline)))
         {
-            removed = transaction_send(contextP, transacP);
+            *timeoutP = MS_PER_SECOND;
         }
 
-        if (0 == removed)
-        {
-            time_t interval;
-
-            if (transacP->retrans_time > currentTime)
-            {
-                interval = transacP->retrans_time - currentTime;
-            }
-            else
-            {
-                interval = 1;
-            }
-
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
-        }
-        else
-        {
-            *timeoutP = 1;
-        }
+        nodeP = nextP;
+    }
 
-        transacP = nextP;
+    interval = deadline_interval(&contextP->transactionDeadlines, currentTime, *timeoutP);
+    if (interval <= 0)
+    {
+        interval = MS_PER_SECOND;
+    }
+    if (*timeoutP > interval)
+    {
+        *timeoutP = interval;
     }
 }
@@ -84,6 +84,27 @@ static int prv_parseNumber(uint8_t * uriString,
 }
 
 
+// Client ID of a registration location path, up to 32 bits
+static bool prv_parseRegistrationId(uint8_t * uriString,
+                                    size_t uriLength,
+                                    uint32_t * idP)
+{
+    uint64_t result = 0;
+    size_t i;
+
+    if (uriLength == 0 || uriLength > 10) return false;
+
+    for (i = 0 ; i < uriLength ; i++)
+    {
+        if (uriString[i] < '0' || uriString[i] > '9') return false;
+        result = result * 10 + (uriString[i] - '0');
+    }
+    if (result > UINT32_MAX) return false;
+
+    *idP = (uint32_t)result;
+    return true;
+}
+
 int uri_getNumber(uint8_t * uriString,
                    size_t uriLength)
 {
@@ -160,6 +181,14 @@ lwm2m_uri_t * uri_decode(char * altPath,
         }
     }
 
+    if ((uriP->flag & LWM2M_URI_MASK_TYPE) == LWM2M_URI_FLAG_REGISTRATION)
+    {
+        if (!prv_parseRegistrationId(uriPath->data, uriPath->len, &uriP->registrationId)) goto error;
+        uriP->flag |= LWM2M_URI_FLAG_REGISTRATION_ID;
+        if (uriPath->next != NULL) goto error;
+        return uriP;
+    }
+
     if (NULL != uriPath)
     {
         readNum = uri_getNumber(uriPath->data, uriPath->len);
@@ -173,11 +202,6 @@ lwm2m_uri_t * uri_decode(char * altPath,
         LOG("uriPath is NULL");
     }
 
-    if ((uriP->flag & LWM2M_URI_MASK_TYPE) == LWM2M_URI_FLAG_REGISTRATION)
-    {
-        if (uriPath != NULL) goto error;
-        return uriP;
-    }
     uriP->flag |= LWM2M_URI_FLAG_DM;
 
     if (uriPath == NULL) return uriP;
@@ -51,6 +51,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <float.h>
+#ifdef LEGATO_EMBEDDED
+#include "legato.h"
+#endif
 
 
 int utils_textToInt(uint8_t * buffer,
@@ -552,3 +555,28 @@ lwm2m_data_type_t utils_depthToDatatype(uri_depth_t depth)
 
     return LWM2M_TYPE_UNDEFINED;
 }
+
+int64_t utils_gettimeMs(void)
+{
+#ifdef LWM2M_WITH_MS_CLOCK
+    return lwm2m_gettime_ms();
+#else
+    time_t tv_sec = lwm2m_gettime();
+
+    if (tv_sec < 0) return -1;
+
+    return (int64_t)tv_sec * MS_PER_SECOND;
+#endif
+}
+
+uint32_t utils_random(void)
+{
+#ifdef LEGATO_EMBEDDED
+    uint32_t value;
+
+    le_rand_GetBuffer((uint8_t *)&value, sizeof(value));
+    return value;
+#else
+    return (uint32_t)rand();
+#endif
+}
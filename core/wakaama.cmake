@@ -16,6 +16,8 @@ set(WAKAAMA_SOURCES
     ${WAKAAMA_SOURCES_DIR}/liblwm2m.c
     ${WAKAAMA_SOURCES_DIR}/uri.c
     ${WAKAAMA_SOURCES_DIR}/utils.c
+    ${WAKAAMA_SOURCES_DIR}/deadline.c
+    ${WAKAAMA_SOURCES_DIR}/hashindex.c
     ${WAKAAMA_SOURCES_DIR}/objects.c
     ${WAKAAMA_SOURCES_DIR}/tlv.c
     ${WAKAAMA_SOURCES_DIR}/data.c
@@ -24,7 +24,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <ctype.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -56,7 +56,7 @@ typedef struct _endpoint_
 typedef struct
 {
     int               sock;
-    connection_t *    connList;
+    addr_table_t      connTable;
     lwm2m_context_t * lwm2mH;
     bs_info_t *       bsInfo;
     endpoint_t *      endpointList;
@@ -166,6 +166,20 @@ static endpoint_t * prv_endpoint_new(internal_data_t * dataP,
     return endP;
 }
 
+// Release the connections idle for too long, except those of the clients being bootstrapped
+static void prv_evict_connections(internal_data_t * dataP)
+{
+    endpoint_t * endP;
+
+    if (addr_table_get_idle(&dataP->connTable, CONNECTION_IDLE_TIMEOUT, lwm2m_gettime()) == NULL) return;
+
+    for (endP = dataP->endpointList ; endP != NULL ; endP = endP->next)
+    {
+        connection_touch(&dataP->connTable, (connection_t *)endP->handle);
+    }
+    (void)connection_evict(&dataP->connTable, CONNECTION_IDLE_TIMEOUT);
+}
+
 static void prv_endpoint_clean(internal_data_t * dataP)
 {
     endpoint_t * endP;
@@ -450,12 +464,24 @@ static void prv_bootstrap_client(char * buffer,
     port++;
 
     fprintf(stderr, "Trying to connect to LWM2M CLient at %s:%s\r\n", host, port);
-    newConnP = connection_create(dataP->connList, dataP->sock, host, port, dataP->addressFamily);
+    newConnP = connection_create(NULL, dataP->sock, host, port, dataP->addressFamily);
+    if (newConnP != NULL)
+    {
+        connection_t * connP;
+
+        // reuse the connection of a client already known
+        connP = connection_lookup(&dataP->connTable, (struct sockaddr_storage *)&newConnP->addr, newConnP->addrLen);
+        if (connP == NULL)
+        {
+            connP = connection_add_incoming(&dataP->connTable, dataP->sock, (struct sockaddr *)&newConnP->addr, newConnP->addrLen);
+        }
+        connection_free(newConnP);
+        newConnP = connP;
+    }
     if (newConnP == NULL) {
         fprintf(stderr, "Connection creation failed.\r\n");
         return;
     }
-    dataP->connList = newConnP;
 
     // simulate a client bootstrap request.
     if (COAP_204_CHANGED == prv_bootstrap_callback(newConnP, COAP_NO_ERROR, NULL, name, user_data))
@@ -475,8 +501,10 @@ syntax_error:
 
 int main(int argc, char *argv[])
 {
-    fd_set readfds;
-    struct timeval tv;
+    static connection_ring_t ring;
+    static connection_batch_t batch;
+    int epfd;
+    struct epoll_event event;
     int result;
     char * port = "5685";
     internal_data_t data;
@@ -545,6 +573,12 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    if (!addr_table_init(&data.connTable))
+    {
+        fprintf(stderr, "addr_table_init() failed\r\n");
+        return -1;
+    }
+
     data.lwm2mH = lwm2m_init(NULL);
     if (NULL == data.lwm2mH)
     {
@@ -571,96 +605,115 @@ int main(int argc, char *argv[])
 
     lwm2m_set_bootstrap_callback(data.lwm2mH, prv_bootstrap_callback, (void *)&data);
 
+    epfd = epoll_create1(0);
+    if (epfd < 0)
+    {
+        fprintf(stderr, "Error in epoll_create1(): %d\r\n", errno);
+        return -1;
+    }
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = data.sock;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, data.sock, &event);
+    event.data.fd = STDIN_FILENO;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, STDIN_FILENO, &event);
+
     fprintf(stdout, "LWM2M Bootstrap Server now listening on port %s.\r\n\n", port);
     fprintf(stdout, "> "); fflush(stdout);
 
+    connection_start_batch(&batch);
     while (0 == g_quit)
     {
+        struct epoll_event events[2];
+        int nbEvents;
+        time_t timeout;
         endpoint_t * endP;
+        int i;
 
-        FD_ZERO(&readfds);
-        FD_SET(data.sock, &readfds);
-        FD_SET(STDIN_FILENO, &readfds);
-
-        tv.tv_sec = 60;
-        tv.tv_usec = 0;
+        timeout = 60;
 
-        result = lwm2m_step(data.lwm2mH, &(tv.tv_sec));
+        result = lwm2m_step(data.lwm2mH, &timeout);
         if (result != 0)
         {
             fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
             return -1;
         }
 
-        result = select(FD_SETSIZE, &readfds, 0, 0, &tv);
+        // everything sent since the last wait goes out in one sendmmsg()
+        connection_flush_batch(&batch);
+        nbEvents = epoll_wait(epfd, events, 2, timeout * 1000);
+        connection_start_batch(&batch);
 
-        if ( result < 0 )
+        if (nbEvents < 0)
         {
             if (errno != EINTR)
             {
-              fprintf(stderr, "Error in select(): %d\r\n", errno);
+              fprintf(stderr, "Error in epoll_wait(): %d\r\n", errno);
             }
+            continue;
         }
-        else if (result >= 0)
-        {
-            uint8_t buffer[MAX_PACKET_SIZE];
-            int numBytes;
 
+        for (i = 0 ; i < nbEvents ; i++)
+        {
             // Packet received
-            if (FD_ISSET(data.sock, &readfds))
+            if (events[i].data.fd == data.sock)
             {
-                struct sockaddr_storage addr;
-                socklen_t addrLen;
-
-                addrLen = sizeof(addr);
-                numBytes = recvfrom(data.sock, buffer, MAX_PACKET_SIZE, 0, (struct sockaddr *)&addr, &addrLen);
+                int j;
 
-                if (numBytes == -1)
+                // drain the socket, one recvmmsg() call per CONNECTION_BATCH_SIZE datagrams
+                do
                 {
-                    fprintf(stderr, "Error in recvfrom(): %d\r\n", errno);
-                }
-                else
-                {
-                    char s[INET6_ADDRSTRLEN];
-                    in_port_t port;
-                    connection_t * connP;
-
-					s[0] = 0;
-                    if (AF_INET == addr.ss_family)
+                    result = connection_receive(data.sock, &ring);
+                    if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
                     {
-                        struct sockaddr_in *saddr = (struct sockaddr_in *)&addr;
-                        inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin_port;
+                        fprintf(stderr, "Error in recvmmsg(): %d\r\n", errno);
                     }
-                    else if (AF_INET6 == addr.ss_family)
+
+                    for (j = 0 ; j < result ; j++)
                     {
-                        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)&addr;
-                        inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin6_port;
-                    }
+                        struct sockaddr_storage * addrP = ring.addrs + j;
+                        socklen_t addrLen = ring.headers[j].msg_hdr.msg_namelen;
+                        int numBytes = ring.headers[j].msg_len;
+                        char s[INET6_ADDRSTRLEN];
+                        in_port_t port;
+                        connection_t * connP;
+
+                        s[0] = 0;
+                        if (AF_INET == addrP->ss_family)
+                        {
+                            struct sockaddr_in *saddr = (struct sockaddr_in *)addrP;
+                            inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
+                            port = saddr->sin_port;
+                        }
+                        else if (AF_INET6 == addrP->ss_family)
+                        {
+                            struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)addrP;
+                            inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
+                            port = saddr->sin6_port;
+                        }
 
-                    fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
+                        fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
 
-                    output_buffer(stderr, buffer, numBytes, 0);
+                        output_buffer(stderr, ring.buffers[j], numBytes, 0);
 
-                    connP = connection_find(data.connList, &addr, addrLen);
-                    if (connP == NULL)
-                    {
-                        connP = connection_new_incoming(data.connList, data.sock, (struct sockaddr *)&addr, addrLen);
+                        connP = connection_lookup(&data.connTable, addrP, addrLen);
+                        if (connP == NULL)
+                        {
+                            connP = connection_add_incoming(&data.connTable, data.sock, (struct sockaddr *)addrP, addrLen);
+                        }
                         if (connP != NULL)
                         {
-                            data.connList = connP;
+                            lwm2m_handle_packet(data.lwm2mH, ring.buffers[j], numBytes, connP);
                         }
                     }
-                    if (connP != NULL)
-                    {
-                        lwm2m_handle_packet(data.lwm2mH, buffer, numBytes, connP);
-                    }
-                }
+                } while (result == CONNECTION_BATCH_SIZE);
             }
             // command line input
-            else if (FD_ISSET(STDIN_FILENO, &readfds))
+            else if (events[i].data.fd == STDIN_FILENO)
             {
+                uint8_t buffer[MAX_PACKET_SIZE];
+                int numBytes;
+
                 numBytes = read(STDIN_FILENO, buffer, MAX_PACKET_SIZE - 1);
 
                 if (numBytes > 1)
@@ -678,29 +731,32 @@ int main(int argc, char *argv[])
                     fprintf(stdout, "\r\n");
                 }
             }
-            // Do operations on endpoints
-            prv_endpoint_clean(&data);
+        }
 
-            endP = data.endpointList;
-            while (endP != NULL)
-            {
-                switch(endP->status)
-                {
-                case CMD_STATUS_OK:
-                    endP->cmdList = endP->cmdList->next;
-                    endP->status = CMD_STATUS_NEW;
-                    // fall through
-                case CMD_STATUS_NEW:
-                    prv_send_command(&data, endP);
-                    break;
-                default:
-                    break;
-                }
+        // Do operations on endpoints
+        prv_endpoint_clean(&data);
+        prv_evict_connections(&data);
 
-                endP = endP->next;
+        endP = data.endpointList;
+        while (endP != NULL)
+        {
+            switch(endP->status)
+            {
+            case CMD_STATUS_OK:
+                endP->cmdList = endP->cmdList->next;
+                endP->status = CMD_STATUS_NEW;
+                // fall through
+            case CMD_STATUS_NEW:
+                prv_send_command(&data, endP);
+                break;
+            default:
+                break;
             }
+
+            endP = endP->next;
         }
     }
+    connection_flush_batch(&batch);
 
     lwm2m_close(data.lwm2mH);
     bs_free_info(data.bsInfo);
@@ -713,8 +769,9 @@ int main(int argc, char *argv[])
 
         prv_endpoint_free(endP);
     }
+    close(epfd);
     close(data.sock);
-    connection_free(data.connList);
+    connection_free_table(&data.connTable);
 
     return 0;
 }
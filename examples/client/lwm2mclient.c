@@ -284,7 +284,6 @@ void lwm2m_close_connection(void * sessionH,
     if (targetP == app_data->connList)
     {
         app_data->connList = targetP->next;
-        lwm2m_free(targetP);
     }
     else
     {
@@ -299,12 +298,16 @@ void lwm2m_close_connection(void * sessionH,
         {
             parentP = parentP->next;
         }
-        if (parentP != NULL)
-        {
-            parentP->next = targetP->next;
-            lwm2m_free(targetP);
-        }
+        if (parentP == NULL) return;
+
+        parentP->next = targetP->next;
     }
+#ifdef WITH_TINYDTLS
+    // also removes it from the index of the DTLS callbacks
+    connection_release(targetP);
+#else
+    lwm2m_free(targetP);
+#endif
 }
 
 static void prv_output_servers(char * buffer,
@@ -59,7 +59,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <ctype.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -72,6 +72,7 @@
 
 #include "commandline.h"
 #include "connection.h"
+#include "shard.h"
 
 #define MAX_PACKET_SIZE 1024
 
@@ -107,72 +108,81 @@ static char * prv_dump_binding(lwm2m_binding_t binding)
     }
 }
 
-static void prv_dump_client(lwm2m_client_t * targetP)
+static void prv_dump_client(uint32_t clientID,
+                            lwm2m_client_t * targetP)
 {
     lwm2m_client_object_t * objectP;
+    size_t i;
 
-    fprintf(stdout, "Client #%d:\r\n", targetP->internalID);
+    fprintf(stdout, "Client #%u:\r\n", clientID);
     fprintf(stdout, "\tname: \"%s\"\r\n", targetP->name);
     fprintf(stdout, "\tbinding: \"%s\"\r\n", prv_dump_binding(targetP->binding));
     if (targetP->msisdn) fprintf(stdout, "\tmsisdn: \"%s\"\r\n", targetP->msisdn);
     if (targetP->altPath) fprintf(stdout, "\talternative path: \"%s\"\r\n", targetP->altPath);
     fprintf(stdout, "\tlifetime: %d sec\r\n", targetP->lifetime);
     fprintf(stdout, "\tobjects: ");
-    for (objectP = targetP->objectList; objectP != NULL ; objectP = objectP->next)
+    for (i = 0 ; targetP->objectList != NULL && i < targetP->objectList->count ; i++)
     {
-        if (objectP->instanceList == NULL)
+        objectP = targetP->objectList->objects + i;
+        if (objectP->instanceCount == 0)
         {
             fprintf(stdout, "/%d, ", objectP->id);
         }
         else
         {
-            lwm2m_list_t * instanceP;
+            uint16_t j;
 
-            for (instanceP = objectP->instanceList; instanceP != NULL ; instanceP = instanceP->next)
+            for (j = 0 ; j < objectP->instanceCount ; j++)
             {
-                fprintf(stdout, "/%d/%d, ", objectP->id, instanceP->id);
+                fprintf(stdout, "/%d/%d, ", objectP->id, objectP->instances[j]);
             }
         }
     }
     fprintf(stdout, "\r\n");
 }
 
+static void prv_output_client(uint32_t clientID,
+                              lwm2m_client_t * targetP,
+                              void * userData)
+{
+    int * countP = (int *)userData;
+
+    prv_dump_client(clientID, targetP);
+    *countP += 1;
+}
+
 static void prv_output_clients(char * buffer,
                                void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    lwm2m_client_t * targetP;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    int count = 0;
 
-    targetP = lwm2mH->clientList;
+    shard_for_each_client(poolP, prv_output_client, &count);
 
-    if (targetP == NULL)
+    if (count == 0)
     {
         fprintf(stdout, "No client.\r\n");
-        return;
-    }
-
-    for (targetP = lwm2mH->clientList ; targetP != NULL ; targetP = targetP->next)
-    {
-        prv_dump_client(targetP);
     }
 }
 
 static int prv_read_id(char * buffer,
-                       uint16_t * idP)
+                       uint32_t * idP)
 {
     int nb;
-    int value;
+    unsigned long long value;
 
-    nb = sscanf(buffer, "%d", &value);
+    if (buffer[0] == '-') return 0;
+
+    nb = sscanf(buffer, "%llu", &value);
     if (nb == 1)
     {
-        if (value < 0 || value > LWM2M_MAX_ID)
+        if (value > UINT32_MAX)
         {
             nb = 0;
         }
         else
         {
-            *idP = value;
+            *idP = (uint32_t)value;
         }
     }
 
@@ -180,7 +190,7 @@ static int prv_read_id(char * buffer,
 }
 
 
-static void prv_result_callback(uint16_t clientID,
+static void prv_result_callback(uint32_t clientID,
                                 lwm2m_uri_t * uriP,
                                 int status,
                                 lwm2m_media_type_t format,
@@ -188,7 +198,7 @@ static void prv_result_callback(uint16_t clientID,
                                 int dataLength,
                                 void * userData)
 {
-    fprintf(stdout, "\r\nClient #%d /%d", clientID, uriP->objectId);
+    fprintf(stdout, "\r\nClient #%u /%d", clientID, uriP->objectId);
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
         fprintf(stdout, "/%d", uriP->instanceId);
     else if (LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -205,7 +215,7 @@ static void prv_result_callback(uint16_t clientID,
     fflush(stdout);
 }
 
-static void prv_notify_callback(uint16_t clientID,
+static void prv_notify_callback(uint32_t clientID,
                                 lwm2m_uri_t * uriP,
                                 int count,
                                 lwm2m_media_type_t format,
@@ -213,7 +223,7 @@ static void prv_notify_callback(uint16_t clientID,
                                 int dataLength,
                                 void * userData)
 {
-    fprintf(stdout, "\r\nNotify from client #%d /%d", clientID, uriP->objectId);
+    fprintf(stdout, "\r\nNotify from client #%u /%d", clientID, uriP->objectId);
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
         fprintf(stdout, "/%d", uriP->instanceId);
     else if (LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -231,8 +241,8 @@ static void prv_notify_callback(uint16_t clientID,
 static void prv_read_client(char * buffer,
                             void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -248,7 +258,7 @@ static void prv_read_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_read(lwm2mH, clientId, &uri, prv_result_callback, NULL);
+    result = shard_dm_read(poolP, clientId, &uri, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -267,8 +277,8 @@ syntax_error:
 static void prv_discover_client(char * buffer,
                                 void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -284,7 +294,7 @@ static void prv_discover_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_discover(lwm2mH, clientId, &uri, prv_result_callback, NULL);
+    result = shard_dm_discover(poolP, clientId, &uri, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -303,8 +313,8 @@ syntax_error:
 static void prv_write_client(char * buffer,
                              void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -323,7 +333,7 @@ static void prv_write_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_write(lwm2mH, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, NULL);
+    result = shard_dm_write(poolP, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -343,8 +353,8 @@ syntax_error:
 static void prv_time_client(char * buffer,
                             void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -382,7 +392,7 @@ static void prv_time_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_write_attributes(lwm2mH, clientId, &uri, &attr, prv_result_callback, NULL);
+    result = shard_dm_write_attributes(poolP, clientId, &uri, &attr, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -402,8 +412,8 @@ syntax_error:
 static void prv_attr_client(char * buffer,
                             void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -449,7 +459,7 @@ static void prv_attr_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_write_attributes(lwm2mH, clientId, &uri, &attr, prv_result_callback, NULL);
+    result = shard_dm_write_attributes(poolP, clientId, &uri, &attr, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -469,8 +479,8 @@ syntax_error:
 static void prv_clear_client(char * buffer,
                              void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -491,7 +501,7 @@ static void prv_clear_client(char * buffer,
     buffer = get_next_arg(end, &end);
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_write_attributes(lwm2mH, clientId, &uri, &attr, prv_result_callback, NULL);
+    result = shard_dm_write_attributes(poolP, clientId, &uri, &attr, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -511,8 +521,8 @@ syntax_error:
 static void prv_exec_client(char * buffer,
                             void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -531,13 +541,13 @@ static void prv_exec_client(char * buffer,
 
     if (buffer[0] == 0)
     {
-        result = lwm2m_dm_execute(lwm2mH, clientId, &uri, 0, NULL, 0, prv_result_callback, NULL);
+        result = shard_dm_execute(poolP, clientId, &uri, 0, NULL, 0, prv_result_callback, NULL);
     }
     else
     {
         if (!check_end_of_args(end)) goto syntax_error;
 
-        result = lwm2m_dm_execute(lwm2mH, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, NULL);
+        result = shard_dm_execute(poolP, clientId, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)buffer, end - buffer, prv_result_callback, NULL);
     }
 
     if (result == 0)
@@ -557,8 +567,8 @@ syntax_error:
 static void prv_create_client(char * buffer,
                               void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -613,7 +623,7 @@ static void prv_create_client(char * buffer,
    /* End Client dependent part*/
 
     //Create
-    result = lwm2m_dm_create(lwm2mH, clientId, &uri, format, temp_buffer, temp_length, prv_result_callback, NULL);
+    result = shard_dm_create(poolP, clientId, &uri, format, temp_buffer, temp_length, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -632,8 +642,8 @@ syntax_error:
 static void prv_delete_client(char * buffer,
                               void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -649,7 +659,7 @@ static void prv_delete_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_dm_delete(lwm2mH, clientId, &uri, prv_result_callback, NULL);
+    result = shard_dm_delete(poolP, clientId, &uri, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -668,8 +678,8 @@ syntax_error:
 static void prv_observe_client(char * buffer,
                                void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -685,7 +695,7 @@ static void prv_observe_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_observe(lwm2mH, clientId, &uri, prv_notify_callback, NULL);
+    result = shard_observe(poolP, clientId, &uri, prv_notify_callback, NULL);
 
     if (result == 0)
     {
@@ -704,8 +714,8 @@ syntax_error:
 static void prv_cancel_client(char * buffer,
                               void * user_data)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    shard_pool_t * poolP = (shard_pool_t *) user_data;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -721,7 +731,7 @@ static void prv_cancel_client(char * buffer,
 
     if (!check_end_of_args(end)) goto syntax_error;
 
-    result = lwm2m_observe_cancel(lwm2mH, clientId, &uri, prv_result_callback, NULL);
+    result = shard_observe_cancel(poolP, clientId, &uri, prv_result_callback, NULL);
 
     if (result == 0)
     {
@@ -737,7 +747,7 @@ syntax_error:
     fprintf(stdout, "Syntax error !");
 }
 
-static void prv_monitor_callback(uint16_t clientID,
+static void prv_monitor_callback(uint32_t clientID,
                                  lwm2m_uri_t * uriP,
                                  int status,
                                  lwm2m_media_type_t format,
@@ -745,29 +755,29 @@ static void prv_monitor_callback(uint16_t clientID,
                                  int dataLength,
                                  void * userData)
 {
-    lwm2m_context_t * lwm2mH = (lwm2m_context_t *) userData;
+    shard_pool_t * poolP = (shard_pool_t *) userData;
     lwm2m_client_t * targetP;
 
     switch (status)
     {
     case COAP_201_CREATED:
-        fprintf(stdout, "\r\nNew client #%d registered.\r\n", clientID);
+        fprintf(stdout, "\r\nNew client #%u registered.\r\n", clientID);
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = shard_get_client(poolP, clientID);
 
-        prv_dump_client(targetP);
+        prv_dump_client(clientID, targetP);
         break;
 
     case COAP_202_DELETED:
-        fprintf(stdout, "\r\nClient #%d unregistered.\r\n", clientID);
+        fprintf(stdout, "\r\nClient #%u unregistered.\r\n", clientID);
         break;
 
     case COAP_204_CHANGED:
-        fprintf(stdout, "\r\nClient #%d updated.\r\n", clientID);
+        fprintf(stdout, "\r\nClient #%u updated.\r\n", clientID);
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = shard_get_client(poolP, clientID);
 
-        prv_dump_client(targetP);
+        prv_dump_client(clientID, targetP);
         break;
 
     default:
@@ -798,20 +808,22 @@ void print_usage(void)
     fprintf(stdout, "Options:\r\n");
     fprintf(stdout, "  -4\t\tUse IPv4 connection. Default: IPv6 connection\r\n");
     fprintf(stdout, "  -l PORT\tSet the local UDP port of the Server. Default: "LWM2M_STANDARD_PORT_STR"\r\n");
+    fprintf(stdout, "  -t THREADS\tSet the number of worker threads sharing the clients. Default: 1\r\n");
     fprintf(stdout, "\r\n");
 }
 
 
 int main(int argc, char *argv[])
 {
+    static connection_ring_t ring;
     int sock;
-    fd_set readfds;
-    struct timeval tv;
+    int epfd;
+    struct epoll_event event;
     int result;
-    lwm2m_context_t * lwm2mH = NULL;
+    shard_pool_t * poolP = NULL;
     int i;
-    connection_t * connList = NULL;
     int addressFamily = AF_INET6;
+    int threads = 1;
     int opt;
     const char * localPort = LWM2M_STANDARD_PORT_STR;
 
@@ -899,6 +911,17 @@ int main(int argc, char *argv[])
             }
             localPort = argv[opt];
             break;
+        case 't':
+            opt++;
+            if (opt >= argc
+             || sscanf(argv[opt], "%d", &threads) != 1
+             || threads < 1
+             || threads > SHARD_MAX_COUNT)
+            {
+                print_usage();
+                return 0;
+            }
+            break;
         default:
             print_usage();
             return 0;
@@ -913,10 +936,10 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    lwm2mH = lwm2m_init(NULL);
-    if (NULL == lwm2mH)
+    poolP = shard_pool_new(sock, threads);
+    if (NULL == poolP)
     {
-        fprintf(stderr, "lwm2m_init() failed\r\n");
+        fprintf(stderr, "shard_pool_new() failed\r\n");
         return -1;
     }
 
@@ -924,93 +947,91 @@ int main(int argc, char *argv[])
 
     for (i = 0 ; commands[i].name != NULL ; i++)
     {
-        commands[i].userData = (void *)lwm2mH;
+        commands[i].userData = (void *)poolP;
     }
     fprintf(stdout, "> "); fflush(stdout);
 
-    lwm2m_set_monitoring_callback(lwm2mH, prv_monitor_callback, lwm2mH);
+    shard_set_monitoring_callback(poolP, prv_monitor_callback, poolP);
 
-    while (0 == g_quit)
+    epfd = epoll_create1(0);
+    if (epfd < 0)
     {
-        FD_ZERO(&readfds);
-        FD_SET(sock, &readfds);
-        FD_SET(STDIN_FILENO, &readfds);
-
-        tv.tv_sec = 60;
-        tv.tv_usec = 0;
+        fprintf(stderr, "Error in epoll_create1(): %d\r\n", errno);
+        return -1;
+    }
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = sock;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &event);
+    event.data.fd = STDIN_FILENO;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, STDIN_FILENO, &event);
 
-        result = lwm2m_step(lwm2mH, &(tv.tv_sec));
-        if (result != 0)
-        {
-            fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
-            return -1;
-        }
+    while (0 == g_quit)
+    {
+        struct epoll_event events[2];
+        int nbEvents;
 
-        result = select(FD_SETSIZE, &readfds, 0, 0, &tv);
+        // the worker threads run their own timers
+        nbEvents = epoll_wait(epfd, events, 2, 60000);
 
-        if ( result < 0 )
+        if (nbEvents < 0)
         {
             if (errno != EINTR)
             {
-              fprintf(stderr, "Error in select(): %d\r\n", errno);
+              fprintf(stderr, "Error in epoll_wait(): %d\r\n", errno);
             }
         }
-        else if (result > 0)
+        for (i = 0 ; i < nbEvents ; i++)
         {
             uint8_t buffer[MAX_PACKET_SIZE];
             int numBytes;
 
-            if (FD_ISSET(sock, &readfds))
+            if (events[i].data.fd == sock)
             {
-                struct sockaddr_storage addr;
-                socklen_t addrLen;
-
-                addrLen = sizeof(addr);
-                numBytes = recvfrom(sock, buffer, MAX_PACKET_SIZE, 0, (struct sockaddr *)&addr, &addrLen);
-
-                if (numBytes == -1)
+                // drain the socket, one recvmmsg() call per CONNECTION_BATCH_SIZE datagrams
+                do
                 {
-                    fprintf(stderr, "Error in recvfrom(): %d\r\n", errno);
-                }
-                else
-                {
-                    char s[INET6_ADDRSTRLEN];
-                    in_port_t port;
-                    connection_t * connP;
+                    int j;
 
-					s[0] = 0;
-                    if (AF_INET == addr.ss_family)
+                    result = connection_receive(sock, &ring);
+                    if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
                     {
-                        struct sockaddr_in *saddr = (struct sockaddr_in *)&addr;
-                        inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin_port;
+                        fprintf(stderr, "Error in recvmmsg(): %d\r\n", errno);
                     }
-                    else if (AF_INET6 == addr.ss_family)
+
+                    for (j = 0 ; j < result ; j++)
                     {
-                        struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)&addr;
-                        inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
-                        port = saddr->sin6_port;
-                    }
+                        struct sockaddr_storage * addrP = ring.addrs + j;
+                        char s[INET6_ADDRSTRLEN];
+                        in_port_t port;
 
-                    fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
-                    output_buffer(stderr, buffer, numBytes, 0);
+                        numBytes = ring.headers[j].msg_len;
 
-                    connP = connection_find(connList, &addr, addrLen);
-                    if (connP == NULL)
-                    {
-                        connP = connection_new_incoming(connList, sock, (struct sockaddr *)&addr, addrLen);
-                        if (connP != NULL)
+                        s[0] = 0;
+                        if (AF_INET == addrP->ss_family)
                         {
-                            connList = connP;
+                            struct sockaddr_in *saddr = (struct sockaddr_in *)addrP;
+                            inet_ntop(saddr->sin_family, &saddr->sin_addr, s, INET6_ADDRSTRLEN);
+                            port = saddr->sin_port;
+                        }
+                        else if (AF_INET6 == addrP->ss_family)
+                        {
+                            struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)addrP;
+                            inet_ntop(saddr->sin6_family, &saddr->sin6_addr, s, INET6_ADDRSTRLEN);
+                            port = saddr->sin6_port;
+                        }
+
+                        fprintf(stderr, "%d bytes received from [%s]:%hu\r\n", numBytes, s, ntohs(port));
+                        output_buffer(stderr, ring.buffers[j], numBytes, 0);
+
+                        if (!shard_dispatch(poolP, addrP, ring.headers[j].msg_hdr.msg_namelen, ring.buffers[j], numBytes))
+                        {
+                            fprintf(stderr, "#> dropped %d bytes, worker thread busy\r\n", numBytes);
                         }
                     }
-                    if (connP != NULL)
-                    {
-                        lwm2m_handle_packet(lwm2mH, buffer, numBytes, connP);
-                    }
-                }
+                } while (result == CONNECTION_BATCH_SIZE);
             }
-            else if (FD_ISSET(STDIN_FILENO, &readfds))
+            else if (events[i].data.fd == STDIN_FILENO)
             {
                 numBytes = read(STDIN_FILENO, buffer, MAX_PACKET_SIZE - 1);
 
@@ -1033,9 +1054,9 @@ int main(int argc, char *argv[])
         }
     }
 
-    lwm2m_close(lwm2mH);
+    shard_pool_free(poolP);
+    close(epfd);
     close(sock);
-    connection_free(connList);
 
 #ifdef MEMORY_TRACE
     if (g_quit == 1)
@@ -0,0 +1,245 @@
+/**
+ * @file addrtable.c
+ *
+ * Hash table of the connections of the examples, indexed by peer address.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "addrtable.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ADDR_TABLE_INITIAL_SIZE 64
+
+static bool prv_setKey(addr_key_t * keyP,
+                       const struct sockaddr * addr,
+                       size_t addrLen)
+{
+    memset(keyP, 0, sizeof(addr_key_t));
+
+    switch (addr->sa_family)
+    {
+    case AF_INET:
+    {
+        const struct sockaddr_in * saddr = (const struct sockaddr_in *)addr;
+
+        if (addrLen < sizeof(struct sockaddr_in)) return false;
+        keyP->addr.s6_addr[10] = 0xFF;
+        keyP->addr.s6_addr[11] = 0xFF;
+        memcpy(keyP->addr.s6_addr + 12, &saddr->sin_addr, sizeof(struct in_addr));
+        keyP->port = saddr->sin_port;
+        return true;
+    }
+
+    case AF_INET6:
+    {
+        const struct sockaddr_in6 * saddr = (const struct sockaddr_in6 *)addr;
+
+        if (addrLen < sizeof(struct sockaddr_in6)) return false;
+        keyP->addr = saddr->sin6_addr;
+        keyP->scopeId = saddr->sin6_scope_id;
+        keyP->port = saddr->sin6_port;
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+static uint32_t prv_hashKey(const addr_table_t * tableP,
+                            const addr_key_t * keyP)
+{
+    uint32_t words[sizeof(addr_key_t) / sizeof(uint32_t)];
+    uint32_t hash;
+    size_t i;
+
+    memcpy(words, keyP, sizeof(addr_key_t));
+
+    hash = tableP->seed;
+    for (i = 0 ; i < sizeof(words) / sizeof(uint32_t) ; i++)
+    {
+        hash ^= words[i];
+        hash *= 0x9E3779B1u;
+        hash ^= hash >> 15;
+    }
+    hash ^= hash >> 13;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+static void prv_unlinkOrder(addr_table_t * tableP,
+                            addr_node_t * nodeP)
+{
+    if (nodeP->olderP != NULL) nodeP->olderP->newerP = nodeP->newerP;
+    else tableP->oldestP = nodeP->newerP;
+
+    if (nodeP->newerP != NULL) nodeP->newerP->olderP = nodeP->olderP;
+    else tableP->newestP = nodeP->olderP;
+}
+
+static void prv_linkNewest(addr_table_t * tableP,
+                           addr_node_t * nodeP)
+{
+    nodeP->olderP = tableP->newestP;
+    nodeP->newerP = NULL;
+    if (tableP->newestP != NULL) tableP->newestP->newerP = nodeP;
+    else tableP->oldestP = nodeP;
+    tableP->newestP = nodeP;
+}
+
+// Double the bucket count, the table stays usable if this fails
+static void prv_grow(addr_table_t * tableP)
+{
+    addr_node_t ** buckets;
+    size_t bucketCount;
+    size_t i;
+
+    bucketCount = tableP->bucketCount * 2;
+    buckets = (addr_node_t **)calloc(bucketCount, sizeof(addr_node_t *));
+    if (buckets == NULL) return;
+
+    for (i = 0 ; i < tableP->bucketCount ; i++)
+    {
+        addr_node_t * nodeP = tableP->buckets[i];
+
+        while (nodeP != NULL)
+        {
+            addr_node_t * nextP = nodeP->hashNext;
+            size_t index = nodeP->hash & (bucketCount - 1);
+
+            nodeP->hashNext = buckets[index];
+            buckets[index] = nodeP;
+            nodeP = nextP;
+        }
+    }
+
+    free(tableP->buckets);
+    tableP->buckets = buckets;
+    tableP->bucketCount = bucketCount;
+}
+
+bool addr_table_init(addr_table_t * tableP)
+{
+    struct timespec ts;
+
+    memset(tableP, 0, sizeof(addr_table_t));
+
+    tableP->buckets = (addr_node_t **)calloc(ADDR_TABLE_INITIAL_SIZE, sizeof(addr_node_t *));
+    if (tableP->buckets == NULL) return false;
+    tableP->bucketCount = ADDR_TABLE_INITIAL_SIZE;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    tableP->seed = (uint32_t)ts.tv_nsec ^ (uint32_t)ts.tv_sec ^ ((uint32_t)getpid() << 16) ^ (uint32_t)(uintptr_t)tableP;
+
+    return true;
+}
+
+void addr_table_close(addr_table_t * tableP)
+{
+    free(tableP->buckets);
+    memset(tableP, 0, sizeof(addr_table_t));
+}
+
+bool addr_table_add(addr_table_t * tableP,
+                    addr_node_t * nodeP,
+                    const struct sockaddr * addr,
+                    size_t addrLen,
+                    time_t now)
+{
+    size_t index;
+
+    if (!prv_setKey(&nodeP->key, addr, addrLen)) return false;
+
+    if (tableP->count >= tableP->bucketCount)
+    {
+        prv_grow(tableP);
+    }
+
+    nodeP->hash = prv_hashKey(tableP, &nodeP->key);
+    index = nodeP->hash & (tableP->bucketCount - 1);
+    nodeP->hashNext = tableP->buckets[index];
+    tableP->buckets[index] = nodeP;
+    tableP->count++;
+
+    nodeP->lastActivity = now;
+    prv_linkNewest(tableP, nodeP);
+
+    return true;
+}
+
+void addr_table_remove(addr_table_t * tableP,
+                       addr_node_t * nodeP)
+{
+    addr_node_t ** nodeH;
+
+    nodeH = tableP->buckets + (nodeP->hash & (tableP->bucketCount - 1));
+    while (*nodeH != NULL && *nodeH != nodeP)
+    {
+        nodeH = &(*nodeH)->hashNext;
+    }
+    if (*nodeH == NULL) return;
+
+    *nodeH = nodeP->hashNext;
+    tableP->count--;
+    prv_unlinkOrder(tableP, nodeP);
+}
+
+addr_node_t * addr_table_find(addr_table_t * tableP,
+                              const struct sockaddr * addr,
+                              size_t addrLen,
+                              time_t now)
+{
+    addr_key_t key;
+    addr_node_t * nodeP;
+    uint32_t hash;
+
+    if (!prv_setKey(&key, addr, addrLen)) return NULL;
+
+    hash = prv_hashKey(tableP, &key);
+    nodeP = tableP->buckets[hash & (tableP->bucketCount - 1)];
+    while (nodeP != NULL
+        && (nodeP->hash != hash || memcmp(&nodeP->key, &key, sizeof(addr_key_t)) != 0))
+    {
+        nodeP = nodeP->hashNext;
+    }
+
+    if (nodeP != NULL)
+    {
+        addr_table_touch(tableP, nodeP, now);
+    }
+
+    return nodeP;
+}
+
+void addr_table_touch(addr_table_t * tableP,
+                      addr_node_t * nodeP,
+                      time_t now)
+{
+    // the nodes after it were also used at now, the order is kept without moving it
+    if (nodeP->lastActivity == now) return;
+
+    nodeP->lastActivity = now;
+    if (tableP->newestP != nodeP)
+    {
+        prv_unlinkOrder(tableP, nodeP);
+        prv_linkNewest(tableP, nodeP);
+    }
+}
+
+addr_node_t * addr_table_get_idle(addr_table_t * tableP,
+                                  time_t idleTime,
+                                  time_t now)
+{
+    addr_node_t * nodeP = tableP->oldestP;
+
+    if (nodeP != NULL && now - nodeP->lastActivity > idleTime) return nodeP;
+
+    return NULL;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file addrtable.h
+ *
+ * Hash table of the connections of the examples, indexed by peer address.
+ *
+ * The connection structures embed an addr_node_t as their first member, so a node is
+ * converted to its connection by a cast. An IPv4 address and its IPv4-mapped IPv6 form
+ * are the same key. The table also orders its nodes from the least to the most recently
+ * used, so the idle connections are found without scanning the others.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#ifndef ADDRTABLE_H_
+#define ADDRTABLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+typedef struct
+{
+    struct in6_addr addr;       // IPv4 addresses in their IPv4-mapped form
+    uint32_t        scopeId;
+    in_port_t       port;
+    uint16_t        padding;    // always zero, the keys are compared with memcmp()
+} addr_key_t;
+
+typedef struct _addr_node_t
+{
+    struct _addr_node_t *   hashNext;
+    struct _addr_node_t *   olderP;
+    struct _addr_node_t *   newerP;
+    uint32_t                hash;
+    addr_key_t              key;
+    time_t                  lastActivity;
+} addr_node_t;
+
+typedef struct
+{
+    addr_node_t **  buckets;
+    size_t          bucketCount;    // power of two
+    size_t          count;
+    uint32_t        seed;           // random, against crafted colliding addresses
+    addr_node_t *   oldestP;
+    addr_node_t *   newestP;
+} addr_table_t;
+
+bool addr_table_init(addr_table_t * tableP);
+// Release the buckets, the nodes belong to the caller
+void addr_table_close(addr_table_t * tableP);
+
+// Returns false when the address is neither AF_INET nor AF_INET6
+bool addr_table_add(addr_table_t * tableP, addr_node_t * nodeP, const struct sockaddr * addr, size_t addrLen, time_t now);
+void addr_table_remove(addr_table_t * tableP, addr_node_t * nodeP);
+
+// The node found is marked as used at now
+addr_node_t * addr_table_find(addr_table_t * tableP, const struct sockaddr * addr, size_t addrLen, time_t now);
+void addr_table_touch(addr_table_t * tableP, addr_node_t * nodeP, time_t now);
+
+// Least recently used node when it was not used for more than idleTime seconds, NULL otherwise
+addr_node_t * addr_table_get_idle(addr_table_t * tableP, time_t idleTime, time_t now);
+
+#endif /* ADDRTABLE_H_ */
@@ -24,6 +24,76 @@
 // from commandline.c
 void output_buffer(FILE * stream, uint8_t * buffer, int length, int indent);
 
+// batch of the calling thread, see connection_start_batch()
+static _Thread_local connection_batch_t * g_batchP = NULL;
+
+static void prv_sendBatch(connection_batch_t * batchP)
+{
+    unsigned int offset;
+
+    offset = 0;
+    while (offset < batchP->count)
+    {
+        int nbSent;
+
+        nbSent = sendmmsg(batchP->sock, batchP->headers + offset, batchP->count - offset, 0);
+        if (nbSent <= 0)
+        {
+            // skip the datagram in error
+            fprintf(stderr, "#> failed sending %u bytes\r\n", batchP->headers[offset].msg_len);
+            nbSent = 1;
+        }
+        offset += nbSent;
+    }
+    batchP->count = 0;
+}
+
+// Copy the datagram in the batch of the calling thread, if any
+static bool prv_queueDatagram(connection_t * connP,
+                              const struct iovec * vector,
+                              size_t count,
+                              size_t length)
+{
+    connection_batch_t * batchP = g_batchP;
+    struct mmsghdr * headerP;
+    size_t offset;
+    size_t i;
+
+    if (batchP == NULL || length > CONNECTION_DATAGRAM_SIZE) return false;
+
+    if (batchP->count == CONNECTION_BATCH_SIZE
+     || (batchP->count != 0 && batchP->sock != connP->sock))
+    {
+        prv_sendBatch(batchP);
+    }
+    batchP->sock = connP->sock;
+
+    offset = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        memcpy(batchP->buffers[batchP->count] + offset, vector[i].iov_base, vector[i].iov_len);
+        offset += vector[i].iov_len;
+    }
+    // the connection may be released before the batch is sent
+    memcpy(batchP->addrs + batchP->count, &(connP->addr), connP->addrLen);
+
+    batchP->iovecs[batchP->count].iov_base = batchP->buffers[batchP->count];
+    batchP->iovecs[batchP->count].iov_len = length;
+
+    headerP = batchP->headers + batchP->count;
+    memset(headerP, 0, sizeof(struct mmsghdr));
+    headerP->msg_hdr.msg_name = batchP->addrs + batchP->count;
+    headerP->msg_hdr.msg_namelen = connP->addrLen;
+    headerP->msg_hdr.msg_iov = batchP->iovecs + batchP->count;
+    headerP->msg_hdr.msg_iovlen = 1;
+    // reported on error
+    headerP->msg_len = length;
+
+    batchP->count++;
+
+    return true;
+}
+
 int create_socket(const char * portStr, int addressFamily)
 {
     int s = -1;
@@ -89,6 +159,7 @@ connection_t * connection_new_incoming(connection_t * connList,
     connP = (connection_t *)malloc(sizeof(connection_t));
     if (connP != NULL)
     {
+        memset(connP, 0, sizeof(connection_t));
         connP->sock = sock;
         memcpy(&(connP->addr), addr, addrLen);
         connP->addrLen = addrLen;
@@ -167,6 +238,71 @@ void connection_free(connection_t * connList)
     }
 }
 
+connection_t * connection_lookup(addr_table_t * tableP,
+                                 const struct sockaddr_storage * addr,
+                                 size_t addrLen)
+{
+    return (connection_t *)addr_table_find(tableP, (const struct sockaddr *)addr, addrLen, lwm2m_gettime());
+}
+
+connection_t * connection_add_incoming(addr_table_t * tableP,
+                                       int sock,
+                                       const struct sockaddr * addr,
+                                       size_t addrLen)
+{
+    connection_t * connP;
+
+    if (addrLen > sizeof(connP->addr)) return NULL;
+
+    connP = connection_new_incoming(NULL, sock, (struct sockaddr *)addr, addrLen);
+    if (connP != NULL
+     && !addr_table_add(tableP, &connP->node, addr, addrLen, lwm2m_gettime()))
+    {
+        free(connP);
+        connP = NULL;
+    }
+
+    return connP;
+}
+
+void connection_remove(addr_table_t * tableP,
+                       connection_t * connP)
+{
+    addr_table_remove(tableP, &connP->node);
+    free(connP);
+}
+
+void connection_free_table(addr_table_t * tableP)
+{
+    while (tableP->oldestP != NULL)
+    {
+        connection_remove(tableP, (connection_t *)tableP->oldestP);
+    }
+    addr_table_close(tableP);
+}
+
+void connection_touch(addr_table_t * tableP,
+                      connection_t * connP)
+{
+    addr_table_touch(tableP, &connP->node, lwm2m_gettime());
+}
+
+size_t connection_evict(addr_table_t * tableP,
+                        time_t idleTime)
+{
+    time_t now = lwm2m_gettime();
+    addr_node_t * nodeP;
+    size_t count = 0;
+
+    while ((nodeP = addr_table_get_idle(tableP, idleTime, now)) != NULL)
+    {
+        connection_remove(tableP, (connection_t *)nodeP);
+        count++;
+    }
+
+    return count;
+}
+
 int connection_send(connection_t *connP,
                     uint8_t * buffer,
                     size_t length)
@@ -198,6 +334,14 @@ int connection_send(connection_t *connP,
     output_buffer(stderr, buffer, length, 0);
 #endif
 
+    {
+        struct iovec vector;
+
+        vector.iov_base = buffer;
+        vector.iov_len = length;
+        if (prv_queueDatagram(connP, &vector, 1, length)) return 0;
+    }
+
     offset = 0;
     while (offset != length)
     {
@@ -213,6 +357,41 @@ int connection_send(connection_t *connP,
     return 0;
 }
 
+int connection_receive(int sock,
+                       connection_ring_t * ringP)
+{
+    int i;
+
+    // recvmmsg() overwrites the address lengths
+    for (i = 0 ; i < CONNECTION_BATCH_SIZE ; i++)
+    {
+        ringP->iovecs[i].iov_base = ringP->buffers[i];
+        ringP->iovecs[i].iov_len = CONNECTION_DATAGRAM_SIZE;
+        memset(ringP->headers + i, 0, sizeof(struct mmsghdr));
+        ringP->headers[i].msg_hdr.msg_name = ringP->addrs + i;
+        ringP->headers[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        ringP->headers[i].msg_hdr.msg_iov = ringP->iovecs + i;
+        ringP->headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    return recvmmsg(sock, ringP->headers, CONNECTION_BATCH_SIZE, MSG_DONTWAIT, NULL);
+}
+
+void connection_start_batch(connection_batch_t * batchP)
+{
+    batchP->count = 0;
+    g_batchP = batchP;
+}
+
+void connection_flush_batch(connection_batch_t * batchP)
+{
+    g_batchP = NULL;
+    if (batchP->count != 0)
+    {
+        prv_sendBatch(batchP);
+    }
+}
+
 uint8_t lwm2m_buffer_send(void * sessionH,
                           uint8_t * buffer,
                           size_t length,
@@ -221,6 +400,9 @@ uint8_t lwm2m_buffer_send(void * sessionH,
 {
     connection_t * connP = (connection_t*) sessionH;
 
+    (void)userdata;
+    (void)firstBlock;
+
     if (connP == NULL)
     {
         fprintf(stderr, "#> failed sending %lu bytes, missing connection\r\n", length);
@@ -236,9 +418,64 @@ uint8_t lwm2m_buffer_send(void * sessionH,
     return COAP_NO_ERROR;
 }
 
+#ifdef LWM2M_WITH_SENDV
+uint8_t lwm2m_buffer_sendv(void * sessionH,
+                           const lwm2m_iovec_t * vector,
+                           size_t count,
+                           void * userdata,
+                           bool firstBlock)
+{
+    connection_t * connP = (connection_t*) sessionH;
+    struct iovec iov[count];
+    struct msghdr msg;
+    size_t length;
+    size_t i;
+
+    (void)userdata;
+    (void)firstBlock;
+
+    if (connP == NULL)
+    {
+        fprintf(stderr, "#> failed sending %lu buffers, missing connection\r\n", count);
+        return COAP_500_INTERNAL_SERVER_ERROR ;
+    }
+
+    length = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        iov[i].iov_base = vector[i].buffer;
+        iov[i].iov_len = vector[i].length;
+        length += vector[i].length;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &(connP->addr);
+    msg.msg_namelen = connP->addrLen;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+#ifdef WITH_LOGS
+    fprintf(stderr, "Sending %lu bytes in %lu buffers\r\n", length, count);
+#endif
+
+    if (prv_queueDatagram(connP, iov, count, length)) return COAP_NO_ERROR;
+
+    // a datagram socket sends the whole message or nothing
+    if (sendmsg(connP->sock, &msg, 0) != (ssize_t)length)
+    {
+        fprintf(stderr, "#> failed sending %lu bytes\r\n", length);
+        return COAP_500_INTERNAL_SERVER_ERROR ;
+    }
+
+    return COAP_NO_ERROR;
+}
+#endif
+
 bool lwm2m_session_is_equal(void * session1,
                             void * session2,
                             void * userData)
 {
+    (void)userData;
+
     return (session1 == session2);
 }
@@ -27,6 +27,18 @@
 #include <sys/stat.h>
 #include <liblwm2m.h>
 
+#include "addrtable.h"
+
+// Datagrams read by connection_receive(), or sent by one sendmmsg() call
+#ifndef CONNECTION_BATCH_SIZE
+#define CONNECTION_BATCH_SIZE       32
+#endif
+
+// Largest datagram received by connection_receive() or queued in a batch
+#ifndef CONNECTION_DATAGRAM_SIZE
+#define CONNECTION_DATAGRAM_SIZE    1024
+#endif
+
 #define LWM2M_STANDARD_PORT_STR "5683"
 #define LWM2M_STANDARD_PORT      5683
 #define LWM2M_DTLS_PORT_STR     "5684"
@@ -34,14 +46,41 @@
 #define LWM2M_BSSERVER_PORT_STR "5685"
 #define LWM2M_BSSERVER_PORT      5685
 
+// Seconds without traffic after which connection_evict() releases a connection. This is
+// longer than the CoAP EXCHANGE_LIFETIME (247 s), so no transaction still uses it.
+#ifndef CONNECTION_IDLE_TIMEOUT
+#define CONNECTION_IDLE_TIMEOUT     300
+#endif
+
 typedef struct _connection_t
 {
+    addr_node_t             node;   // must be first, only used by connection tables
     struct _connection_t *  next;
     int                     sock;
     struct sockaddr_in6     addr;
     size_t                  addrLen;
 } connection_t;
 
+// Receive buffers, reused by each connection_receive() call
+typedef struct
+{
+    struct mmsghdr          headers[CONNECTION_BATCH_SIZE];
+    struct iovec            iovecs[CONNECTION_BATCH_SIZE];
+    struct sockaddr_storage addrs[CONNECTION_BATCH_SIZE];
+    uint8_t                 buffers[CONNECTION_BATCH_SIZE][CONNECTION_DATAGRAM_SIZE];
+} connection_ring_t;
+
+// Outgoing datagrams waiting for connection_flush_batch()
+typedef struct
+{
+    int                 sock;
+    unsigned int        count;
+    struct mmsghdr      headers[CONNECTION_BATCH_SIZE];
+    struct iovec        iovecs[CONNECTION_BATCH_SIZE];
+    struct sockaddr_in6 addrs[CONNECTION_BATCH_SIZE];
+    uint8_t             buffers[CONNECTION_BATCH_SIZE][CONNECTION_DATAGRAM_SIZE];
+} connection_batch_t;
+
 int create_socket(const char * portStr, int ai_family);
 
 connection_t * connection_find(connection_t * connList, struct sockaddr_storage * addr, size_t addrLen);
@@ -50,6 +89,27 @@ connection_t * connection_create(connection_t * connList, int sock, char * host,
 
 void connection_free(connection_t * connList);
 
+// Same as above for the connections indexed by an addr_table_t, which are found in constant time
+connection_t * connection_lookup(addr_table_t * tableP, const struct sockaddr_storage * addr, size_t addrLen);
+connection_t * connection_add_incoming(addr_table_t * tableP, int sock, const struct sockaddr * addr, size_t addrLen);
+void connection_remove(addr_table_t * tableP, connection_t * connP);
+void connection_free_table(addr_table_t * tableP);
+
+// Mark connP as used, so connection_evict() keeps it
+void connection_touch(addr_table_t * tableP, connection_t * connP);
+// Release the connections of tableP idle for more than idleTime seconds. Returns their number.
+size_t connection_evict(addr_table_t * tableP, time_t idleTime);
+
 int connection_send(connection_t *connP, uint8_t * buffer, size_t length);
 
+// Read the datagrams pending on the socket sock with one non-blocking recvmmsg() call.
+// Returns their number, datagram i being ringP->buffers[i] of length ringP->headers[i].msg_len
+// received from ringP->addrs[i], or -1 with errno set to EAGAIN when there is none.
+int connection_receive(int sock, connection_ring_t * ringP);
+
+// Until connection_flush_batch(), the datagrams sent by the calling thread are queued in
+// batchP then sent together by sendmmsg().
+void connection_start_batch(connection_batch_t * batchP);
+void connection_flush_batch(connection_batch_t * batchP);
+
 #endif
@@ -27,6 +27,8 @@
 #define URI_LENGTH 256
 
 dtls_context_t * dtlsContext;
+// every connection, so the DTLS callbacks find their peer without scanning a list
+static addr_table_t connTable;
 
 /********************* Security Obj Helpers **********************/
 char * security_get_uri(lwm2m_object_t * obj, int instanceId, char * uriBuffer, int bufferSize){
@@ -175,7 +177,7 @@ static int get_psk_info(struct dtls_context_t *ctx,
         unsigned char *result, size_t result_length) {
 
     // find connection
-    dtls_connection_t* cnx = connection_find((dtls_connection_t *) ctx->app, &(session->addr.st),session->size);
+    dtls_connection_t* cnx = connection_find(NULL, &(session->addr.st),session->size);
     if (cnx == NULL)
     {
         printf("GET PSK session not found\n");
@@ -225,8 +227,7 @@ static int send_to_peer(struct dtls_context_t *ctx,
         session_t *session, uint8 *data, size_t len) {
 
     // find connection
-    dtls_connection_t * connP = (dtls_connection_t *) ctx->app;
-    dtls_connection_t* cnx = connection_find((dtls_connection_t *) ctx->app, &(session->addr.st),session->size);
+    dtls_connection_t* cnx = connection_find(NULL, &(session->addr.st),session->size);
     if (cnx != NULL)
     {
         // send data to peer
@@ -246,8 +247,7 @@ static int read_from_peer(struct dtls_context_t *ctx,
           session_t *session, uint8 *data, size_t len) {
 
     // find connection
-    dtls_connection_t * connP = (dtls_connection_t *) ctx->app;
-    dtls_connection_t* cnx = connection_find((dtls_connection_t *) ctx->app, &(session->addr.st),session->size);
+    dtls_connection_t* cnx = connection_find(NULL, &(session->addr.st),session->size);
     if (cnx != NULL)
     {
         lwm2m_handle_packet(cnx->lwm2mH, (uint8_t*)data, len, (void*)cnx);
@@ -270,69 +270,17 @@ static dtls_handler_t cb = {
 //#endif /* DTLS_ECC */
 };
 
-dtls_context_t * get_dtls_context(dtls_connection_t * connList) {
+dtls_context_t * get_dtls_context(void) {
     if (dtlsContext == NULL) {
         dtls_init();
-        dtlsContext = dtls_new_context(connList);
+        dtlsContext = dtls_new_context(&connTable);
         if (dtlsContext == NULL)
             fprintf(stderr, "Failed to create the DTLS context\r\n");
         dtls_set_handler(dtlsContext, &cb);
-    }else{
-        dtlsContext->app = connList;
     }
     return dtlsContext;
 }
 
-int get_port(struct sockaddr *x)
-{
-   if (x->sa_family == AF_INET)
-   {
-       return ((struct sockaddr_in *)x)->sin_port;
-   } else if (x->sa_family == AF_INET6) {
-       return ((struct sockaddr_in6 *)x)->sin6_port;
-   } else {
-       printf("non IPV4 or IPV6 address\n");
-       return  -1;
-   }
-}
-
-int sockaddr_cmp(struct sockaddr *x, struct sockaddr *y)
-{
-    int portX = get_port(x);
-    int portY = get_port(y);
-
-    // if the port is invalid of different
-    if (portX == -1 || portX != portY)
-    {
-        return 0;
-    }
-
-    // IPV4?
-    if (x->sa_family == AF_INET)
-    {
-        // is V4?
-        if (y->sa_family == AF_INET)
-        {
-            // compare V4 with V4
-            return ((struct sockaddr_in *)x)->sin_addr.s_addr == ((struct sockaddr_in *)y)->sin_addr.s_addr;
-            // is V6 mapped V4?
-        } else if (IN6_IS_ADDR_V4MAPPED(&((struct sockaddr_in6 *)y)->sin6_addr)) {
-            struct in6_addr* addr6 = &((struct sockaddr_in6 *)y)->sin6_addr;
-            uint32_t y6to4 = addr6->s6_addr[15] << 24 | addr6->s6_addr[14] << 16 | addr6->s6_addr[13] << 8 | addr6->s6_addr[12];
-            return y6to4 == ((struct sockaddr_in *)x)->sin_addr.s_addr;
-        } else {
-            return 0;
-        }
-    } else if (x->sa_family == AF_INET6 && y->sa_family == AF_INET6) {
-        // IPV6 with IPV6 compare
-        return memcmp(((struct sockaddr_in6 *)x)->sin6_addr.s6_addr, ((struct sockaddr_in6 *)y)->sin6_addr.s6_addr, 16) == 0;
-    } else {
-        // unknown address type
-        printf("non IPV4 or IPV6 address\n");
-        return 0;
-    }
-}
-
 int create_socket(const char * portStr, int ai_family)
 {
     int s = -1;
@@ -372,20 +320,9 @@ dtls_connection_t * connection_find(dtls_connection_t * connList,
                                const struct sockaddr_storage * addr,
                                size_t addrLen)
 {
-    dtls_connection_t * connP;
-
-    connP = connList;
-    while (connP != NULL)
-    {
-
-       if (sockaddr_cmp((struct sockaddr*) (&connP->addr),(struct sockaddr*) addr)) {
-            return connP;
-       }
-
-       connP = connP->next;
-    }
+    if (connTable.buckets == NULL) return NULL;
 
-    return connP;
+    return (dtls_connection_t *)addr_table_find(&connTable, (const struct sockaddr *)addr, addrLen, lwm2m_gettime());
 }
 
 dtls_connection_t * connection_new_incoming(dtls_connection_t * connList,
@@ -395,6 +332,9 @@ dtls_connection_t * connection_new_incoming(dtls_connection_t * connList,
 {
     dtls_connection_t * connP;
 
+    if (addrLen > sizeof(connP->addr)) return NULL;
+    if (connTable.buckets == NULL && !addr_table_init(&connTable)) return NULL;
+
     connP = (dtls_connection_t *)malloc(sizeof(dtls_connection_t));
     if (connP != NULL)
     {
@@ -404,6 +344,12 @@ dtls_connection_t * connection_new_incoming(dtls_connection_t * connList,
         connP->addrLen = addrLen;
         connP->next = connList;
 
+        if (!addr_table_add(&connTable, &connP->node, addr, addrLen, lwm2m_gettime()))
+        {
+            free(connP);
+            return NULL;
+        }
+
         connP->dtlsSession = (session_t *)malloc(sizeof(session_t));
         memset(connP->dtlsSession, 0, sizeof(session_t));
         connP->dtlsSession->addr.sin6 = connP->addr;
@@ -514,11 +460,12 @@ dtls_connection_t * connection_create(dtls_connection_t * connList,
             if (security_get_mode(connP->securityObj,connP->securityInstId)
                      != LWM2M_SECURITY_MODE_NONE)
             {
-                connP->dtlsContext = get_dtls_context(connP);
+                connP->dtlsContext = get_dtls_context();
             }
             else
             {
                 // no dtls session
+                free(connP->dtlsSession);
                 connP->dtlsSession = NULL;
             }
         }
@@ -538,12 +485,23 @@ void connection_free(dtls_connection_t * connList)
         dtls_connection_t * nextP;
 
         nextP = connList->next;
-        free(connList);
+        connection_release(connList);
 
         connList = nextP;
     }
 }
 
+void connection_release(dtls_connection_t * connP)
+{
+    addr_table_remove(&connTable, &connP->node);
+    if (connTable.count == 0)
+    {
+        addr_table_close(&connTable);
+    }
+    free(connP->dtlsSession);
+    free(connP);
+}
+
 int connection_send(dtls_connection_t *connP, uint8_t * buffer, size_t length){
     if (connP->dtlsSession == NULL) {
         // no security
@@ -634,6 +592,46 @@ uint8_t lwm2m_buffer_send(void * sessionH,
     return COAP_NO_ERROR;
 }
 
+#ifdef LWM2M_WITH_SENDV
+uint8_t lwm2m_buffer_sendv(void * sessionH,
+                           const lwm2m_iovec_t * vector,
+                           size_t count,
+                           void * userdata,
+                           bool firstBlock)
+{
+    uint8_t * buffer;
+    uint8_t result;
+    size_t length;
+    size_t i;
+
+    // a DTLS record is encrypted from a single buffer
+    length = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        length += vector[i].length;
+    }
+
+    buffer = (uint8_t *)malloc(length);
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "#> failed sending %lu bytes, out of memory\r\n", length);
+        return COAP_500_INTERNAL_SERVER_ERROR ;
+    }
+
+    length = 0;
+    for (i = 0 ; i < count ; i++)
+    {
+        memcpy(buffer + length, vector[i].buffer, vector[i].length);
+        length += vector[i].length;
+    }
+
+    result = lwm2m_buffer_send(sessionH, buffer, length, userdata);
+    free(buffer);
+
+    return result;
+}
+#endif
+
 bool lwm2m_session_is_equal(void * session1,
                             void * session2,
                             void * userData)
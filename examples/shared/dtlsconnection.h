@@ -32,6 +32,7 @@
 #include "tinydtls/tinydtls.h"
 #include "tinydtls/dtls.h"
 #include "liblwm2m.h"
+#include "addrtable.h"
 
 #define LWM2M_STANDARD_PORT_STR "5683"
 #define LWM2M_STANDARD_PORT      5683
@@ -45,6 +46,7 @@
 
 typedef struct _dtls_connection_t
 {
+    addr_node_t             node;   // must be first, all the connections are indexed by address
     struct _dtls_connection_t *  next;
     int                     sock;
     struct sockaddr_in6     addr;
@@ -59,11 +61,14 @@ typedef struct _dtls_connection_t
 
 int create_socket(const char * portStr, int ai_family);
 
+// Finds any connection by its address in constant time, connList is only kept for compatibility
 dtls_connection_t * connection_find(dtls_connection_t * connList, const struct sockaddr_storage * addr, size_t addrLen);
 dtls_connection_t * connection_new_incoming(dtls_connection_t * connList, int sock, const struct sockaddr * addr, size_t addrLen);
 dtls_connection_t * connection_create(dtls_connection_t * connList, int sock, lwm2m_object_t * securityObj, int instanceId, lwm2m_context_t * lwm2mH, int addressFamily);
 
 void connection_free(dtls_connection_t * connList);
+// Release a connection already removed from its list
+void connection_release(dtls_connection_t * connP);
 
 int connection_send(dtls_connection_t *connP, uint8_t * buffer, size_t length);
 int connection_handle_packet(dtls_connection_t *connP, uint8_t * buffer, size_t length);
@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <sys/time.h>
+#include <time.h>
 
 #ifndef LWM2M_MEMORY_TRACE
 
@@ -59,6 +60,20 @@ time_t lwm2m_gettime(void)
     return tv.tv_sec;
 }
 
+#ifdef LWM2M_WITH_MS_CLOCK
+int64_t lwm2m_gettime_ms(void)
+{
+    struct timespec ts;
+
+    if (0 != clock_gettime(CLOCK_MONOTONIC, &ts))
+    {
+        return -1;
+    }
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#endif
+
 void lwm2m_printf(const char * format, ...)
 {
     va_list ap;
@@ -0,0 +1,1033 @@
+/**
+ * @file shard.c
+ *
+ * Multi-threaded LWM2M server runtime, see shard.h.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "shard.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#define SHARD_CACHE_LINE    64
+
+// Longest sleep of an idle worker thread, in milliseconds
+#define SHARD_MAX_WAIT_MS   60000
+// Interval between two connection_evict() calls
+#define SHARD_EVICT_PERIOD_MS   (CONNECTION_IDLE_TIMEOUT * 250)
+
+typedef struct
+{
+    struct sockaddr_storage addr;
+    socklen_t               addrLen;
+    size_t                  length;
+    uint8_t                 buffer[SHARD_DATAGRAM_SIZE];
+} shard_datagram_t;
+
+// Pending shard_call(), lives on the stack of the calling thread
+typedef struct _shard_request_
+{
+    struct _shard_request_ * next;
+    shard_function_t         function;
+    void *                   userData;
+    int                      result;
+    bool                     done;
+} shard_request_t;
+
+typedef struct _shard_ shard_t;
+
+// Translates the client ID given to a user callback
+typedef struct _shard_callback_
+{
+    struct _shard_callback_ * next;
+    shard_t *                 shardP;
+    lwm2m_result_callback_t   callback;
+    void *                    userData;
+    uint32_t                  slot;     // slot of the observation holding an observation callback
+} shard_callback_t;
+
+typedef enum
+{
+    SHARD_DM_READ,
+    SHARD_DM_DISCOVER,
+    SHARD_DM_WRITE,
+    SHARD_DM_WRITE_ATTRIBUTES,
+    SHARD_DM_EXECUTE,
+    SHARD_DM_CREATE,
+    SHARD_DM_DELETE,
+    SHARD_OBSERVE,
+    SHARD_OBSERVE_CANCEL
+} shard_operation_type_t;
+
+typedef struct
+{
+    shard_operation_type_t  type;
+    uint32_t                clientID;   // shard local ID
+    lwm2m_uri_t *           uriP;
+    lwm2m_media_type_t      format;
+    uint8_t *               buffer;
+    int                     length;
+    lwm2m_attributes_t *    attrP;
+    lwm2m_result_callback_t callback;
+    void *                  userData;
+} shard_operation_t;
+
+typedef struct
+{
+    shard_client_callback_t callback;
+    void *                  userData;
+} shard_iterator_t;
+
+struct _shard_
+{
+    // Producer side of the queue, only written by the I/O thread
+    _Alignas(SHARD_CACHE_LINE) atomic_size_t tail;
+    size_t                  headCache;
+    atomic_uint_least64_t   dropped;
+
+    // Consumer side of the queue, only written by the worker thread
+    _Alignas(SHARD_CACHE_LINE) atomic_size_t head;
+    atomic_uint_least64_t   handled;
+
+    // Read by the I/O thread for each datagram, written when the worker thread goes idle,
+    // so kept apart from the queue indexes written for each datagram
+    _Alignas(SHARD_CACHE_LINE) atomic_bool sleeping;
+
+    _Alignas(SHARD_CACHE_LINE) shard_pool_t * poolP;
+    size_t                  index;
+    pthread_t               thread;
+    bool                    started;
+    shard_datagram_t *      queue;
+    pthread_mutex_t         mutex;
+    pthread_cond_t          wakeup;         // signaled to the worker thread
+    pthread_cond_t          done;           // signaled to the threads waiting in shard_call()
+    shard_request_t *       requestList;    // protected by mutex
+
+    // Only used by the worker thread
+    lwm2m_context_t *       contextP;
+    addr_table_t            connTable;
+    shard_callback_t *      callbackList;   // observation callbacks, released with their observation
+    size_t                  callbackCount;
+    bool                    stepNeeded;
+    connection_batch_t      batch;          // responses sent by one sendmmsg() per iteration
+};
+
+struct _shard_pool_
+{
+    size_t                  count;
+    int                     sock;
+    atomic_bool             stop;
+    lwm2m_result_callback_t monitorCallback;
+    void *                  monitorUserData;
+    shard_t *               shards;
+};
+
+// Shard of the worker thread, NULL on the other threads
+static _Thread_local shard_t * currentShardP = NULL;
+
+static int64_t prv_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// FNV-1a of the peer address and port
+static size_t prv_hashAddress(struct sockaddr_storage * addr,
+                              socklen_t addrLen)
+{
+    const uint8_t * bytes;
+    size_t length;
+    uint16_t port;
+    uint32_t hash;
+    size_t i;
+
+    switch (addr->ss_family)
+    {
+    case AF_INET:
+        bytes = (const uint8_t *)&((struct sockaddr_in *)addr)->sin_addr;
+        length = sizeof(struct in_addr);
+        port = ((struct sockaddr_in *)addr)->sin_port;
+        break;
+    case AF_INET6:
+        bytes = (const uint8_t *)&((struct sockaddr_in6 *)addr)->sin6_addr;
+        length = sizeof(struct in6_addr);
+        port = ((struct sockaddr_in6 *)addr)->sin6_port;
+        break;
+    default:
+        bytes = (const uint8_t *)addr;
+        length = addrLen;
+        port = 0;
+        break;
+    }
+
+    hash = 2166136261u;
+    for (i = 0 ; i < length ; i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    hash = (hash ^ (port & 0xFF)) * 16777619u;
+    hash = (hash ^ (port >> 8)) * 16777619u;
+
+    return hash;
+}
+
+static uint32_t prv_globalId(shard_t * shardP,
+                             uint32_t clientID)
+{
+    return (uint32_t)(clientID * shardP->poolP->count + shardP->index);
+}
+
+static shard_t * prv_findShard(shard_pool_t * poolP,
+                               uint32_t clientID,
+                               uint32_t * localIdP)
+{
+    *localIdP = (uint32_t)(clientID / poolP->count);
+    return poolP->shards + clientID % poolP->count;
+}
+
+static void prv_monitorCallback(uint32_t clientID,
+                                lwm2m_uri_t * uriP,
+                                int status,
+                                lwm2m_media_type_t format,
+                                uint8_t * data,
+                                int dataLength,
+                                void * userData)
+{
+    shard_t * shardP = (shard_t *)userData;
+
+    shardP->poolP->monitorCallback(prv_globalId(shardP, clientID), uriP, status, format, data, dataLength, shardP->poolP->monitorUserData);
+}
+
+// Callback of an operation which completes only once
+static void prv_resultCallback(uint32_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    shard_callback_t * callbackP = (shard_callback_t *)userData;
+
+    callbackP->callback(prv_globalId(callbackP->shardP, clientID), uriP, status, format, data, dataLength, callbackP->userData);
+    free(callbackP);
+}
+
+// Callback of an observation, called for each notification
+static void prv_notifyCallback(uint32_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    shard_callback_t * callbackP = (shard_callback_t *)userData;
+
+    callbackP->callback(prv_globalId(callbackP->shardP, clientID), uriP, status, format, data, dataLength, callbackP->userData);
+}
+
+// Observation of the client holding userData, NULL when the client has none
+static lwm2m_observation_t * prv_findObservation(lwm2m_context_t * contextP,
+                                                 uint32_t clientID,
+                                                 void * userData)
+{
+    lwm2m_client_t * clientP;
+    lwm2m_observation_t * observationP;
+
+    clientP = lwm2m_get_client(contextP, clientID);
+    if (clientP == NULL) return NULL;
+
+    for (observationP = clientP->observationList ; observationP != NULL ; observationP = observationP->next)
+    {
+        if (observationP->userData == userData) break;
+    }
+
+    return observationP;
+}
+
+// lwm2m_observe_cancel() only reports the cancellation of a registered observation
+static bool prv_isCancelReported(lwm2m_context_t * contextP,
+                                 uint32_t clientID,
+                                 lwm2m_uri_t * uriP)
+{
+    lwm2m_client_t * clientP;
+    lwm2m_observation_t * observationP;
+
+    clientP = lwm2m_get_client(contextP, clientID);
+    if (clientP == NULL) return false;
+
+    for (observationP = clientP->observationList ; observationP != NULL ; observationP = observationP->next)
+    {
+        if (observationP->uri.objectId == uriP->objectId
+         && observationP->uri.flag == uriP->flag
+         && observationP->uri.instanceId == uriP->instanceId
+         && observationP->uri.resourceId == uriP->resourceId)
+        {
+            return observationP->status == STATE_REGISTERED;
+        }
+    }
+
+    return false;
+}
+
+// Release the callbacks of the observations removed since the last call: cancelled,
+// failed, replaced by a new observe request or removed with their client
+static void prv_releaseCallbacks(shard_t * shardP)
+{
+    lwm2m_observation_table_t * tableP = &shardP->contextP->observations;
+    shard_callback_t ** nextP;
+
+    // the observations of the shard contexts are only made by shard_observe(), each
+    // one holds a callback
+    if (shardP->callbackCount <= tableP->count) return;
+
+    nextP = &shardP->callbackList;
+    while (*nextP != NULL)
+    {
+        shard_callback_t * callbackP = *nextP;
+
+        if (callbackP->slot < tableP->size
+         && tableP->slots[callbackP->slot].observationP != NULL
+         && tableP->slots[callbackP->slot].observationP->userData == callbackP)
+        {
+            nextP = &callbackP->next;
+        }
+        else
+        {
+            *nextP = callbackP->next;
+            shardP->callbackCount--;
+            free(callbackP);
+        }
+    }
+}
+
+static int prv_operationHandler(lwm2m_context_t * contextP,
+                                void * userData)
+{
+    shard_operation_t * operationP = (shard_operation_t *)userData;
+    shard_t * shardP = (shard_t *)contextP->userData;
+    shard_callback_t * callbackP = NULL;
+    lwm2m_result_callback_t callback = NULL;
+    bool persistent;
+    bool reported = true;
+    int result;
+
+    // an observation is notified until it is removed
+    persistent = (operationP->type == SHARD_OBSERVE);
+
+    if (operationP->callback != NULL)
+    {
+        callbackP = (shard_callback_t *)malloc(sizeof(shard_callback_t));
+        if (callbackP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        callbackP->next = NULL;
+        callbackP->shardP = shardP;
+        callbackP->callback = operationP->callback;
+        callbackP->userData = operationP->userData;
+        callback = persistent ? prv_notifyCallback : prv_resultCallback;
+    }
+
+    switch (operationP->type)
+    {
+    case SHARD_DM_READ:
+        result = lwm2m_dm_read(contextP, operationP->clientID, operationP->uriP, callback, callbackP);
+        break;
+    case SHARD_DM_DISCOVER:
+        result = lwm2m_dm_discover(contextP, operationP->clientID, operationP->uriP, callback, callbackP);
+        break;
+    case SHARD_DM_WRITE:
+        result = lwm2m_dm_write(contextP, operationP->clientID, operationP->uriP, operationP->format, operationP->buffer, operationP->length, callback, callbackP);
+        break;
+    case SHARD_DM_WRITE_ATTRIBUTES:
+        result = lwm2m_dm_write_attributes(contextP, operationP->clientID, operationP->uriP, operationP->attrP, callback, callbackP);
+        break;
+    case SHARD_DM_EXECUTE:
+        result = lwm2m_dm_execute(contextP, operationP->clientID, operationP->uriP, operationP->format, operationP->buffer, operationP->length, callback, callbackP);
+        break;
+    case SHARD_DM_CREATE:
+        result = lwm2m_dm_create(contextP, operationP->clientID, operationP->uriP, operationP->format, operationP->buffer, operationP->length, callback, callbackP);
+        break;
+    case SHARD_DM_DELETE:
+        result = lwm2m_dm_delete(contextP, operationP->clientID, operationP->uriP, callback, callbackP);
+        break;
+    case SHARD_OBSERVE:
+        result = lwm2m_observe(contextP, operationP->clientID, operationP->uriP, callback, callbackP);
+        break;
+    case SHARD_OBSERVE_CANCEL:
+        reported = prv_isCancelReported(contextP, operationP->clientID, operationP->uriP);
+        result = lwm2m_observe_cancel(contextP, operationP->clientID, operationP->uriP, callback, callbackP);
+        break;
+    default:
+        result = COAP_400_BAD_REQUEST;
+        break;
+    }
+
+    if (callbackP != NULL)
+    {
+        if (persistent)
+        {
+            lwm2m_observation_t * observationP;
+
+            // the observation is removed when its request fails before being sent, and
+            // the callback is released with it otherwise
+            observationP = prv_findObservation(contextP, operationP->clientID, callbackP);
+            if (observationP == NULL)
+            {
+                free(callbackP);
+            }
+            else
+            {
+                callbackP->slot = observationP->slot;
+                callbackP->next = shardP->callbackList;
+                shardP->callbackList = callbackP;
+                shardP->callbackCount++;
+            }
+        }
+        else if (result > 0
+              || (result == COAP_NO_ERROR && !reported))
+        {
+            // the request was not sent, the callback will never be called
+            free(callbackP);
+        }
+    }
+
+    return result;
+}
+
+static int prv_runOperation(shard_pool_t * poolP,
+                            uint32_t clientID,
+                            shard_operation_t * operationP)
+{
+    shard_t * shardP;
+
+    shardP = prv_findShard(poolP, clientID, &operationP->clientID);
+    return shard_call(poolP, shardP->index, prv_operationHandler, operationP);
+}
+
+static int prv_setMonitoringHandler(lwm2m_context_t * contextP,
+                                    void * userData)
+{
+    shard_pool_t * poolP = (shard_pool_t *)userData;
+
+    lwm2m_set_monitoring_callback(contextP, poolP->monitorCallback != NULL ? prv_monitorCallback : NULL, contextP->userData);
+    return 0;
+}
+
+static int prv_iterateHandler(lwm2m_context_t * contextP,
+                              void * userData)
+{
+    shard_iterator_t * iteratorP = (shard_iterator_t *)userData;
+    shard_t * shardP = (shard_t *)contextP->userData;
+    lwm2m_client_t * clientP;
+
+    for (clientP = contextP->clientList ; clientP != NULL ; clientP = clientP->next)
+    {
+        iteratorP->callback(prv_globalId(shardP, clientP->internalID), clientP, iteratorP->userData);
+    }
+
+    return 0;
+}
+
+static void prv_wakeUp(shard_t * shardP)
+{
+    pthread_mutex_lock(&shardP->mutex);
+    pthread_cond_signal(&shardP->wakeup);
+    pthread_mutex_unlock(&shardP->mutex);
+}
+
+static bool prv_drainQueue(shard_t * shardP)
+{
+    size_t head;
+    size_t tail;
+    size_t count;
+
+    head = atomic_load_explicit(&shardP->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&shardP->tail, memory_order_acquire);
+    if (head == tail) return false;
+
+    count = tail - head;
+    while (head != tail)
+    {
+        shard_datagram_t * datagramP;
+        connection_t * connP;
+
+        datagramP = shardP->queue + (head & (SHARD_QUEUE_SIZE - 1));
+
+        connP = connection_lookup(&shardP->connTable, &datagramP->addr, datagramP->addrLen);
+        if (connP == NULL)
+        {
+            connP = connection_add_incoming(&shardP->connTable, shardP->poolP->sock, (struct sockaddr *)&datagramP->addr, datagramP->addrLen);
+        }
+        if (connP != NULL)
+        {
+            lwm2m_handle_packet(shardP->contextP, datagramP->buffer, (int)datagramP->length, connP);
+        }
+
+        head++;
+        atomic_store_explicit(&shardP->head, head, memory_order_release);
+    }
+    atomic_fetch_add_explicit(&shardP->handled, count, memory_order_relaxed);
+    // the datagrams may have registered clients or changed their lifetimes
+    shardP->stepNeeded = true;
+
+    return true;
+}
+
+static bool prv_runRequests(shard_t * shardP)
+{
+    shard_request_t * requestList;
+    shard_request_t * requestP;
+
+    pthread_mutex_lock(&shardP->mutex);
+    requestList = shardP->requestList;
+    shardP->requestList = NULL;
+    pthread_mutex_unlock(&shardP->mutex);
+
+    if (requestList == NULL) return false;
+
+    for (requestP = requestList ; requestP != NULL ; requestP = requestP->next)
+    {
+        requestP->result = requestP->function(shardP->contextP, requestP->userData);
+    }
+    // the requests may have created transactions
+    shardP->stepNeeded = true;
+
+    pthread_mutex_lock(&shardP->mutex);
+    while (requestList != NULL)
+    {
+        // the caller releases the request as soon as it is done
+        requestP = requestList;
+        requestList = requestList->next;
+        requestP->done = true;
+    }
+    pthread_cond_broadcast(&shardP->done);
+    pthread_mutex_unlock(&shardP->mutex);
+
+    return true;
+}
+
+static void prv_wait(shard_t * shardP,
+                     int64_t deadline)
+{
+    struct timespec ts;
+
+    ts.tv_sec = deadline / 1000;
+    ts.tv_nsec = (deadline % 1000) * 1000000;
+
+    pthread_mutex_lock(&shardP->mutex);
+    // sequentially consistent with the store of the queue tail in shard_dispatch(): either
+    // the I/O thread sees the worker sleeping, or the worker sees the new datagram
+    atomic_store(&shardP->sleeping, true);
+    if (atomic_load(&shardP->tail) == atomic_load_explicit(&shardP->head, memory_order_relaxed)
+     && shardP->requestList == NULL
+     && !atomic_load(&shardP->poolP->stop))
+    {
+        pthread_cond_timedwait(&shardP->wakeup, &shardP->mutex, &ts);
+    }
+    atomic_store_explicit(&shardP->sleeping, false, memory_order_relaxed);
+    pthread_mutex_unlock(&shardP->mutex);
+}
+
+// Release the connections idle for too long, except those of the registered clients
+static void prv_evictConnections(shard_t * shardP)
+{
+    time_t now = lwm2m_gettime();
+    addr_node_t * nodeP;
+
+    while ((nodeP = addr_table_get_idle(&shardP->connTable, CONNECTION_IDLE_TIMEOUT, now)) != NULL)
+    {
+        connection_t * connP = (connection_t *)nodeP;
+
+        if (lwm2m_get_client_by_session(shardP->contextP, connP) != NULL)
+        {
+            connection_touch(&shardP->connTable, connP);
+        }
+        else
+        {
+            connection_remove(&shardP->connTable, connP);
+        }
+    }
+}
+
+static void * prv_shardThread(void * arg)
+{
+    shard_t * shardP = (shard_t *)arg;
+    int64_t nextStep = 0;
+    int64_t nextEviction = prv_now() + SHARD_EVICT_PERIOD_MS;
+
+    currentShardP = shardP;
+    while (!atomic_load(&shardP->poolP->stop))
+    {
+        int64_t currentTime;
+        bool busy;
+
+        connection_start_batch(&shardP->batch);
+        busy = prv_drainQueue(shardP);
+        busy = prv_runRequests(shardP) || busy;
+
+        currentTime = prv_now();
+        if (shardP->stepNeeded || currentTime >= nextStep)
+        {
+            int64_t timeout = SHARD_MAX_WAIT_MS;
+
+            shardP->stepNeeded = false;
+            (void)lwm2m_step_ms(shardP->contextP, &timeout);
+            nextStep = currentTime + timeout;
+        }
+        prv_releaseCallbacks(shardP);
+        if (currentTime >= nextEviction)
+        {
+            prv_evictConnections(shardP);
+            nextEviction = currentTime + SHARD_EVICT_PERIOD_MS;
+        }
+
+        connection_flush_batch(&shardP->batch);
+        if (!busy)
+        {
+            prv_wait(shardP, nextStep);
+        }
+    }
+
+    // release the threads which called shard_call() during the shutdown
+    prv_runRequests(shardP);
+
+    return NULL;
+}
+
+static bool prv_initShard(shard_pool_t * poolP,
+                          shard_t * shardP,
+                          size_t index)
+{
+    pthread_condattr_t attr;
+
+    shardP->poolP = poolP;
+    shardP->index = index;
+    atomic_init(&shardP->tail, 0);
+    atomic_init(&shardP->head, 0);
+    atomic_init(&shardP->dropped, 0);
+    atomic_init(&shardP->handled, 0);
+    atomic_init(&shardP->sleeping, false);
+
+    pthread_mutex_init(&shardP->mutex, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&shardP->wakeup, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&shardP->done, NULL);
+
+    shardP->queue = (shard_datagram_t *)malloc(SHARD_QUEUE_SIZE * sizeof(shard_datagram_t));
+    if (shardP->queue == NULL) return false;
+
+    shardP->contextP = lwm2m_init(shardP);
+    if (shardP->contextP == NULL) return false;
+
+    if (!addr_table_init(&shardP->connTable)) return false;
+
+    if (0 != pthread_create(&shardP->thread, NULL, prv_shardThread, shardP)) return false;
+    shardP->started = true;
+
+    return true;
+}
+
+static void prv_freeShard(shard_t * shardP)
+{
+    // not initialized by shard_pool_new()
+    if (shardP->poolP == NULL) return;
+
+    if (shardP->started)
+    {
+        prv_wakeUp(shardP);
+        pthread_join(shardP->thread, NULL);
+    }
+    if (shardP->contextP != NULL)
+    {
+        lwm2m_close(shardP->contextP);
+    }
+    connection_free_table(&shardP->connTable);
+    while (shardP->callbackList != NULL)
+    {
+        shard_callback_t * callbackP;
+
+        callbackP = shardP->callbackList;
+        shardP->callbackList = callbackP->next;
+        free(callbackP);
+    }
+    free(shardP->queue);
+    pthread_cond_destroy(&shardP->done);
+    pthread_cond_destroy(&shardP->wakeup);
+    pthread_mutex_destroy(&shardP->mutex);
+}
+
+shard_pool_t * shard_pool_new(int sock,
+                              size_t shardCount)
+{
+    shard_pool_t * poolP;
+    size_t i;
+
+    if (shardCount == 0 || shardCount > SHARD_MAX_COUNT) return NULL;
+
+    poolP = (shard_pool_t *)malloc(sizeof(shard_pool_t));
+    if (poolP == NULL) return NULL;
+    memset(poolP, 0, sizeof(shard_pool_t));
+
+    poolP->count = shardCount;
+    poolP->sock = sock;
+    atomic_init(&poolP->stop, false);
+
+    poolP->shards = (shard_t *)aligned_alloc(SHARD_CACHE_LINE, shardCount * sizeof(shard_t));
+    if (poolP->shards == NULL)
+    {
+        free(poolP);
+        return NULL;
+    }
+    memset(poolP->shards, 0, shardCount * sizeof(shard_t));
+
+    for (i = 0 ; i < shardCount ; i++)
+    {
+        if (!prv_initShard(poolP, poolP->shards + i, i))
+        {
+            // the shards after i were zeroed and are skipped
+            shard_pool_free(poolP);
+            return NULL;
+        }
+    }
+
+    return poolP;
+}
+
+void shard_pool_free(shard_pool_t * poolP)
+{
+    size_t i;
+
+    atomic_store(&poolP->stop, true);
+    for (i = 0 ; i < poolP->count ; i++)
+    {
+        prv_freeShard(poolP->shards + i);
+    }
+
+    free(poolP->shards);
+    free(poolP);
+}
+
+void shard_pool_stats(shard_pool_t * poolP,
+                      shard_stats_t * statsP)
+{
+    size_t i;
+
+    statsP->handled = 0;
+    statsP->dropped = 0;
+    for (i = 0 ; i < poolP->count ; i++)
+    {
+        statsP->handled += atomic_load_explicit(&poolP->shards[i].handled, memory_order_relaxed);
+        statsP->dropped += atomic_load_explicit(&poolP->shards[i].dropped, memory_order_relaxed);
+    }
+}
+
+bool shard_dispatch(shard_pool_t * poolP,
+                    struct sockaddr_storage * addr,
+                    socklen_t addrLen,
+                    uint8_t * buffer,
+                    size_t length)
+{
+    shard_t * shardP;
+    shard_datagram_t * datagramP;
+    size_t tail;
+
+    shardP = poolP->shards + prv_hashAddress(addr, addrLen) % poolP->count;
+
+    tail = atomic_load_explicit(&shardP->tail, memory_order_relaxed);
+    if (tail - shardP->headCache == SHARD_QUEUE_SIZE)
+    {
+        shardP->headCache = atomic_load_explicit(&shardP->head, memory_order_acquire);
+    }
+    if (tail - shardP->headCache == SHARD_QUEUE_SIZE
+     || length > SHARD_DATAGRAM_SIZE
+     || addrLen > sizeof(struct sockaddr_storage))
+    {
+        atomic_fetch_add_explicit(&shardP->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    datagramP = shardP->queue + (tail & (SHARD_QUEUE_SIZE - 1));
+    memcpy(&datagramP->addr, addr, addrLen);
+    datagramP->addrLen = addrLen;
+    memcpy(datagramP->buffer, buffer, length);
+    datagramP->length = length;
+
+    atomic_store(&shardP->tail, tail + 1);
+    if (atomic_load(&shardP->sleeping))
+    {
+        prv_wakeUp(shardP);
+    }
+
+    return true;
+}
+
+int shard_call(shard_pool_t * poolP,
+               size_t index,
+               shard_function_t function,
+               void * userData)
+{
+    shard_t * shardP;
+    shard_request_t request;
+    shard_request_t ** nextP;
+
+    if (index >= poolP->count) return COAP_404_NOT_FOUND;
+    shardP = poolP->shards + index;
+
+    if (currentShardP == shardP)
+    {
+        // called from a callback of this shard
+        shardP->stepNeeded = true;
+        return function(shardP->contextP, userData);
+    }
+    // a worker thread waiting for another one deadlocks when that one calls it back
+    assert(currentShardP == NULL);
+    if (currentShardP != NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    memset(&request, 0, sizeof(request));
+    request.function = function;
+    request.userData = userData;
+
+    pthread_mutex_lock(&shardP->mutex);
+    for (nextP = &shardP->requestList ; *nextP != NULL ; nextP = &(*nextP)->next);
+    *nextP = &request;
+    pthread_cond_signal(&shardP->wakeup);
+    while (!request.done)
+    {
+        pthread_cond_wait(&shardP->done, &shardP->mutex);
+    }
+    pthread_mutex_unlock(&shardP->mutex);
+
+    return request.result;
+}
+
+lwm2m_client_t * shard_get_client(shard_pool_t * poolP,
+                                  uint32_t clientID)
+{
+    shard_t * shardP;
+    uint32_t localId;
+
+    shardP = prv_findShard(poolP, clientID, &localId);
+    if (currentShardP != shardP) return NULL;
+
+    return lwm2m_get_client(shardP->contextP, localId);
+}
+
+void shard_for_each_client(shard_pool_t * poolP,
+                           shard_client_callback_t callback,
+                           void * userData)
+{
+    shard_iterator_t iterator;
+    size_t i;
+
+    // visits the other shards, see shard_call()
+    assert(currentShardP == NULL || poolP->count == 1);
+
+    iterator.callback = callback;
+    iterator.userData = userData;
+    for (i = 0 ; i < poolP->count ; i++)
+    {
+        (void)shard_call(poolP, i, prv_iterateHandler, &iterator);
+    }
+}
+
+void shard_set_monitoring_callback(shard_pool_t * poolP,
+                                   lwm2m_result_callback_t callback,
+                                   void * userData)
+{
+    size_t i;
+
+    // visits the other shards, see shard_call()
+    assert(currentShardP == NULL || poolP->count == 1);
+
+    // published to the worker threads by shard_call()
+    poolP->monitorCallback = callback;
+    poolP->monitorUserData = userData;
+    for (i = 0 ; i < poolP->count ; i++)
+    {
+        (void)shard_call(poolP, i, prv_setMonitoringHandler, poolP);
+    }
+}
+
+int shard_dm_read(shard_pool_t * poolP,
+                  uint32_t clientID,
+                  lwm2m_uri_t * uriP,
+                  lwm2m_result_callback_t callback,
+                  void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_DM_READ;
+    operation.uriP = uriP;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_dm_discover(shard_pool_t * poolP,
+                      uint32_t clientID,
+                      lwm2m_uri_t * uriP,
+                      lwm2m_result_callback_t callback,
+                      void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_DM_DISCOVER;
+    operation.uriP = uriP;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_dm_write(shard_pool_t * poolP,
+                   uint32_t clientID,
+                   lwm2m_uri_t * uriP,
+                   lwm2m_media_type_t format,
+                   uint8_t * buffer,
+                   int length,
+                   lwm2m_result_callback_t callback,
+                   void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_DM_WRITE;
+    operation.uriP = uriP;
+    operation.format = format;
+    operation.buffer = buffer;
+    operation.length = length;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_dm_write_attributes(shard_pool_t * poolP,
+                              uint32_t clientID,
+                              lwm2m_uri_t * uriP,
+                              lwm2m_attributes_t * attrP,
+                              lwm2m_result_callback_t callback,
+                              void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_DM_WRITE_ATTRIBUTES;
+    operation.uriP = uriP;
+    operation.attrP = attrP;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_dm_execute(shard_pool_t * poolP,
+                     uint32_t clientID,
+                     lwm2m_uri_t * uriP,
+                     lwm2m_media_type_t format,
+                     uint8_t * buffer,
+                     int length,
+                     lwm2m_result_callback_t callback,
+                     void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_DM_EXECUTE;
+    operation.uriP = uriP;
+    operation.format = format;
+    operation.buffer = buffer;
+    operation.length = length;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_dm_create(shard_pool_t * poolP,
+                    uint32_t clientID,
+                    lwm2m_uri_t * uriP,
+                    lwm2m_media_type_t format,
+                    uint8_t * buffer,
+                    int length,
+                    lwm2m_result_callback_t callback,
+                    void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_DM_CREATE;
+    operation.uriP = uriP;
+    operation.format = format;
+    operation.buffer = buffer;
+    operation.length = length;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_dm_delete(shard_pool_t * poolP,
+                    uint32_t clientID,
+                    lwm2m_uri_t * uriP,
+                    lwm2m_result_callback_t callback,
+                    void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_DM_DELETE;
+    operation.uriP = uriP;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_observe(shard_pool_t * poolP,
+                  uint32_t clientID,
+                  lwm2m_uri_t * uriP,
+                  lwm2m_result_callback_t callback,
+                  void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_OBSERVE;
+    operation.uriP = uriP;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
+
+int shard_observe_cancel(shard_pool_t * poolP,
+                         uint32_t clientID,
+                         lwm2m_uri_t * uriP,
+                         lwm2m_result_callback_t callback,
+                         void * userData)
+{
+    shard_operation_t operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.type = SHARD_OBSERVE_CANCEL;
+    operation.uriP = uriP;
+    operation.callback = callback;
+    operation.userData = userData;
+
+    return prv_runOperation(poolP, clientID, &operation);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file shard.h
+ *
+ * Multi-threaded LWM2M server runtime.
+ *
+ * The clients are partitioned over a pool of worker threads, the shards, by hashing their
+ * address. Each shard owns an lwm2m_context_t, its connection list and its timers, so the
+ * LWM2M engine is never shared between threads:
+ *  - the I/O thread reads the datagrams and hands them to shard_dispatch(), which queues
+ *    them to the owning shard through a single-producer single-consumer ring;
+ *  - the other threads reach a context through shard_call() or the shard_dm_*() functions,
+ *    which run on the owning worker thread and wait for its result.
+ *
+ * A client is identified by (local ID * shard count + shard index), where the local ID is
+ * the one allocated by its shard context. The IDs given to the callbacks are translated
+ * the same way. With N shards, a shard can thus hold up to UINT32_MAX / N clients.
+ *
+ * The callbacks run on the worker thread owning the client. They may only use the shard_*()
+ * functions on their own shard, as a worker thread waiting for another one could deadlock
+ * with it: shard_call() fails with COAP_500_INTERNAL_SERVER_ERROR on another shard, and so do
+ * the shard_dm_*() and shard_observe*() functions on the clients of another shard, for which
+ * shard_get_client() returns NULL. As they reach every shard, shard_for_each_client() and
+ * shard_set_monitoring_callback() must not be called from a callback of a pool of several
+ * shards.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include "connection.h"
+
+// Number of datagrams a shard queue can hold, must be a power of two
+#ifndef SHARD_QUEUE_SIZE
+#define SHARD_QUEUE_SIZE 1024
+#endif
+
+// Largest datagram accepted by shard_dispatch()
+#ifndef SHARD_DATAGRAM_SIZE
+#define SHARD_DATAGRAM_SIZE 1024
+#endif
+
+#define SHARD_MAX_COUNT 64
+
+typedef struct _shard_pool_ shard_pool_t;
+
+typedef struct
+{
+    uint64_t handled;   // datagrams given to lwm2m_handle_packet()
+    uint64_t dropped;   // datagrams rejected by shard_dispatch()
+} shard_stats_t;
+
+// Function run on a worker thread by shard_call()
+typedef int (*shard_function_t)(lwm2m_context_t * contextP, void * userData);
+// Called for each client by shard_for_each_client()
+typedef void (*shard_client_callback_t)(uint32_t clientID, lwm2m_client_t * clientP, void * userData);
+
+// Start shardCount worker threads answering on the UDP socket sock
+shard_pool_t * shard_pool_new(int sock, size_t shardCount);
+// Stop the worker threads and release their contexts and connections
+void shard_pool_free(shard_pool_t * poolP);
+void shard_pool_stats(shard_pool_t * poolP, shard_stats_t * statsP);
+
+// Queue a datagram received from addr to the shard owning this address.
+// Must always be called from the same thread. Returns false when the datagram is dropped.
+bool shard_dispatch(shard_pool_t * poolP, struct sockaddr_storage * addr, socklen_t addrLen, uint8_t * buffer, size_t length);
+
+// Run function on the context of the shard at index and return its result.
+// From a worker thread, index must be the one of its own shard.
+int shard_call(shard_pool_t * poolP, size_t index, shard_function_t function, void * userData);
+
+// Only valid on the worker thread owning the client, returns NULL otherwise
+lwm2m_client_t * shard_get_client(shard_pool_t * poolP, uint32_t clientID);
+void shard_for_each_client(shard_pool_t * poolP, shard_client_callback_t callback, void * userData);
+
+// Same as the liblwm2m functions with the client IDs of the pool
+void shard_set_monitoring_callback(shard_pool_t * poolP, lwm2m_result_callback_t callback, void * userData);
+int shard_dm_read(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int shard_dm_discover(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int shard_dm_write(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int shard_dm_write_attributes(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_attributes_t * attrP, lwm2m_result_callback_t callback, void * userData);
+int shard_dm_execute(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int shard_dm_create(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int shard_dm_delete(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int shard_observe(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int shard_observe_cancel(shard_pool_t * poolP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+
+#endif /* SHARD_H_ */
@@ -13,6 +13,7 @@ if(DTLS)
     set(SHARED_SOURCES
 	    ${SHARED_SOURCES}
 		${TINYDTLS_SOURCES}
+		${SHARED_SOURCES_DIR}/addrtable.c
 		${SHARED_SOURCES_DIR}/dtlsconnection.c)
     
 	set(SHARED_INCLUDE_DIRS
@@ -23,9 +24,13 @@ if(DTLS)
 else()
     set(SHARED_SOURCES
 		${SHARED_SOURCES} 
+		${SHARED_SOURCES_DIR}/addrtable.c
 		${SHARED_SOURCES_DIR}/connection.c)
 
     set(SHARED_INCLUDE_DIRS ${SHARED_SOURCES_DIR})
+
+    # recvmmsg() and sendmmsg()
+    set(SHARED_DEFINITIONS -D_GNU_SOURCE)
 endif()
 
 
@@ -0,0 +1,30 @@
+/**
+ * @file bench.c
+ *
+ * Measurement and report functions shared by the benchmark programs.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <time.h>
+
+uint64_t bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void bench_report(const char * name,
+                  size_t workload,
+                  uint64_t elapsedNs,
+                  size_t operations)
+{
+    printf("%-40s %10zu %12.1f ns/op\r\n", name, workload,
+           operations ? (double)elapsedNs / (double)operations : 0.0);
+}
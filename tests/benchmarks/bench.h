@@ -0,0 +1,38 @@
+/**
+ * @file bench.h
+ *
+ * Micro-benchmarks of the LWM2M engine
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct BenchTable {
+    const char* name;
+    void (*function)(void);
+};
+
+// Monotonic time in nanoseconds
+uint64_t bench_now(void);
+
+// Print one result line: average cost of one operation for a given workload size
+void bench_report(const char * name, size_t workload, uint64_t elapsedNs, size_t operations);
+
+// Platform hooks shared by all benchmarks
+extern size_t bench_sentCount;
+
+void bench_coap(void);
+void bench_json(void);
+void bench_notify(void);
+void bench_registration(void);
+void bench_send(void);
+void bench_tlv(void);
+void bench_transaction(void);
+
+#endif /* BENCH_H_ */
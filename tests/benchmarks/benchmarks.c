@@ -0,0 +1,91 @@
+/**
+ * @file benchmarks.c
+ *
+ * Entry point and platform stubs of the LWM2M engine micro-benchmarks.
+ *
+ * Run without argument to execute all benchmarks, or with the names of the
+ * benchmarks to run.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "liblwm2m.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+size_t bench_sentCount = 0;
+
+static struct BenchTable table[] = {
+        { "coap", bench_coap },
+        { "json", bench_json },
+        { "notify", bench_notify },
+        { "registration", bench_registration },
+        { "send", bench_send },
+        { "tlv", bench_tlv },
+        { "transaction", bench_transaction },
+        { NULL, NULL },
+};
+
+uint8_t lwm2m_buffer_send(void * sessionH,
+                          uint8_t * buffer,
+                          size_t length,
+                          void * userData,
+                          bool firstBlock)
+{
+    (void)sessionH;
+    (void)buffer;
+    (void)length;
+    (void)userData;
+    (void)firstBlock;
+
+    bench_sentCount++;
+    return COAP_NO_ERROR;
+}
+
+uint8_t lwm2m_buffer_sendv(void * sessionH,
+                           const lwm2m_iovec_t * vector,
+                           size_t count,
+                           void * userData,
+                           bool firstBlock)
+{
+    (void)sessionH;
+    (void)vector;
+    (void)count;
+    (void)userData;
+    (void)firstBlock;
+
+    bench_sentCount++;
+    return COAP_NO_ERROR;
+}
+
+bool lwm2m_session_is_equal(void * session1,
+                            void * session2,
+                            void * userData)
+{
+    (void)userData;
+
+    return (session1 == session2);
+}
+
+int main(int argc, char * argv[])
+{
+    int index;
+    int i;
+
+    printf("%-40s %10s %15s\r\n", "benchmark", "workload", "cost");
+    for (index = 0 ; NULL != table[index].name ; index++)
+    {
+        bool selected = (argc < 2);
+
+        for (i = 1 ; i < argc && !selected ; i++)
+        {
+            selected = (0 == strcmp(argv[i], table[index].name));
+        }
+        if (selected) table[index].function();
+    }
+
+    return 0;
+}
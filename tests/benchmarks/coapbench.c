@@ -0,0 +1,85 @@
+/**
+ * @file coapbench.c
+ *
+ * Cost of parsing incoming CoAP messages. The workload is the datagram size.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+#include "bench.h"
+
+#define BENCH_PARSE_COUNT   1000000
+
+// Captured datagrams
+static uint8_t RegisterPacket[] = {
+    0x44, 0x02, 0x1A, 0x2B, 0x5E, 0x13, 0x9C, 0x01, 0xB2, 0x72, 0x64, 0x11,
+    0x28, 0x3D, 0x0E, 0x65, 0x70, 0x3D, 0x75, 0x72, 0x6E, 0x3A, 0x69, 0x6D,
+    0x65, 0x69, 0x3A, 0x30, 0x30, 0x34, 0x34, 0x30, 0x32, 0x39, 0x39, 0x30,
+    0x30, 0x32, 0x30, 0x34, 0x33, 0x34, 0x08, 0x6C, 0x74, 0x3D, 0x38, 0x36,
+    0x34, 0x30, 0x30, 0x09, 0x6C, 0x77, 0x6D, 0x32, 0x6D, 0x3D, 0x31, 0x2E,
+    0x30, 0x03, 0x62, 0x3D, 0x55, 0xFF, 0x3C, 0x2F, 0x3E, 0x3B, 0x72, 0x74,
+    0x3D, 0x22, 0x6F, 0x6D, 0x61, 0x2E, 0x6C, 0x77, 0x6D, 0x32, 0x6D, 0x22,
+    0x2C, 0x3C, 0x2F, 0x31, 0x2F, 0x30, 0x3E, 0x2C, 0x3C, 0x2F, 0x33, 0x2F,
+    0x30, 0x3E, 0x2C, 0x3C, 0x2F, 0x34, 0x2F, 0x30, 0x3E, 0x2C, 0x3C, 0x2F,
+    0x35, 0x2F, 0x30, 0x3E, 0x2C, 0x3C, 0x2F, 0x36, 0x2F, 0x30, 0x3E, 0x2C,
+    0x3C, 0x2F, 0x31, 0x30, 0x32, 0x34, 0x33, 0x2F, 0x30, 0x3E,
+};
+
+static uint8_t ReadPacket[] = {
+    0x44, 0x01, 0x4C, 0x1D, 0x8F, 0x02, 0x61, 0x7A, 0xB1, 0x33, 0x01, 0x30,
+    0x02, 0x31, 0x33, 0x62, 0x2D, 0x16,
+};
+
+static uint8_t NotifyPacket[] = {
+    0x54, 0x45, 0x7E, 0x02, 0x21, 0x9A, 0x44, 0x07, 0x62, 0x00, 0x12, 0x62,
+    0x2D, 0x16, 0xFF, 0xC8, 0x0D, 0x04, 0x5A, 0x1B, 0x2C, 0x3D,
+};
+
+static void prv_runParse(const char * name,
+                         uint8_t * buffer,
+                         size_t length)
+{
+    coap_packet_t message[1];
+    uint64_t start;
+    uint64_t elapsed;
+    size_t i;
+
+    start = bench_now();
+    for (i = 0 ; i < BENCH_PARSE_COUNT ; i++)
+    {
+        if (NO_ERROR != coap_parse_message(message, buffer, (uint16_t)length)) return;
+        coap_free_header(message);
+    }
+    elapsed = bench_now() - start;
+
+    bench_report(name, length, elapsed, BENCH_PARSE_COUNT);
+}
+
+static void prv_runBuiltParse(const char * name,
+                              const char * path,
+                              const char * query)
+{
+    coap_packet_t request[1];
+    uint8_t buffer[COAP_MAX_PACKET_SIZE];
+    size_t length;
+
+    coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0x1234);
+    coap_set_header_token(request, (const uint8_t *)"\x01\x02\x03\x04", 4);
+    coap_set_header_uri_path(request, path);
+    if (NULL != query) coap_set_header_uri_query(request, query);
+    length = coap_serialize_message(request, buffer);
+    coap_free_header(request);
+
+    prv_runParse(name, buffer, length);
+}
+
+void bench_coap(void)
+{
+    prv_runParse("coap: parse Register", RegisterPacket, sizeof(RegisterPacket));
+    prv_runParse("coap: parse Read", ReadPacket, sizeof(ReadPacket));
+    prv_runParse("coap: parse Notify", NotifyPacket, sizeof(NotifyPacket));
+    prv_runBuiltParse("coap: parse Update", "/rd/5a3f", NULL);
+    prv_runBuiltParse("coap: parse long Uri-Path", "/rd/a/b/c/d/e/f/g/h/i/j", "ep=test");
+}
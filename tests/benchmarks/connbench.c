@@ -0,0 +1,110 @@
+/**
+ * @file connbench.c
+ *
+ * Peer lookup in the connections of the examples: linear scan of a connection list by
+ * connection_find() against the address table of connection_lookup(), for 10k to 1M peers,
+ * and release of idle connections by connection_evict().
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "connection.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The list scans are repeated until about this many addresses are compared
+#define BENCH_SCAN_COMPARISONS  100000000
+#define BENCH_LOOKUP_COUNT      1000000
+
+static void prv_setAddress(struct sockaddr_storage * addrP,
+                           size_t index)
+{
+    struct sockaddr_in * saddr = (struct sockaddr_in *)addrP;
+
+    memset(addrP, 0, sizeof(struct sockaddr_storage));
+    saddr->sin_family = AF_INET;
+    saddr->sin_port = htons(LWM2M_STANDARD_PORT);
+    saddr->sin_addr.s_addr = htonl(0x0A000000 + index);
+}
+
+// Pseudo-random peer, so the table buckets are not visited in order
+static size_t prv_peer(size_t i,
+                       size_t peerCount)
+{
+    return (i * 2654435761u) % peerCount;
+}
+
+static void prv_runPeers(size_t peerCount)
+{
+    struct sockaddr_storage addr;
+    connection_t * connList = NULL;
+    addr_table_t table;
+    uint64_t start;
+    size_t operations;
+    size_t found;
+    size_t i;
+
+    if (!addr_table_init(&table)) return;
+
+    start = bench_now();
+    for (i = 0 ; i < peerCount ; i++)
+    {
+        prv_setAddress(&addr, i);
+        (void)connection_add_incoming(&table, -1, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
+    }
+    bench_report("conn: table insert", peerCount, bench_now() - start, peerCount);
+
+    for (i = 0 ; i < peerCount ; i++)
+    {
+        connection_t * connP;
+
+        prv_setAddress(&addr, i);
+        connP = connection_new_incoming(connList, -1, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
+        if (connP != NULL) connList = connP;
+    }
+
+    found = 0;
+    start = bench_now();
+    for (i = 0 ; i < BENCH_LOOKUP_COUNT ; i++)
+    {
+        prv_setAddress(&addr, prv_peer(i, peerCount));
+        if (connection_lookup(&table, &addr, sizeof(struct sockaddr_in)) != NULL) found++;
+    }
+    bench_report("conn: table lookup", peerCount, bench_now() - start, BENCH_LOOKUP_COUNT);
+
+    operations = BENCH_SCAN_COMPARISONS / peerCount;
+    start = bench_now();
+    for (i = 0 ; i < operations ; i++)
+    {
+        prv_setAddress(&addr, prv_peer(i, peerCount));
+        if (connection_find(connList, &addr, sizeof(struct sockaddr_in)) != NULL) found++;
+    }
+    bench_report("conn: list scan", peerCount, bench_now() - start, operations);
+
+    if (found != BENCH_LOOKUP_COUNT + operations)
+    {
+        fprintf(stderr, "%zu peers not found\r\n", BENCH_LOOKUP_COUNT + operations - found);
+    }
+
+    // every connection is idle for a negative timeout
+    start = bench_now();
+    operations = connection_evict(&table, -1);
+    bench_report("conn: evict", peerCount, bench_now() - start, operations);
+
+    connection_free_table(&table);
+    connection_free(connList);
+}
+
+int main(void)
+{
+    printf("%-40s %10s %15s\r\n", "benchmark", "peers", "cost");
+    prv_runPeers(10000);
+    prv_runPeers(100000);
+    prv_runPeers(1000000);
+
+    return 0;
+}
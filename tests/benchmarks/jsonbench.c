@@ -0,0 +1,111 @@
+/**
+ * @file jsonbench.c
+ *
+ * Cost of serializing the JSON Read of an object, for a growing number of resources
+ * spread over instances of ten resources. The smallest workload is a single instance,
+ * the common case of a Read or an Observe, which fits in the initial output buffer.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Resources serialized per measure, whatever the size of the payload
+#define BENCH_RESOURCE_COUNT    2000000
+// Resources of each object instance
+#define BENCH_INSTANCE_WIDTH    10
+
+// Build an object of resourceCount / BENCH_INSTANCE_WIDTH instances of mixed resources
+static lwm2m_data_t * prv_buildObject(size_t resourceCount,
+                                      int * sizeP)
+{
+    lwm2m_data_t * instanceP;
+    size_t instanceCount = resourceCount / BENCH_INSTANCE_WIDTH;
+    size_t i;
+    size_t j;
+
+    instanceP = lwm2m_data_new((int)instanceCount);
+    if (instanceP == NULL) return NULL;
+    *sizeP = (int)instanceCount;
+
+    for (i = 0 ; i < instanceCount ; i++)
+    {
+        lwm2m_data_t * resourceP;
+
+        resourceP = lwm2m_data_new(BENCH_INSTANCE_WIDTH);
+        if (resourceP == NULL) break;
+
+        for (j = 0 ; j < BENCH_INSTANCE_WIDTH ; j++)
+        {
+            resourceP[j].id = (uint16_t)j;
+            switch (j % 3)
+            {
+            case 0:
+                lwm2m_data_encode_string("Lightweight M2M Client", resourceP + j);
+                break;
+            case 1:
+                lwm2m_data_encode_int((int64_t)(i * BENCH_INSTANCE_WIDTH + j) * 1000, resourceP + j);
+                break;
+            default:
+                lwm2m_data_encode_float((double)j / 4, resourceP + j);
+                break;
+            }
+        }
+        instanceP[i].id = (uint16_t)i;
+        lwm2m_data_include(resourceP, BENCH_INSTANCE_WIDTH, instanceP + i);
+    }
+    if (i != instanceCount)
+    {
+        lwm2m_data_free(*sizeP, instanceP);
+        return NULL;
+    }
+
+    return instanceP;
+}
+
+static void prv_runSerialize(size_t resourceCount)
+{
+    lwm2m_data_t * dataP;
+    lwm2m_uri_t uri;
+    size_t iterations = BENCH_RESOURCE_COUNT / resourceCount;
+    size_t failed = 0;
+    uint64_t start;
+    int size;
+    size_t i;
+
+    dataP = prv_buildObject(resourceCount, &size);
+    if (dataP == NULL) return;
+
+    memset(&uri, 0, sizeof(uri));
+    uri.objectId = 1024;
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID;
+
+    start = bench_now();
+    for (i = 0 ; i < iterations ; i++)
+    {
+        uint8_t * buffer;
+
+        if (json_serialize(&uri, size, dataP, &buffer) <= 0) failed++;
+        else lwm2m_free(buffer);
+    }
+    bench_report("json: serialize", resourceCount, bench_now() - start, iterations);
+
+    if (failed != 0)
+    {
+        fprintf(stderr, "%zu serializations failed\r\n", failed);
+    }
+
+    lwm2m_data_free(size, dataP);
+}
+
+void bench_json(void)
+{
+    prv_runSerialize(10);
+    prv_runSerialize(100);
+    prv_runSerialize(1000);
+}
@@ -0,0 +1,170 @@
+/**
+ * @file notifybench.c
+ *
+ * Cost of routing the notifications received by a server to the callback of their
+ * observation, for a growing number of observations spread over few or many clients.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define BENCH_MAX_OBSERVATIONS  100000
+#define BENCH_NOTIFY_COUNT      1000000
+
+typedef struct
+{
+    uint8_t token[COAP_TOKEN_LEN];
+    uint8_t tokenLen;
+} bench_token_t;
+
+static int Sessions[BENCH_MAX_OBSERVATIONS];
+static bench_token_t Tokens[BENCH_MAX_OBSERVATIONS];
+static size_t NotifyCount;
+
+static void prv_notifyCallback(uint32_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    (void)clientID;
+    (void)uriP;
+    (void)status;
+    (void)format;
+    (void)data;
+    (void)dataLength;
+    (void)userData;
+
+    NotifyCount++;
+}
+
+static size_t prv_buildNotify(uint8_t * buffer,
+                              coap_message_type_t type,
+                              uint16_t mID,
+                              const bench_token_t * tokenP,
+                              uint32_t count)
+{
+    coap_packet_t message[1];
+
+    coap_init_message(message, type, COAP_205_CONTENT, mID);
+    coap_set_header_token(message, tokenP->token, tokenP->tokenLen);
+    coap_set_header_observe(message, count);
+    coap_set_header_content_type(message, LWM2M_CONTENT_TEXT);
+    coap_set_payload(message, "42", 2);
+
+    return coap_serialize_message(message, buffer);
+}
+
+// Register the clients and observe a different instance of each for every observation
+static bool prv_observeAll(lwm2m_context_t * contextP,
+                           size_t clientCount,
+                           size_t perClient)
+{
+    coap_packet_t message[1];
+    uint8_t buffer[128];
+    char query[64];
+    lwm2m_uri_t uri;
+    size_t length;
+    size_t i;
+    size_t j;
+
+    for (i = 0 ; i < clientCount ; i++)
+    {
+        snprintf(query, sizeof(query), "?lwm2m=1.0&ep=bench%zu&lt=300", i);
+        coap_init_message(message, COAP_TYPE_CON, COAP_POST, contextP->nextMID++);
+        coap_set_header_uri_path(message, "/rd");
+        coap_set_header_uri_query(message, query);
+        coap_set_payload(message, "</3/0>", 6);
+        length = coap_serialize_message(message, buffer);
+        lwm2m_handle_packet(contextP, buffer, length, &Sessions[i]);
+    }
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID;
+    uri.objectId = 3;
+    for (j = 0 ; j < perClient ; j++)
+    {
+        uri.instanceId = (uint16_t)j;
+        for (i = 0 ; i < clientCount ; i++)
+        {
+            lwm2m_transaction_t * transacP;
+            coap_packet_t * requestP;
+            bench_token_t * tokenP = Tokens + j * clientCount + i;
+
+            // the IDs are allocated in order from 0, client i has ID i
+            if (COAP_NO_ERROR != lwm2m_observe(contextP, (uint32_t)i, &uri, prv_notifyCallback, NULL)) return false;
+
+            // the observe request is the last transaction, its token is the one of the notifications
+            transacP = contextP->transactionList->prev;
+            requestP = (coap_packet_t *)transacP->message;
+            memcpy(tokenP->token, requestP->token, requestP->token_len);
+            tokenP->tokenLen = requestP->token_len;
+
+            // the client accepts the observation
+            length = prv_buildNotify(buffer, COAP_TYPE_ACK, transacP->mID, tokenP, 0);
+            lwm2m_handle_packet(contextP, buffer, length, &Sessions[i]);
+        }
+    }
+
+    return NULL == contextP->transactionList;
+}
+
+static void prv_run(size_t clientCount,
+                    size_t perClient)
+{
+    lwm2m_context_t * contextP;
+    uint8_t buffer[128];
+    char name[64];
+    size_t observationCount = clientCount * perClient;
+    uint32_t seed = 12345;
+    uint64_t start;
+    size_t length;
+    size_t i;
+
+    contextP = lwm2m_init(NULL);
+    if (NULL == contextP) return;
+
+    NotifyCount = 0;
+    if (!prv_observeAll(contextP, clientCount, perClient))
+    {
+        fprintf(stderr, "observation of %zu instances on %zu clients failed\r\n", perClient, clientCount);
+        lwm2m_close(contextP);
+        return;
+    }
+    NotifyCount = 0;
+
+    start = bench_now();
+    for (i = 0 ; i < BENCH_NOTIFY_COUNT ; i++)
+    {
+        size_t index;
+
+        seed = seed * 1103515245 + 12345;
+        index = (seed >> 8) % observationCount;
+        length = prv_buildNotify(buffer, COAP_TYPE_NON, contextP->nextMID++, Tokens + index, (uint32_t)i + 1);
+        lwm2m_handle_packet(contextP, buffer, length, &Sessions[index % clientCount]);
+    }
+    snprintf(name, sizeof(name), "notify: %zu per client", perClient);
+    bench_report(name, observationCount, bench_now() - start, BENCH_NOTIFY_COUNT);
+
+    if (NotifyCount != BENCH_NOTIFY_COUNT)
+    {
+        fprintf(stderr, "%zu notifications not routed\r\n", BENCH_NOTIFY_COUNT - NotifyCount);
+    }
+
+    lwm2m_close(contextP);
+}
+
+void bench_notify(void)
+{
+    prv_run(1000, 1);
+    prv_run(100000, 1);
+    prv_run(1000, 10);
+    prv_run(100, 1000);
+}
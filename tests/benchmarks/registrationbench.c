@@ -0,0 +1,168 @@
+/**
+ * @file registrationbench.c
+ *
+ * Cost of resolving the client of a Register, an Update or a session handle, and of
+ * checking the lifetimes when no client expires, for a growing number of registered clients.
+ * Cost of decoding the object list of a Register, and of an Update carrying the same list
+ * again, for a growing number of instances.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define BENCH_MAX_CLIENTS   1000000
+#define BENCH_REQUEST_COUNT 100000
+#define BENCH_STEP_COUNT    100000
+#define BENCH_PAYLOAD_COUNT 20000
+// Objects of the Register payloads, the instances are spread over them
+#define BENCH_OBJECT_COUNT  30
+
+static int Sessions[BENCH_MAX_CLIENTS];
+
+static size_t prv_buildRequest(uint8_t * buffer,
+                               uint16_t mID,
+                               const char * path,
+                               const char * query)
+{
+    coap_packet_t message[1];
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, mID);
+    coap_set_header_uri_path(message, path);
+    if (query != NULL)
+    {
+        coap_set_header_uri_query(message, query);
+        coap_set_payload(message, "</1/0>,</3/0>,</5/0>", 20);
+    }
+
+    return coap_serialize_message(message, buffer);
+}
+
+static void prv_run(size_t clientCount)
+{
+    lwm2m_context_t * contextP;
+    uint8_t buffer[128];
+    char query[64];
+    char path[16];
+    uint32_t seed = 12345;
+    int64_t currentTime;
+    uint64_t start;
+    size_t length;
+    size_t found;
+    size_t i;
+
+    contextP = lwm2m_init(NULL);
+    if (NULL == contextP) return;
+
+    start = bench_now();
+    for (i = 0 ; i < clientCount ; i++)
+    {
+        snprintf(query, sizeof(query), "?lwm2m=1.0&ep=bench%zu&lt=300", i);
+        length = prv_buildRequest(buffer, contextP->nextMID++, "/rd", query);
+        lwm2m_handle_packet(contextP, buffer, length, &Sessions[i]);
+    }
+    bench_report("registration: register", clientCount, bench_now() - start, clientCount);
+
+    // the IDs are allocated in order from 0, client i has ID i
+    start = bench_now();
+    for (i = 0 ; i < BENCH_REQUEST_COUNT ; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        snprintf(path, sizeof(path), "/rd/%u", (unsigned int)((seed >> 8) % clientCount));
+        length = prv_buildRequest(buffer, contextP->nextMID++, path, NULL);
+        lwm2m_handle_packet(contextP, buffer, length, &Sessions[(seed >> 8) % clientCount]);
+    }
+    bench_report("registration: update", clientCount, bench_now() - start, BENCH_REQUEST_COUNT);
+
+    found = 0;
+    start = bench_now();
+    for (i = 0 ; i < BENCH_REQUEST_COUNT ; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        if (NULL != lwm2m_get_client_by_session(contextP, &Sessions[(seed >> 8) % clientCount])) found++;
+    }
+    bench_report("registration: session lookup", clientCount, bench_now() - start, BENCH_REQUEST_COUNT);
+
+    // no client expires yet: the step only has to find the next deadline
+    currentTime = utils_gettimeMs();
+    start = bench_now();
+    for (i = 0 ; i < BENCH_STEP_COUNT ; i++)
+    {
+        int64_t timeout = 60000;
+
+        registration_step(contextP, currentTime, &timeout);
+    }
+    bench_report("registration: idle step", clientCount, bench_now() - start, BENCH_STEP_COUNT);
+
+    if (found != BENCH_REQUEST_COUNT || contextP->clientById.count != clientCount)
+    {
+        fprintf(stderr, "%zu clients registered, %zu sessions not found\r\n",
+                contextP->clientById.count, BENCH_REQUEST_COUNT - found);
+    }
+
+    lwm2m_close(contextP);
+}
+
+static void prv_runObjectList(size_t instanceCount)
+{
+    lwm2m_context_t * contextP;
+    coap_packet_t message[1];
+    uint8_t buffer[4096];
+    char payload[3072];
+    size_t payloadLength;
+    uint64_t start;
+    size_t length;
+    size_t i;
+
+    contextP = lwm2m_init(NULL);
+    if (NULL == contextP) return;
+
+    payloadLength = 0;
+    for (i = 0 ; i < instanceCount ; i++)
+    {
+        payloadLength += snprintf(payload + payloadLength, sizeof(payload) - payloadLength, "%s</%zu/%zu>",
+                                  i == 0 ? "" : ",", 3 + i % BENCH_OBJECT_COUNT, i / BENCH_OBJECT_COUNT);
+    }
+
+    // the same endpoint registers again, its object list is decoded and replaced each time
+    start = bench_now();
+    for (i = 0 ; i < BENCH_PAYLOAD_COUNT ; i++)
+    {
+        coap_init_message(message, COAP_TYPE_CON, COAP_POST, contextP->nextMID++);
+        coap_set_header_uri_path(message, "/rd");
+        coap_set_header_uri_query(message, "?lwm2m=1.0&ep=bench&lt=300");
+        coap_set_payload(message, payload, payloadLength);
+        length = coap_serialize_message(message, buffer);
+        lwm2m_handle_packet(contextP, buffer, length, &Sessions[0]);
+    }
+    bench_report("registration: object list", instanceCount, bench_now() - start, BENCH_PAYLOAD_COUNT);
+
+    // the client sends its unchanged object list in each Update
+    start = bench_now();
+    for (i = 0 ; i < BENCH_PAYLOAD_COUNT ; i++)
+    {
+        coap_init_message(message, COAP_TYPE_CON, COAP_POST, contextP->nextMID++);
+        coap_set_header_uri_path(message, "/rd/0");
+        coap_set_payload(message, payload, payloadLength);
+        length = coap_serialize_message(message, buffer);
+        lwm2m_handle_packet(contextP, buffer, length, &Sessions[0]);
+    }
+    bench_report("registration: same object list", instanceCount, bench_now() - start, BENCH_PAYLOAD_COUNT);
+
+    lwm2m_close(contextP);
+}
+
+void bench_registration(void)
+{
+    prv_runObjectList(BENCH_OBJECT_COUNT);
+    prv_runObjectList(200);
+    prv_run(100);
+    prv_run(1000);
+    prv_run(10000);
+    prv_run(100000);
+    prv_run(BENCH_MAX_CLIENTS);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file sendbench.c
+ *
+ * Cost of serializing and sending a message, for a given payload size.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+#include "bench.h"
+
+#define BENCH_SEND_COUNT    1000000
+
+static uint8_t Payload[REST_MAX_CHUNK_SIZE];
+
+static void prv_runResponse(lwm2m_context_t * contextP,
+                            size_t payloadLen)
+{
+    coap_packet_t response[1];
+    uint64_t start;
+    uint64_t elapsed;
+    size_t i;
+
+    start = bench_now();
+    for (i = 0 ; i < BENCH_SEND_COUNT ; i++)
+    {
+        coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, (uint16_t)i);
+        coap_set_header_token(response, (const uint8_t *)"\x01\x02\x03\x04", 4);
+        coap_set_header_content_type(response, LWM2M_CONTENT_TLV);
+        coap_set_payload(response, Payload, payloadLen);
+        if (COAP_NO_ERROR != message_send(contextP, response, contextP)) return;
+    }
+    elapsed = bench_now() - start;
+
+    bench_report("send: response", payloadLen, elapsed, BENCH_SEND_COUNT);
+}
+
+static void prv_runRequest(lwm2m_context_t * contextP,
+                           size_t payloadLen)
+{
+    lwm2m_transaction_t * transacP;
+    lwm2m_uri_t uri;
+    uint64_t elapsed = 0;
+    size_t i;
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = 3;
+    uri.instanceId = 0;
+    uri.resourceId = 13;
+
+    for (i = 0 ; i < BENCH_SEND_COUNT / 10 ; i++)
+    {
+        uint64_t start;
+
+        transacP = transaction_new(contextP, COAP_PUT, NULL, &uri, contextP->nextMID++, 4, NULL);
+        if (NULL == transacP) return;
+        coap_set_header_content_type(transacP->message, LWM2M_CONTENT_TLV);
+        coap_set_payload(transacP->message, Payload, payloadLen);
+
+        start = bench_now();
+        if (0 != transaction_send(contextP, transacP)) return;
+        elapsed += bench_now() - start;
+
+        transaction_remove(contextP, transacP);
+    }
+
+    bench_report("send: confirmable request", payloadLen, elapsed, BENCH_SEND_COUNT / 10);
+}
+
+void bench_send(void)
+{
+    lwm2m_context_t * contextP;
+
+    contextP = lwm2m_init(NULL);
+    if (NULL == contextP) return;
+
+    memset(Payload, 0x5A, sizeof(Payload));
+
+    prv_runResponse(contextP, 0);
+    prv_runResponse(contextP, 64);
+    prv_runResponse(contextP, 512);
+    prv_runResponse(contextP, 1024);
+
+    prv_runRequest(contextP, 0);
+    prv_runRequest(contextP, 512);
+    prv_runRequest(contextP, 1024);
+
+    lwm2m_close(contextP);
+}
@@ -0,0 +1,206 @@
+/**
+ * @file shardbench.c
+ *
+ * Registration throughput of the multi-threaded server runtime of the examples, for 1 to 8
+ * worker threads.
+ *
+ * The registrations are handed to shard_dispatch() as the I/O thread of the server would
+ * after reading them. The runtime uses the platform functions of the examples, so the
+ * responses are really sent, to local UDP sockets which never read them. The clients are
+ * spread over several sockets sharing a port, so the worker threads do not all queue their
+ * responses to the same socket. The throughput only grows with the shards up to the number
+ * of CPUs, which is printed first. The CPU time of the process per registration is reported
+ * too: it stays the same whatever the number of shards as long as they do not contend.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "liblwm2m.h"
+#include "er-coap-13.h"
+#include "shard.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+
+// Clients registering in each round, from distinct addresses
+#define BENCH_CLIENT_COUNT  1024
+// Each client registers again in every round
+#define BENCH_ROUND_COUNT   16
+// Sockets receiving the responses, the kernel spreads the clients over them
+#define BENCH_SINK_COUNT    8
+
+typedef struct
+{
+    struct sockaddr_storage addr;
+    socklen_t               addrLen;
+    size_t                  length;
+    uint8_t                 buffer[128];
+} bench_datagram_t;
+
+static bench_datagram_t datagrams[BENCH_ROUND_COUNT][BENCH_CLIENT_COUNT];
+
+// CPU time of all the threads of the process in nanoseconds
+static uint64_t prv_cpuNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Bind a UDP socket to addrP and read back its port. With reusePort, several sockets
+// can be bound to the same port.
+static int prv_openSocket(struct sockaddr_in * addrP,
+                          bool reusePort)
+{
+    socklen_t addrLen = sizeof(struct sockaddr_in);
+    int option = 1;
+    int sock;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) return -1;
+
+    if ((reusePort && 0 != setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)))
+     || 0 != bind(sock, (struct sockaddr *)addrP, sizeof(struct sockaddr_in))
+     || 0 != getsockname(sock, (struct sockaddr *)addrP, &addrLen))
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+// All the clients use the port of the sink socket on a distinct loopback address
+static void prv_buildRegistrations(in_port_t sinkPort)
+{
+    size_t round;
+    size_t i;
+
+    for (round = 0 ; round < BENCH_ROUND_COUNT ; round++)
+    {
+        for (i = 0 ; i < BENCH_CLIENT_COUNT ; i++)
+        {
+            bench_datagram_t * datagramP = &datagrams[round][i];
+            struct sockaddr_in * addrP = (struct sockaddr_in *)&datagramP->addr;
+            coap_packet_t message[1];
+            char query[64];
+
+            memset(addrP, 0, sizeof(struct sockaddr_storage));
+            addrP->sin_family = AF_INET;
+            addrP->sin_port = sinkPort;
+            addrP->sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + i);
+            datagramP->addrLen = sizeof(struct sockaddr_in);
+
+            snprintf(query, sizeof(query), "?lwm2m=1.0&ep=bench%zu&lt=300", i);
+            coap_init_message(message, COAP_TYPE_CON, COAP_POST, (uint16_t)(round * BENCH_CLIENT_COUNT + i));
+            coap_set_header_uri_path(message, "/rd");
+            coap_set_header_uri_query(message, query);
+            coap_set_payload(message, "</1/0>,</3/0>,</5/0>", 20);
+            datagramP->length = coap_serialize_message(message, datagramP->buffer);
+        }
+    }
+}
+
+static void prv_runRegistrations(int sock,
+                                 size_t threads)
+{
+    shard_pool_t * poolP;
+    shard_stats_t stats;
+    struct timespec pause;
+    uint64_t start;
+    uint64_t cpuStart;
+    size_t round;
+    size_t i;
+
+    poolP = shard_pool_new(sock, threads);
+    if (poolP == NULL)
+    {
+        fprintf(stderr, "shard_pool_new() failed\r\n");
+        return;
+    }
+
+    start = bench_now();
+    cpuStart = prv_cpuNow();
+    for (round = 0 ; round < BENCH_ROUND_COUNT ; round++)
+    {
+        for (i = 0 ; i < BENCH_CLIENT_COUNT ; i++)
+        {
+            bench_datagram_t * datagramP = &datagrams[round][i];
+
+            // a full queue is retried, as the kernel would buffer the datagram
+            while (!shard_dispatch(poolP, &datagramP->addr, datagramP->addrLen, datagramP->buffer, datagramP->length))
+            {
+                sched_yield();
+            }
+        }
+    }
+    // polled without spinning, not to take a CPU from the worker threads
+    pause.tv_sec = 0;
+    pause.tv_nsec = 100000;
+    do
+    {
+        nanosleep(&pause, NULL);
+        shard_pool_stats(poolP, &stats);
+    } while (stats.handled < BENCH_ROUND_COUNT * BENCH_CLIENT_COUNT);
+
+    bench_report("shard: registration", threads, bench_now() - start, BENCH_ROUND_COUNT * BENCH_CLIENT_COUNT);
+    bench_report("shard: registration cpu time", threads, prv_cpuNow() - cpuStart, BENCH_ROUND_COUNT * BENCH_CLIENT_COUNT);
+
+    shard_pool_free(poolP);
+}
+
+int main(void)
+{
+    struct sockaddr_in sinkAddr;
+    struct sockaddr_in serverAddr;
+    int sinkSocks[BENCH_SINK_COUNT];
+    int serverSock;
+    size_t threads;
+    size_t i;
+
+    memset(&sinkAddr, 0, sizeof(sinkAddr));
+    sinkAddr.sin_family = AF_INET;
+    sinkAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    // the first socket picks the port, the others share it
+    for (i = 0 ; i < BENCH_SINK_COUNT ; i++)
+    {
+        sinkSocks[i] = prv_openSocket(&sinkAddr, true);
+    }
+
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serverSock = prv_openSocket(&serverAddr, false);
+
+    for (i = 0 ; i < BENCH_SINK_COUNT ; i++)
+    {
+        if (sinkSocks[i] < 0) break;
+    }
+    if (i != BENCH_SINK_COUNT || serverSock < 0)
+    {
+        fprintf(stderr, "Error opening sockets\r\n");
+        return -1;
+    }
+
+    prv_buildRegistrations(sinkAddr.sin_port);
+
+    printf("%ld CPUs online\r\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-40s %10s %15s\r\n", "benchmark", "threads", "cost");
+    for (threads = 1 ; threads <= 8 ; threads *= 2)
+    {
+        prv_runRegistrations(serverSock, threads);
+    }
+
+    close(serverSock);
+    for (i = 0 ; i < BENCH_SINK_COUNT ; i++)
+    {
+        close(sinkSocks[i]);
+    }
+
+    return 0;
+}
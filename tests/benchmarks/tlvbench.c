@@ -0,0 +1,209 @@
+/**
+ * @file tlvbench.c
+ *
+ * Cost of parsing the TLV payload of a Write on an object instance, for a growing
+ * number of resources.
+ * Cost of serializing the Read of an object whose instances hold a multiple resource,
+ * for a growing number of resource instances.
+ * Cost of serializing every Block2 block of that Read, one request per block.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+// Resources parsed or serialized per measure, whatever the size of the payload
+#define BENCH_RESOURCE_COUNT    2000000
+// Resource instances of the multiple resource of each object instance
+#define BENCH_INSTANCE_WIDTH    10
+// Block size of the Block2 transfers
+#define BENCH_BLOCK_SIZE        REST_MAX_CHUNK_SIZE
+
+// Serialize an instance of resourceCount integer resources
+static int prv_buildPayload(size_t resourceCount,
+                            uint8_t ** bufferP)
+{
+    lwm2m_data_t * dataP;
+    int length;
+    size_t i;
+
+    dataP = lwm2m_data_new((int)resourceCount);
+    if (dataP == NULL) return -1;
+
+    for (i = 0 ; i < resourceCount ; i++)
+    {
+        dataP[i].id = (uint16_t)i;
+        lwm2m_data_encode_int((int64_t)i * 1000, dataP + i);
+    }
+    length = tlv_serialize(false, (int)resourceCount, dataP, bufferP);
+    lwm2m_data_free((int)resourceCount, dataP);
+
+    return length;
+}
+
+static void prv_runParse(size_t resourceCount)
+{
+    uint8_t * buffer = NULL;
+    size_t iterations = BENCH_RESOURCE_COUNT / resourceCount;
+    size_t parsed = 0;
+    uint64_t start;
+    int length;
+    size_t i;
+
+    length = prv_buildPayload(resourceCount, &buffer);
+    if (length <= 0) return;
+
+    start = bench_now();
+    for (i = 0 ; i < iterations ; i++)
+    {
+        lwm2m_data_t * dataP;
+        int size;
+
+        size = tlv_parse(buffer, (size_t)length, &dataP);
+        parsed += (size_t)size;
+        lwm2m_data_free(size, dataP);
+    }
+    bench_report("tlv: parse", resourceCount, bench_now() - start, iterations);
+
+    if (parsed != iterations * resourceCount)
+    {
+        fprintf(stderr, "%zu resources parsed instead of %zu\r\n", parsed, iterations * resourceCount);
+    }
+
+    lwm2m_free(buffer);
+}
+
+// Build an object of resourceCount / BENCH_INSTANCE_WIDTH instances, each with one multiple resource
+static lwm2m_data_t * prv_buildObject(size_t resourceCount,
+                                      int * sizeP)
+{
+    lwm2m_data_t * instanceP;
+    size_t instanceCount = resourceCount / BENCH_INSTANCE_WIDTH;
+    size_t i;
+    size_t j;
+
+    instanceP = lwm2m_data_new((int)instanceCount);
+    if (instanceP == NULL) return NULL;
+    *sizeP = (int)instanceCount;
+
+    for (i = 0 ; i < instanceCount ; i++)
+    {
+        lwm2m_data_t * resourceP;
+        lwm2m_data_t * valueP;
+
+        resourceP = lwm2m_data_new(1);
+        valueP = lwm2m_data_new(BENCH_INSTANCE_WIDTH);
+        if (resourceP == NULL || valueP == NULL)
+        {
+            lwm2m_free(resourceP);
+            lwm2m_free(valueP);
+            break;
+        }
+        for (j = 0 ; j < BENCH_INSTANCE_WIDTH ; j++)
+        {
+            valueP[j].id = (uint16_t)j;
+            lwm2m_data_encode_int((int64_t)(i * BENCH_INSTANCE_WIDTH + j) * 1000, valueP + j);
+        }
+        resourceP->id = 1;
+        lwm2m_data_encode_instances(valueP, BENCH_INSTANCE_WIDTH, resourceP);
+        instanceP[i].id = (uint16_t)i;
+        lwm2m_data_include(resourceP, 1, instanceP + i);
+    }
+    if (i != instanceCount)
+    {
+        lwm2m_data_free(*sizeP, instanceP);
+        return NULL;
+    }
+
+    return instanceP;
+}
+
+static void prv_runSerialize(size_t resourceCount)
+{
+    lwm2m_data_t * dataP;
+    size_t iterations = BENCH_RESOURCE_COUNT / resourceCount;
+    size_t failed = 0;
+    uint64_t start;
+    int size;
+    size_t i;
+
+    dataP = prv_buildObject(resourceCount, &size);
+    if (dataP == NULL) return;
+
+    start = bench_now();
+    for (i = 0 ; i < iterations ; i++)
+    {
+        uint8_t * buffer;
+
+        if (tlv_serialize(false, size, dataP, &buffer) <= 0) failed++;
+        else lwm2m_free(buffer);
+    }
+    bench_report("tlv: serialize", resourceCount, bench_now() - start, iterations);
+
+    if (failed != 0)
+    {
+        fprintf(stderr, "%zu serializations failed\r\n", failed);
+    }
+
+    lwm2m_data_free(size, dataP);
+}
+
+static void prv_runBlocks(size_t resourceCount)
+{
+    lwm2m_data_t * dataP;
+    size_t iterations = BENCH_RESOURCE_COUNT / resourceCount;
+    size_t failed = 0;
+    uint64_t start;
+    int size;
+    size_t i;
+
+    dataP = prv_buildObject(resourceCount, &size);
+    if (dataP == NULL) return;
+
+    start = bench_now();
+    for (i = 0 ; i < iterations ; i++)
+    {
+        size_t offset = 0;
+        size_t total;
+
+        do
+        {
+            uint8_t * buffer;
+            int length;
+
+            length = tlv_serializeBlock(false, size, dataP, offset, BENCH_BLOCK_SIZE, &buffer, &total);
+            if (length <= 0)
+            {
+                failed++;
+                break;
+            }
+            lwm2m_free(buffer);
+            offset += (size_t)length;
+        } while (offset < total);
+    }
+    bench_report("tlv: block transfer", resourceCount, bench_now() - start, iterations);
+
+    if (failed != 0)
+    {
+        fprintf(stderr, "%zu block transfers failed\r\n", failed);
+    }
+
+    lwm2m_data_free(size, dataP);
+}
+
+void bench_tlv(void)
+{
+    prv_runParse(10);
+    prv_runParse(100);
+    prv_runParse(1000);
+    prv_runSerialize(10);
+    prv_runSerialize(100);
+    prv_runSerialize(1000);
+    prv_runBlocks(100);
+    prv_runBlocks(1000);
+    prv_runBlocks(10000);
+}
@@ -0,0 +1,151 @@
+/**
+ * @file transactionbench.c
+ *
+ * Cost of matching a response against the in-flight transactions and of
+ * scheduling their retransmissions.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "internals.h"
+#include "bench.h"
+
+#define BENCH_PEER_COUNT        64
+#define BENCH_RESPONSE_COUNT    100000
+#define BENCH_STEP_COUNT        100000
+
+static int Peers[BENCH_PEER_COUNT];
+
+static lwm2m_transaction_t * prv_newTransaction(lwm2m_context_t * contextP,
+                                                size_t seed)
+{
+    lwm2m_transaction_t * transacP;
+    lwm2m_uri_t uri;
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID;
+    uri.objectId = 3;
+    uri.instanceId = 0;
+
+    transacP = transaction_new(&Peers[seed % BENCH_PEER_COUNT], COAP_GET, NULL, &uri, contextP->nextMID++, 4, NULL);
+    if (NULL == transacP) return NULL;
+    if (0 != transaction_send(contextP, transacP)) return NULL;
+
+    return transacP;
+}
+
+static void prv_run(size_t inflight,
+                    bool piggybacked)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_transaction_t ** transactions;
+    coap_packet_t response[1];
+    uint64_t elapsed = 0;
+    uint32_t seed = 12345;
+    size_t i;
+
+    contextP = lwm2m_init(NULL);
+    transactions = (lwm2m_transaction_t **)lwm2m_malloc(inflight * sizeof(lwm2m_transaction_t *));
+    if (NULL == contextP || NULL == transactions) return;
+
+    for (i = 0 ; i < inflight ; i++)
+    {
+        transactions[i] = prv_newTransaction(contextP, i);
+    }
+
+    for (i = 0 ; i < BENCH_RESPONSE_COUNT ; i++)
+    {
+        lwm2m_transaction_t * transacP;
+        coap_packet_t * request;
+        size_t target;
+        void * peerH;
+        uint64_t start;
+
+        seed = seed * 1103515245 + 12345;
+        target = (seed >> 8) % inflight;
+        transacP = transactions[target];
+        request = (coap_packet_t *)transacP->message;
+        peerH = transacP->peerH;
+
+        if (piggybacked)
+        {
+            coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, transacP->mID);
+        }
+        else
+        {
+            coap_init_message(response, COAP_TYPE_NON, COAP_205_CONTENT, (uint16_t)(transacP->mID + 0x8000));
+        }
+        coap_set_header_token(response, request->token, request->token_len);
+
+        start = bench_now();
+        transaction_handleResponse(contextP, peerH, response, NULL);
+        elapsed += bench_now() - start;
+
+        transactions[target] = prv_newTransaction(contextP, target);
+    }
+
+    bench_report(piggybacked ? "transaction: match ACK by MID" : "transaction: match NON by token",
+                 inflight, elapsed, BENCH_RESPONSE_COUNT);
+
+    while (NULL != contextP->transactionList)
+    {
+        transaction_remove(contextP, contextP->transactionList);
+    }
+    lwm2m_free(transactions);
+    lwm2m_close(contextP);
+}
+
+static void prv_runStep(size_t inflight)
+{
+    lwm2m_context_t * contextP;
+    int64_t currentTime;
+    uint64_t start;
+    uint64_t elapsed;
+    size_t i;
+
+    contextP = lwm2m_init(NULL);
+    if (NULL == contextP) return;
+
+    for (i = 0 ; i < inflight ; i++)
+    {
+        prv_newTransaction(contextP, i);
+    }
+
+    // no retransmission is due yet: the step only has to find the next deadline
+    currentTime = utils_gettimeMs();
+    start = bench_now();
+    for (i = 0 ; i < BENCH_STEP_COUNT ; i++)
+    {
+        int64_t timeout = 60000;
+
+        transaction_step(contextP, currentTime, &timeout);
+    }
+    elapsed = bench_now() - start;
+
+    bench_report("transaction: idle step", inflight, elapsed, BENCH_STEP_COUNT);
+
+    while (NULL != contextP->transactionList)
+    {
+        transaction_remove(contextP, contextP->transactionList);
+    }
+    lwm2m_close(contextP);
+}
+
+void bench_transaction(void)
+{
+    size_t inflight;
+
+    for (inflight = 10 ; inflight <= 10000 ; inflight *= 10)
+    {
+        prv_run(inflight, true);
+    }
+    for (inflight = 10 ; inflight <= 10000 ; inflight *= 10)
+    {
+        prv_run(inflight, false);
+    }
+    for (inflight = 10 ; inflight <= 10000 ; inflight *= 10)
+    {
+        prv_runStep(inflight);
+    }
+}
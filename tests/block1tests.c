@@ -69,9 +69,112 @@ static void test_block1_retransmit(void)
     free_block1_buffer(blk1);
 }
 
+// Serialize an instance holding small resources around a large opaque one
+static int build_tlv_payload(uint8_t ** bufferP)
+{
+    static uint8_t opaque[300];
+    lwm2m_data_t * dataP;
+    int length;
+    int i;
+
+    dataP = lwm2m_data_new(6);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    for (i = 0; i < 6; i++)
+    {
+        dataP[i].id = (uint16_t)(i == 5 ? 1000 : i);
+        if (i == 2) lwm2m_data_encode_opaque(opaque, sizeof(opaque), dataP + i);
+        else lwm2m_data_encode_int(i * 100000, dataP + i);
+    }
+    length = tlv_serialize(false, 6, dataP, bufferP);
+    lwm2m_data_free(6, dataP);
+
+    return length;
+}
+
+static void test_block1_tlv_stream(void)
+{
+    uint16_t blockSizes[] = {16, 32, 64, 1024};
+    uint8_t * payload;
+    size_t sizeIndex;
+    int length;
+
+    length = build_tlv_payload(&payload);
+    CU_ASSERT_FATAL(length > 0);
+
+    for (sizeIndex = 0; sizeIndex < sizeof(blockSizes) / sizeof(blockSizes[0]); sizeIndex++)
+    {
+        lwm2m_block1_data_t * blk1 = NULL;
+        uint16_t blockSize = blockSizes[sizeIndex];
+        size_t received = 0;
+        uint32_t num;
+
+        for (num = 0; num * blockSize < (size_t)length; num++)
+        {
+            size_t blockLength = MIN(blockSize, length - num * blockSize);
+            bool more = (num + 1) * blockSize < (size_t)length;
+            uint8_t * resultBuffer = NULL;
+            size_t bsize;
+            size_t nextSize;
+            uint8_t st;
+
+            st = coap_block1_tlv_handler(&blk1, (uint16_t)num, payload + num * blockSize, blockLength, blockSize, num, more, &resultBuffer, &bsize);
+            if (st == NO_ERROR)
+            {
+                // only whole records are handed out, in order
+                CU_ASSERT_EQUAL(tlv_getCompleteLength(resultBuffer, bsize, &nextSize), bsize);
+                CU_ASSERT(0 == memcmp(payload + received, resultBuffer, bsize));
+                received += bsize;
+            }
+            else
+            {
+                CU_ASSERT_EQUAL(st, more ? COAP_231_CONTINUE : COAP_204_CHANGED);
+            }
+        }
+        CU_ASSERT_EQUAL(received, length);
+
+        free_block1_buffer(blk1);
+    }
+
+    lwm2m_free(payload);
+}
+
+static void test_block1_tlv_retransmit(void)
+{
+    lwm2m_block1_data_t * blk1 = NULL;
+    uint8_t * payload;
+    uint8_t * resultBuffer;
+    size_t bsize;
+    int length;
+
+    length = build_tlv_payload(&payload);
+    CU_ASSERT_FATAL(length > 32);
+
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 1, payload, 16, 16, 0, true, &resultBuffer, &bsize), NO_ERROR);
+    // a retransmitted block is not handed out again
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 2, payload + 16, 16, 16, 1, true, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 2, payload + 16, 16, 16, 1, true, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(bsize, 0);
+    // a late duplicate of an earlier block is acknowledged without being handed out
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 5, payload + 32, 16, 16, 2, true, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 6, payload + 16, 16, 16, 1, true, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(bsize, 0);
+    // a missing block is rejected, the transfer goes on with the expected one
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 7, payload + 64, 16, 16, 4, true, &resultBuffer, &bsize), COAP_408_REQ_ENTITY_INCOMPLETE);
+    CU_ASSERT_NOT_EQUAL(coap_block1_tlv_handler(&blk1, 8, payload + 48, 16, 16, 3, true, &resultBuffer, &bsize), COAP_408_REQ_ENTITY_INCOMPLETE);
+
+    // a payload ending in the middle of a record is rejected
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 9, payload, 16, 16, 0, true, &resultBuffer, &bsize), NO_ERROR);
+    CU_ASSERT_EQUAL(coap_block1_tlv_handler(&blk1, 10, payload + 16, 16, 16, 1, false, &resultBuffer, &bsize), COAP_400_BAD_REQUEST);
+
+    free_block1_buffer(blk1);
+    lwm2m_free(payload);
+}
+
 static struct TestTable table[] = {
         { "test of test_block1_nominal()", test_block1_nominal },
         { "test of test_block1_retransmit()", test_block1_retransmit },
+        { "test of test_block1_tlv_stream()", test_block1_tlv_stream },
+        { "test of test_block1_tlv_retransmit()", test_block1_tlv_retransmit },
         { NULL, NULL },
 };
 
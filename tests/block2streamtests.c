@@ -19,8 +19,6 @@
 #include "CUnit/Basic.h"
 
 
-#define MAX_BLOCK2_SIZE 1024
-
 //--------------------------------------------------------------------------------------------------
 /**
  * CoAP test message
@@ -32,6 +30,14 @@ static uint8_t TestPayload[MAX_BLOCK2_SIZE];
 
 static lwm2mcore_StreamStatus_t StreamStatus;
 
+//--------------------------------------------------------------------------------------------------
+/**
+ * Context holding the block2 stream state
+ */
+//--------------------------------------------------------------------------------------------------
+static lwm2m_context_t TestContext;
+static lwm2m_packet_state_t TestPacketState;
+
 static uint32_t TotalBlocksRequested = 0;
 
 //--------------------------------------------------------------------------------------------------
@@ -83,11 +89,11 @@ static uint8_t CoapMessageHandler
             // Assuming that the test finishes after 3 blocks.
             if (TotalBlocksRequested >= 3)
             {
-                coap_block2_handle_response(&TestResponse, LWM2MCORE_TX_STREAM_END);
+                coap_block2_handle_response(&TestContext, &TestResponse, LWM2MCORE_TX_STREAM_END);
             }
             else
             {
-                coap_block2_handle_response(&TestResponse, LWM2MCORE_TX_STREAM_IN_PROGRESS);
+                coap_block2_handle_response(&TestContext, &TestResponse, LWM2MCORE_TX_STREAM_IN_PROGRESS);
             }
             break;
         case LWM2MCORE_TX_STREAM_ERROR:
@@ -124,21 +130,21 @@ static void test_block2_stream_nominal(void)
     memset(TestPayload, TotalBlocksRequested, MAX_BLOCK2_SIZE);
 
     setup_test_message(&TestResponse, 123, COAP_TYPE_CON, COAP_205_CONTENT, 0, 1, MAX_BLOCK2_SIZE);
-    coap_block2_handle_response(&TestResponse, LWM2MCORE_TX_STREAM_START);
+    coap_block2_handle_response(&TestContext, &TestResponse, LWM2MCORE_TX_STREAM_START);
 
     // Assume the device initiated the block transfer and ask for block number 1
     setup_test_message(&TestMessage, 124, COAP_TYPE_CON, COAP_GET, 1, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     setup_test_message(&TestMessage, 125, COAP_TYPE_CON, COAP_GET, 2, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     setup_test_message(&TestMessage, 126, COAP_TYPE_CON, COAP_GET, 3, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
@@ -165,47 +171,47 @@ static void test_block2_stream_retransmit(void)
     memset(TestPayload, TotalBlocksRequested, MAX_BLOCK2_SIZE);
 
     setup_test_message(&TestResponse, 223, COAP_TYPE_CON, COAP_205_CONTENT, 0, 1, MAX_BLOCK2_SIZE);
-    coap_block2_handle_response(&TestResponse, LWM2MCORE_TX_STREAM_START);
+    coap_block2_handle_response(&TestContext, &TestResponse, LWM2MCORE_TX_STREAM_START);
 
     // Assume the device initiated the block transfer and ask for block number 1
     setup_test_message(&TestMessage, 224, COAP_TYPE_CON, COAP_GET, 1, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     // retransmit block num 1
     setup_test_message(&TestMessage, 224, COAP_TYPE_CON, COAP_GET, 1, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_205_CONTENT);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     // retransmit block num 1
     setup_test_message(&TestMessage, 224, COAP_TYPE_CON, COAP_GET, 1, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_205_CONTENT);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     // transmit block num 2
     setup_test_message(&TestMessage, 225, COAP_TYPE_CON, COAP_GET, 2, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     // retransmit block num 2
     setup_test_message(&TestMessage, 225, COAP_TYPE_CON, COAP_GET, 2, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_205_CONTENT);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     // transmit block num 3
     setup_test_message(&TestMessage, 226, COAP_TYPE_CON, COAP_GET, 3, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
     // retransmit block num 3
     setup_test_message(&TestMessage, 226, COAP_TYPE_CON, COAP_GET, 3, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_205_CONTENT);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_IN_PROGRESS);
 
@@ -229,17 +235,17 @@ static void test_block2_stream_large(void)
     memset(TestPayload, TotalBlocksRequested, MAX_BLOCK2_SIZE);
 
     setup_test_message(&TestResponse, 323, COAP_TYPE_CON, COAP_205_CONTENT, 0, 1, MAX_BLOCK2_SIZE);
-    coap_block2_handle_response(&TestResponse, LWM2MCORE_TX_STREAM_START);
+    coap_block2_handle_response(&TestContext, &TestResponse, LWM2MCORE_TX_STREAM_START);
 
     // try requesting larger block size
     setup_test_message(&TestMessage, 324, COAP_TYPE_CON, COAP_GET, 1, 1, (MAX_BLOCK2_SIZE + 1));
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_500_INTERNAL_SERVER_ERROR);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_ERROR);
 
     // report COAP_413_ENTITY_TOO_LARGE
     setup_test_message(&TestMessage, 324, COAP_TYPE_CON, COAP_413_ENTITY_TOO_LARGE, 1, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_ERROR);
 }
@@ -260,15 +266,23 @@ static void test_block2_stream_incomplete(void)
     memset(TestPayload, TotalBlocksRequested, MAX_BLOCK2_SIZE);
 
     setup_test_message(&TestResponse, 423, COAP_TYPE_CON, COAP_205_CONTENT, 0, 1, MAX_BLOCK2_SIZE);
-    coap_block2_handle_response(&TestResponse, LWM2MCORE_TX_STREAM_START);
+    coap_block2_handle_response(&TestContext, &TestResponse, LWM2MCORE_TX_STREAM_START);
 
     // report COAP_413_ENTITY_TOO_LARGE
     setup_test_message(&TestMessage, 424, COAP_TYPE_CON, COAP_408_REQ_ENTITY_INCOMPLETE, 1, 1, MAX_BLOCK2_SIZE);
-    st = coap_block2_stream_handler(&TestMessage, &TestResponse);
+    st = coap_block2_stream_handler(&TestContext, &TestMessage, &TestResponse);
     CU_ASSERT_EQUAL(st, COAP_IGNORE);
     CU_ASSERT_EQUAL(StreamStatus, LWM2MCORE_TX_STREAM_ERROR);
 }
 
+static int init_block2_stream_suite(void)
+{
+    memset(&TestContext, 0, sizeof(TestContext));
+    memset(&TestPacketState, 0, sizeof(TestPacketState));
+    TestContext.packetStateP = &TestPacketState;
+    return 0;
+}
+
 static struct TestTable table[] = {
         { "test of test_block2_stream_nominal()", test_block2_stream_nominal },
         { "test of test_block2_stream_retransmit()", test_block2_stream_retransmit },
@@ -281,7 +295,7 @@ static struct TestTable table[] = {
 CU_ErrorCode create_block2_stream_suit() {
     CU_pSuite pSuite = NULL;
     printf("1\r\n");
-    pSuite = CU_add_suite("Suite_block2_stream", NULL, NULL);
+    pSuite = CU_add_suite("Suite_block2_stream", init_block2_stream_suite, NULL);
 
     if (NULL == pSuite) {
         return CU_get_error();
@@ -76,6 +76,116 @@ static void test_coap_proxy_uri(void)
     CU_ASSERT_EQUAL(status, PROXYING_NOT_SUPPORTED_5_05);
 }
 
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests the parsing of more Uri-Path and Uri-Query options than the packet's option pool can hold
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_coap_multi_option(void)
+{
+    coap_status_t status;
+    static coap_packet_t request[1];
+    static coap_packet_t message[1];
+    uint8_t data[COAP_MAX_PACKET_SIZE];
+    size_t data_len;
+    multi_option_t * optP;
+    char * path;
+    int count;
+
+    coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0x1234);
+    coap_set_header_uri_path(request, "/a/b/c/d/e/f/g/h/i/j");
+    coap_set_header_uri_query(request, "ep=test&lt=300");
+    data_len = coap_serialize_message(request, data);
+    coap_free_header(request);
+
+    status = coap_parse_message(message, data, (uint16_t)data_len);
+    CU_ASSERT_EQUAL(status, NO_ERROR);
+
+    path = coap_get_multi_option_as_string(message->uri_path);
+    CU_ASSERT_PTR_NOT_NULL(path);
+    if (NULL != path)
+    {
+        CU_ASSERT_STRING_EQUAL(path, "/a/b/c/d/e/f/g/h/i/j");
+        lwm2m_free(path);
+    }
+
+    count = 0;
+    for (optP = message->uri_query ; optP != NULL ; optP = optP->next) count++;
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(message->uri_query->len, 7);
+    CU_ASSERT_EQUAL(memcmp(message->uri_query->data, "ep=test", 7), 0);
+
+    coap_free_header(message);
+    CU_ASSERT_PTR_NULL(message->uri_path);
+    CU_ASSERT_PTR_NULL(message->uri_query);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests the case where the datagram is truncated inside the header, the token or an option
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_coap_truncated(void)
+{
+    static coap_packet_t message[1];
+
+    // Shorter than the fixed header
+    uint8_t header[] = {0x40, 0x01, 0x12};
+    // Token length greater than 8
+    uint8_t token[] = {0x49, 0x01, 0x12, 0x34, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09};
+    // Token length greater than the remaining bytes
+    uint8_t shortToken[] = {0x44, 0x01, 0x12, 0x34, 0x01, 0x02};
+    // Two-byte extended option delta with a single byte left
+    uint8_t delta[] = {0x40, 0x01, 0x12, 0x34, 0xE0, 0x01};
+    // Option value longer than the remaining bytes
+    uint8_t value[] = {0x40, 0x01, 0x12, 0x34, 0xB5, 0x72, 0x64};
+
+    CU_ASSERT_EQUAL(coap_parse_message(message, header, sizeof(header)), BAD_REQUEST_4_00);
+    CU_ASSERT_EQUAL(coap_parse_message(message, token, sizeof(token)), BAD_REQUEST_4_00);
+    CU_ASSERT_EQUAL(coap_parse_message(message, shortToken, sizeof(shortToken)), BAD_REQUEST_4_00);
+    CU_ASSERT_EQUAL(coap_parse_message(message, delta, sizeof(delta)), BAD_REQUEST_4_00);
+    CU_ASSERT_EQUAL(coap_parse_message(message, value, sizeof(value)), BAD_REQUEST_4_00);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests the serialization of a header without its payload, in a buffer large enough or not
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_coap_serialize_header(void)
+{
+    static coap_packet_t request[1];
+    uint8_t message[COAP_MAX_PACKET_SIZE];
+    uint8_t header[COAP_MAX_PACKET_SIZE];
+    uint8_t payload[] = {0xC1, 0x0D, 0x2A};
+    size_t message_len;
+    size_t header_len;
+
+    coap_init_message(request, COAP_TYPE_CON, COAP_PUT, 0x1234);
+    coap_set_header_uri_path(request, "/3/0/13");
+    coap_set_header_content_type(request, LWM2M_CONTENT_TLV);
+    coap_set_payload(request, payload, sizeof(payload));
+    message_len = coap_serialize_message(request, message);
+
+    coap_set_header_uri_path(request, "/3/0/13");
+    header_len = coap_serialize_header(request, header, sizeof(header));
+    CU_ASSERT_EQUAL(header_len + sizeof(payload), message_len);
+    CU_ASSERT_EQUAL(memcmp(header, message, header_len), 0);
+    CU_ASSERT_EQUAL(header[header_len - 1], 0xFF);
+
+    // one byte short of the header
+    coap_set_header_uri_path(request, "/3/0/13");
+    CU_ASSERT_EQUAL(coap_serialize_header(request, header, header_len - 1), 0);
+    CU_ASSERT_PTR_NULL(request->uri_path);
+
+    // an empty option list writes nothing
+    coap_set_header_uri_path(request, "/3/0/13");
+    SET_OPTION(request, COAP_OPTION_URI_QUERY);
+    CU_ASSERT_PTR_NULL(request->uri_query);
+    CU_ASSERT_EQUAL(coap_serialize_header(request, header, sizeof(header)), header_len);
+    CU_ASSERT_EQUAL(memcmp(header, message, header_len), 0);
+}
+
 //--------------------------------------------------------------------------------------------------
 /**
  * Structure for all CoAP tests
@@ -85,6 +195,9 @@ static struct TestTable table[] = {
         { "test of test_coap_bad_option()\n", test_coap_bad_option },
         { "test of test_coap_bad_version()\n", test_coap_bad_version },
         { "test of test_coap_proxy_uri()\n", test_coap_proxy_uri },
+        { "test of test_coap_multi_option()\n", test_coap_multi_option },
+        { "test of test_coap_truncated()\n", test_coap_truncated },
+        { "test of test_coap_serialize_header()\n", test_coap_serialize_header },
         { NULL, NULL },
 };
 
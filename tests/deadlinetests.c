@@ -0,0 +1,130 @@
+//-------------------------------------------------------------------------------------------------
+/**
+ * @file deadlinetests.c
+ *
+ * Unitary test for the deadline min-heap
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ */
+//-------------------------------------------------------------------------------------------------
+
+
+#include "internals.h"
+#include "liblwm2m.h"
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+
+#define DEADLINE_TEST_COUNT 40
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests that the expired nodes are returned in deadline order and are unscheduled
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_deadline_expire(void)
+{
+    lwm2m_deadline_heap_t heap;
+    lwm2m_deadline_t nodes[DEADLINE_TEST_COUNT];
+    lwm2m_deadline_t * nodeP;
+    time_t last = 0;
+    size_t expired = 0;
+    size_t i;
+
+    memset(&heap, 0, sizeof(heap));
+    memset(nodes, 0, sizeof(nodes));
+
+    // deadlines 1..40 inserted out of order
+    for (i = 0 ; i < DEADLINE_TEST_COUNT ; i++)
+    {
+        CU_ASSERT_TRUE(deadline_schedule(&heap, &nodes[i], (time_t)((i * 7) % DEADLINE_TEST_COUNT + 1)));
+    }
+    CU_ASSERT_EQUAL(heap.count, DEADLINE_TEST_COUNT);
+    CU_ASSERT_EQUAL(deadline_first(&heap)->deadline, 1);
+
+    for (nodeP = deadline_expire(&heap, 20) ; nodeP != NULL ; nodeP = nodeP->next)
+    {
+        CU_ASSERT_TRUE(nodeP->deadline <= 20);
+        CU_ASSERT_TRUE(nodeP->deadline >= last);
+        CU_ASSERT_EQUAL(nodeP->position, 0);
+        last = nodeP->deadline;
+        expired++;
+    }
+    CU_ASSERT_EQUAL(expired, 20);
+    CU_ASSERT_EQUAL(heap.count, DEADLINE_TEST_COUNT - 20);
+    CU_ASSERT_EQUAL(deadline_first(&heap)->deadline, 21);
+    CU_ASSERT_EQUAL(deadline_interval(&heap, 15, 60), 6);
+    CU_ASSERT_EQUAL(deadline_interval(&heap, 15, 3), 3);
+
+    deadline_free(&heap);
+    CU_ASSERT_EQUAL(heap.count, 0);
+    CU_ASSERT_PTR_NULL(deadline_first(&heap));
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests rescheduling and cancellation of scheduled nodes
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_deadline_reschedule(void)
+{
+    lwm2m_deadline_heap_t heap;
+    lwm2m_deadline_t nodes[3];
+
+    memset(&heap, 0, sizeof(heap));
+    memset(nodes, 0, sizeof(nodes));
+
+    CU_ASSERT_TRUE(deadline_schedule(&heap, &nodes[0], 10));
+    CU_ASSERT_TRUE(deadline_schedule(&heap, &nodes[1], 20));
+    CU_ASSERT_TRUE(deadline_schedule(&heap, &nodes[2], 30));
+    CU_ASSERT_PTR_EQUAL(deadline_first(&heap), &nodes[0]);
+
+    // later deadline: the node moves down
+    CU_ASSERT_TRUE(deadline_schedule(&heap, &nodes[0], 40));
+    CU_ASSERT_EQUAL(heap.count, 3);
+    CU_ASSERT_PTR_EQUAL(deadline_first(&heap), &nodes[1]);
+
+    // earlier deadline: the node moves up
+    CU_ASSERT_TRUE(deadline_schedule(&heap, &nodes[2], 5));
+    CU_ASSERT_PTR_EQUAL(deadline_first(&heap), &nodes[2]);
+
+    deadline_cancel(&heap, &nodes[2]);
+    CU_ASSERT_EQUAL(nodes[2].position, 0);
+    CU_ASSERT_PTR_EQUAL(deadline_first(&heap), &nodes[1]);
+
+    // cancelling an unscheduled node is harmless
+    deadline_cancel(&heap, &nodes[2]);
+    CU_ASSERT_EQUAL(heap.count, 2);
+
+    CU_ASSERT_PTR_NULL(deadline_expire(&heap, 19));
+    CU_ASSERT_PTR_EQUAL(deadline_expire(&heap, 20), &nodes[1]);
+    CU_ASSERT_PTR_NULL(nodes[1].next);
+
+    deadline_free(&heap);
+}
+
+static struct TestTable table[] = {
+        { "test of test_deadline_expire()\n", test_deadline_expire },
+        { "test of test_deadline_reschedule()\n", test_deadline_reschedule },
+        { NULL, NULL },
+};
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Function for deadline tests suite
+ */
+//--------------------------------------------------------------------------------------------------
+CU_ErrorCode create_deadline_suit
+(
+    void
+)
+{
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_deadline", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+
+    return add_tests(pSuite, table);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file coapfuzz.c
+ *
+ * Fuzzing harness of the CoAP message parser and serializer.
+ *
+ * Built with clang, it is a libFuzzer target. Otherwise COAP_FUZZ_STANDALONE
+ * provides a main() which parses the files given as arguments, or stdin when
+ * there is none, so that it can be driven by AFL.
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ *
+ */
+
+#include "liblwm2m.h"
+#include "er-coap-13.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t * data,
+                           size_t size)
+{
+    coap_packet_t message[1];
+    uint8_t * buffer;
+    uint8_t * output;
+    char * path;
+    size_t length;
+
+    if (size > UINT16_MAX) return 0;
+
+    // exact size copy so that any over-read is caught, and writable as the
+    // parser merges Location-Query options in place
+    buffer = (uint8_t *)malloc(size ? size : 1);
+    if (NULL == buffer) return 0;
+    memcpy(buffer, data, size);
+
+    if (NO_ERROR == coap_parse_message(message, buffer, (uint16_t)size))
+    {
+        path = coap_get_multi_option_as_string(message->uri_path);
+        if (NULL != path) lwm2m_free(path);
+
+        // a parsed message must serialize back
+        length = coap_serialize_get_size(message);
+        output = (uint8_t *)malloc(length ? length : 1);
+        if (NULL != output)
+        {
+            coap_serialize_message(message, output);
+            free(output);
+        }
+    }
+    coap_free_header(message);
+
+    // the header serializer must stop at the end of a buffer too small for it
+    memcpy(buffer, data, size);
+    if (NO_ERROR == coap_parse_message(message, buffer, (uint16_t)size))
+    {
+        length = size / 2;
+        output = (uint8_t *)malloc(length ? length : 1);
+        if (NULL != output)
+        {
+            coap_serialize_header(message, output, length);
+            free(output);
+        }
+    }
+    coap_free_header(message);
+
+    free(buffer);
+    return 0;
+}
+
+#ifdef COAP_FUZZ_STANDALONE
+static void prv_runFile(FILE * file)
+{
+    static uint8_t data[UINT16_MAX];
+    size_t size;
+
+    size = fread(data, 1, sizeof(data), file);
+    LLVMFuzzerTestOneInput(data, size);
+}
+
+int main(int argc, char * argv[])
+{
+    int i;
+
+    if (argc < 2)
+    {
+        prv_runFile(stdin);
+        return 0;
+    }
+
+    for (i = 1 ; i < argc ; i++)
+    {
+        FILE * file = fopen(argv[i], "rb");
+
+        if (NULL == file)
+        {
+            fprintf(stderr, "Cannot open %s\r\n", argv[i]);
+            return 1;
+        }
+        prv_runFile(file);
+        fclose(file);
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,565 @@
+//-------------------------------------------------------------------------------------------------
+/**
+ * @file observetests.c
+ *
+ * Unitary test for the notifications of the observed resources
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ */
+//-------------------------------------------------------------------------------------------------
+
+
+#include "internals.h"
+#include "liblwm2m.h"
+#include "connection.h"
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+
+#include <sys/time.h>
+
+#define OBSERVE_TEST_OBJECT_ID      3303
+#define OBSERVE_TEST_RESOURCE_ID    5700
+#define OBSERVE_TEST_VALUE          23
+
+// Reads of the test object
+static int ReadCount = 0;
+// When set, the next read cancels the observations of the test object in this context
+static lwm2m_context_t * ClearContextP = NULL;
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read callback of the test object: every resource holds the same integer value
+ */
+//--------------------------------------------------------------------------------------------------
+static uint8_t prv_readValue
+(
+    uint16_t instanceId,
+    int * numDataP,
+    lwm2m_data_t ** dataArrayP,
+    lwm2m_object_t * objectP
+)
+{
+    int i;
+
+    (void)instanceId;
+    (void)objectP;
+
+    ReadCount++;
+    if (ClearContextP != NULL)
+    {
+        lwm2m_uri_t uri;
+
+        memset(&uri, 0, sizeof(uri));
+        uri.flag = LWM2M_URI_FLAG_OBJECT_ID;
+        uri.objectId = OBSERVE_TEST_OBJECT_ID;
+        observe_clear(ClearContextP, &uri);
+        ClearContextP = NULL;
+    }
+
+    if (*numDataP == 0)
+    {
+        *dataArrayP = lwm2m_data_new(1);
+        if (*dataArrayP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        *numDataP = 1;
+        (*dataArrayP)->id = OBSERVE_TEST_RESOURCE_ID;
+    }
+
+    for (i = 0 ; i < *numDataP ; i++)
+    {
+        lwm2m_data_encode_int(OBSERVE_TEST_VALUE, *dataArrayP + i);
+    }
+
+    return COAP_205_CONTENT;
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Observe the test resource from a server, with the token {tokenId} and the given accepted format
+ */
+//--------------------------------------------------------------------------------------------------
+static void prv_observe
+(
+    lwm2m_context_t * contextP,
+    lwm2m_uri_t * uriP,
+    lwm2m_server_t * serverP,
+    uint8_t tokenId,
+    lwm2m_media_type_t format
+)
+{
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    lwm2m_data_t * dataP;
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_GET, contextP->nextMID++);
+    coap_set_header_token(message, &tokenId, 1);
+    coap_set_header_observe(message, 0);
+    coap_set_header_accept(message, format);
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, message->mid);
+
+    dataP = lwm2m_data_new(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    dataP->id = OBSERVE_TEST_RESOURCE_ID;
+    lwm2m_data_encode_int(OBSERVE_TEST_VALUE, dataP);
+
+    CU_ASSERT_EQUAL(observe_handleRequest(contextP, uriP, serverP, 1, dataP, message, response), COAP_205_CONTENT);
+
+    lwm2m_data_free(1, dataP);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests that watchers of the same resource asking for TLV and for JSON each get a notification
+ * in their own format
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_observe_formats(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t servers[2];
+    lwm2m_uri_t uri;
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    struct timeval timeout = { 1, 0 };
+    connection_t * connP;
+    bool received[2] = { false, false };
+    int64_t stepTimeout = 60000;
+    int sock;
+    int i;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(sock >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CU_ASSERT_FATAL(0 == bind(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    CU_ASSERT_FATAL(0 == getsockname(sock, (struct sockaddr *)&addr, &addrLen));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // the notifications are sent to the test socket itself
+    connP = connection_new_incoming(NULL, sock, (struct sockaddr *)&addr, addrLen);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(connP);
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = OBSERVE_TEST_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_readValue;
+    contextP->objectList = &object;
+
+    memset(servers, 0, sizeof(servers));
+    for (i = 0 ; i < 2 ; i++)
+    {
+        servers[i].shortID = i + 1;
+        servers[i].status = STATE_REGISTERED;
+        servers[i].sessionH = connP;
+    }
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = OBSERVE_TEST_OBJECT_ID;
+    uri.instanceId = 0;
+    uri.resourceId = OBSERVE_TEST_RESOURCE_ID;
+
+    prv_observe(contextP, &uri, &servers[0], 0, LWM2M_CONTENT_TLV);
+    prv_observe(contextP, &uri, &servers[1], 1, LWM2M_CONTENT_JSON);
+
+    lwm2m_resource_value_changed(contextP, &uri);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+
+    for (i = 0 ; i < 2 ; i++)
+    {
+        uint8_t buffer[256];
+        coap_packet_t message[1];
+        lwm2m_data_t * dataP = NULL;
+        int64_t value = 0;
+        int length;
+
+        length = recv(sock, buffer, sizeof(buffer), 0);
+        CU_ASSERT_FATAL(length > 0);
+        CU_ASSERT_EQUAL_FATAL(coap_parse_message(message, buffer, length), NO_ERROR);
+        CU_ASSERT_EQUAL_FATAL(message->token_len, 1);
+        CU_ASSERT_FATAL(message->token[0] < 2);
+        CU_ASSERT_FALSE(received[message->token[0]]);
+        received[message->token[0]] = true;
+
+        if (message->token[0] == 0)
+        {
+            CU_ASSERT_EQUAL(message->content_type, LWM2M_CONTENT_TLV);
+            CU_ASSERT_EQUAL_FATAL(lwm2m_data_parse(&uri, message->payload, message->payload_len,
+                                                   LWM2M_CONTENT_TLV, &dataP), 1);
+            CU_ASSERT_EQUAL(lwm2m_data_decode_int(dataP, &value), 1);
+            CU_ASSERT_EQUAL(value, OBSERVE_TEST_VALUE);
+            lwm2m_data_free(1, dataP);
+        }
+        else
+        {
+            char json[sizeof(buffer)];
+
+            CU_ASSERT_EQUAL(message->content_type, LWM2M_CONTENT_JSON);
+            CU_ASSERT_FATAL(message->payload_len < sizeof(json));
+            memcpy(json, message->payload, message->payload_len);
+            json[message->payload_len] = 0;
+            CU_ASSERT_PTR_NOT_NULL(strstr(json, "\"v\":23"));
+        }
+    }
+
+    contextP->objectList = NULL;
+    lwm2m_close(contextP);
+    connection_free(connP);
+    close(sock);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Receive a notification from the test socket and check its type and token
+ */
+//--------------------------------------------------------------------------------------------------
+static uint16_t prv_receiveNotification
+(
+    int sock,
+    coap_message_type_t type,
+    uint8_t tokenId
+)
+{
+    uint8_t buffer[256];
+    coap_packet_t message[1];
+    int length;
+
+    length = recv(sock, buffer, sizeof(buffer), 0);
+    CU_ASSERT_FATAL(length > 0);
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(message, buffer, length), NO_ERROR);
+    CU_ASSERT_EQUAL(message->type, type);
+    CU_ASSERT_EQUAL(message->code, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL_FATAL(message->token_len, 1);
+    CU_ASSERT_EQUAL(message->token[0], tokenId);
+
+    return message->mid;
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests that confirmable notifications are limited per server, that a new value replaces the
+ * pending one and that a blocked notification is sent once the server acknowledged one
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_observe_confirmable(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t server;
+    lwm2m_uri_t uri[2];
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    struct timeval timeout = { 1, 0 };
+    connection_t * connP;
+    coap_packet_t ack[1];
+    uint8_t buffer[16];
+    int64_t stepTimeout = 60000;
+    uint16_t firstMid;
+    uint16_t mid;
+    size_t length;
+    int sock;
+    int i;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(sock >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CU_ASSERT_FATAL(0 == bind(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    CU_ASSERT_FATAL(0 == getsockname(sock, (struct sockaddr *)&addr, &addrLen));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    connP = connection_new_incoming(NULL, sock, (struct sockaddr *)&addr, addrLen);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(connP);
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = OBSERVE_TEST_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_readValue;
+    contextP->objectList = &object;
+
+    memset(&server, 0, sizeof(server));
+    server.shortID = 1;
+    server.status = STATE_REGISTERED;
+    server.sessionH = connP;
+    contextP->serverList = &server;
+    CU_ASSERT_EQUAL(lwm2m_set_notification_mode(contextP, 1, 1), COAP_NO_ERROR);
+    CU_ASSERT_EQUAL(lwm2m_set_notification_mode(contextP, 2, 1), COAP_404_NOT_FOUND);
+
+    for (i = 0 ; i < 2 ; i++)
+    {
+        memset(uri + i, 0, sizeof(lwm2m_uri_t));
+        uri[i].flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+        uri[i].objectId = OBSERVE_TEST_OBJECT_ID;
+        uri[i].instanceId = 0;
+        uri[i].resourceId = OBSERVE_TEST_RESOURCE_ID + i;
+        prv_observe(contextP, uri + i, &server, i, LWM2M_CONTENT_TLV);
+    }
+
+    // only one notification may wait for an ACK, the second resource waits
+    lwm2m_resource_value_changed(contextP, uri);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    lwm2m_resource_value_changed(contextP, uri + 1);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    firstMid = prv_receiveNotification(sock, COAP_TYPE_CON, 0);
+    CU_ASSERT_EQUAL(server.notifyPending, 1);
+    CU_ASSERT_PTR_NOT_NULL(server.notifyBlocked);
+
+    // the new value of the first resource replaces the one not acknowledged
+    lwm2m_resource_value_changed(contextP, uri);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    mid = prv_receiveNotification(sock, COAP_TYPE_CON, 0);
+    CU_ASSERT_NOT_EQUAL(mid, firstMid);
+    CU_ASSERT_EQUAL(server.notifyPending, 1);
+    CU_ASSERT_EQUAL(server.notifyCollapsed, 1);
+
+    // the ACK of the replaced notification is ignored, the one of the new notification frees the slot
+    for (i = 0 ; i < 2 ; i++)
+    {
+        coap_init_message(ack, COAP_TYPE_ACK, 0, i == 0 ? firstMid : mid);
+        length = coap_serialize_message(ack, buffer);
+        lwm2m_handle_packet(contextP, buffer, length, connP);
+    }
+    CU_ASSERT_EQUAL(server.notifyPending, 0);
+
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    prv_receiveNotification(sock, COAP_TYPE_CON, 1);
+    CU_ASSERT_EQUAL(server.notifyPending, 1);
+    CU_ASSERT_PTR_NULL(server.notifyBlocked);
+    CU_ASSERT_EQUAL(server.notifyDropped, 0);
+
+    // a new value replacing a notification at its last retransmission cancels the observation
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP->transactionList);
+    contextP->transactionList->retrans_counter = COAP_MAX_RETRANSMIT + 2;
+    lwm2m_resource_value_changed(contextP, uri + 1);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    CU_ASSERT_EQUAL(server.notifyDropped, 1);
+    CU_ASSERT_EQUAL(server.notifyPending, 0);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP->observedList);
+    CU_ASSERT_EQUAL(contextP->observedList->uri.resourceId, OBSERVE_TEST_RESOURCE_ID);
+    CU_ASSERT_PTR_NULL(contextP->observedList->next);
+
+    contextP->objectList = NULL;
+    contextP->serverList = NULL;
+    lwm2m_close(contextP);
+    connection_free(connP);
+    close(sock);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests that an observation is cancelled when its confirmable notification is never acknowledged
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_observe_timeout(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t server;
+    lwm2m_uri_t uri;
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    struct timeval timeout = { 1, 0 };
+    connection_t * connP;
+    int64_t stepTimeout = 60000;
+    int64_t currentTime;
+    int sock;
+    int i;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(sock >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CU_ASSERT_FATAL(0 == bind(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    CU_ASSERT_FATAL(0 == getsockname(sock, (struct sockaddr *)&addr, &addrLen));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    connP = connection_new_incoming(NULL, sock, (struct sockaddr *)&addr, addrLen);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(connP);
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = OBSERVE_TEST_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_readValue;
+    contextP->objectList = &object;
+
+    memset(&server, 0, sizeof(server));
+    server.shortID = 1;
+    server.status = STATE_REGISTERED;
+    server.sessionH = connP;
+    contextP->serverList = &server;
+    CU_ASSERT_EQUAL(lwm2m_set_notification_mode(contextP, 1, 1), COAP_NO_ERROR);
+
+    memset(&uri, 0, sizeof(lwm2m_uri_t));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = OBSERVE_TEST_OBJECT_ID;
+    uri.instanceId = 0;
+    uri.resourceId = OBSERVE_TEST_RESOURCE_ID;
+    prv_observe(contextP, &uri, &server, 0, LWM2M_CONTENT_TLV);
+
+    lwm2m_resource_value_changed(contextP, &uri);
+    currentTime = utils_gettimeMs();
+    observe_step(contextP, currentTime, &stepTimeout);
+    prv_receiveNotification(sock, COAP_TYPE_CON, 0);
+    CU_ASSERT_EQUAL(server.notifyPending, 1);
+
+    // the retransmissions are never acknowledged
+    for (i = 0 ; i <= COAP_MAX_RETRANSMIT && contextP->transactionList != NULL ; i++)
+    {
+        currentTime += (int64_t)COAP_RESPONSE_TIMEOUT * MS_PER_SECOND * 64;
+        transaction_step(contextP, currentTime, &stepTimeout);
+    }
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+    CU_ASSERT_EQUAL(server.notifyPending, 0);
+    CU_ASSERT_EQUAL(server.notifyDropped, 1);
+    CU_ASSERT_PTR_NULL(contextP->observedList);
+
+    // no notification is sent anymore
+    ReadCount = 0;
+    lwm2m_resource_value_changed(contextP, &uri);
+    observe_step(contextP, currentTime, &stepTimeout);
+    CU_ASSERT_EQUAL(ReadCount, 0);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    contextP->objectList = NULL;
+    contextP->serverList = NULL;
+    lwm2m_close(contextP);
+    connection_free(connP);
+    close(sock);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tests that a step reads only the resources which changed, and that the read callback may
+ * cancel the observations left to check by the step
+ */
+//--------------------------------------------------------------------------------------------------
+static void test_observe_step(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t server;
+    lwm2m_uri_t uri[2];
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    struct timeval timeout = { 1, 0 };
+    connection_t * connP;
+    int64_t stepTimeout = 60000;
+    int sock;
+    int i;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(sock >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CU_ASSERT_FATAL(0 == bind(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    CU_ASSERT_FATAL(0 == getsockname(sock, (struct sockaddr *)&addr, &addrLen));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    connP = connection_new_incoming(NULL, sock, (struct sockaddr *)&addr, addrLen);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(connP);
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    memset(&instance, 0, sizeof(instance));
+    memset(&object, 0, sizeof(object));
+    object.objID = OBSERVE_TEST_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_readValue;
+    contextP->objectList = &object;
+
+    memset(&server, 0, sizeof(server));
+    server.shortID = 1;
+    server.status = STATE_REGISTERED;
+    server.sessionH = connP;
+    contextP->serverList = &server;
+
+    for (i = 0 ; i < 2 ; i++)
+    {
+        memset(uri + i, 0, sizeof(lwm2m_uri_t));
+        uri[i].flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+        uri[i].objectId = OBSERVE_TEST_OBJECT_ID;
+        uri[i].instanceId = 0;
+        uri[i].resourceId = OBSERVE_TEST_RESOURCE_ID + i;
+        prv_observe(contextP, uri + i, &server, i, LWM2M_CONTENT_TLV);
+    }
+
+    // nothing changed, nothing is read
+    ReadCount = 0;
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    CU_ASSERT_EQUAL(ReadCount, 0);
+
+    // only the changed resource is read
+    lwm2m_resource_value_changed(contextP, uri + 1);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    CU_ASSERT_EQUAL(ReadCount, 1);
+    prv_receiveNotification(sock, COAP_TYPE_NON, 1);
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    CU_ASSERT_EQUAL(ReadCount, 1);
+
+    // the first read cancels both observations, the second one is not checked anymore
+    lwm2m_resource_value_changed(contextP, uri);
+    lwm2m_resource_value_changed(contextP, uri + 1);
+    ClearContextP = contextP;
+    observe_step(contextP, utils_gettimeMs(), &stepTimeout);
+    CU_ASSERT_EQUAL(ReadCount, 2);
+    CU_ASSERT_PTR_NULL(contextP->observedList);
+    CU_ASSERT_PTR_NULL(contextP->observedStepping);
+
+    contextP->objectList = NULL;
+    contextP->serverList = NULL;
+    lwm2m_close(contextP);
+    connection_free(connP);
+    close(sock);
+}
+
+static struct TestTable table[] = {
+        { "test of test_observe_formats()\n", test_observe_formats },
+        { "test of test_observe_confirmable()\n", test_observe_confirmable },
+        { "test of test_observe_timeout()\n", test_observe_timeout },
+        { "test of test_observe_step()\n", test_observe_step },
+        { NULL, NULL },
+};
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Function for observe tests suite
+ */
+//--------------------------------------------------------------------------------------------------
+CU_ErrorCode create_observe_suit
+(
+    void
+)
+{
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_observe", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+
+    return add_tests(pSuite, table);
+}
@@ -35,5 +35,7 @@ CU_ErrorCode create_block1_suit();
 CU_ErrorCode create_block1_stream_suit();
 CU_ErrorCode create_block2_stream_suit();
 CU_ErrorCode create_coap_suit();
+CU_ErrorCode create_deadline_suit();
+CU_ErrorCode create_observe_suit();
 
 #endif /* TESTS_H_ */
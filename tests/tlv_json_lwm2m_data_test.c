@@ -384,6 +384,49 @@ static void test_10(void)
     test_data("/12/0", LWM2M_CONTENT_JSON, data1, 17, "10b");
 }
 
+static void test_11(void)
+{
+    lwm2m_data_t * data1 = lwm2m_data_new(4);
+    lwm2m_uri_t uri;
+    lwm2m_media_type_t format = LWM2M_CONTENT_JSON;
+    lwm2m_data_t * tlvP;
+    uint8_t * buffer;
+    int length;
+    int size;
+    int i;
+    int j;
+
+    // four instances of twenty strings do not fit in the initial output buffer
+    for (i = 0; i < 4; i++)
+    {
+        lwm2m_data_t * resP = lwm2m_data_new(20);
+
+        for (j = 0; j < 20; j++)
+        {
+            resP[j].id = j;
+            lwm2m_data_encode_string("Lightweight M2M Client resource", resP + j);
+        }
+        data1[i].id = i;
+        lwm2m_data_include(resP, 20, data1 + i);
+    }
+
+    lwm2m_stringToUri("/12", 3, &uri);
+    length = lwm2m_data_serialize(&uri, 4, data1, &format, &buffer);
+    CU_ASSERT_TRUE_FATAL(length > 2048);
+
+    size = lwm2m_data_parse(&uri, buffer, length, LWM2M_CONTENT_JSON, &tlvP);
+    CU_ASSERT_EQUAL(size, 4);
+    for (i = 0; i < size; i++)
+    {
+        CU_ASSERT_EQUAL(tlvP[i].type, LWM2M_TYPE_OBJECT_INSTANCE);
+        CU_ASSERT_EQUAL(tlvP[i].value.asChildren.count, 20);
+    }
+
+    lwm2m_data_free(size, tlvP);
+    lwm2m_free(buffer);
+    lwm2m_data_free(4, data1);
+}
+
 static struct TestTable table[] = {
         { "test of test_1()", test_1 },
         { "test of test_2()", test_2 },
@@ -395,6 +438,7 @@ static struct TestTable table[] = {
         { "test of test_8()", test_8 },
         { "test of test_9()", test_9 },
         { "test of test_10()", test_10 },
+        { "test of test_11()", test_11 },
         { NULL, NULL },
 };
 
@@ -227,6 +227,76 @@ static void test_tlv_serialize()
     MEMORY_TRACE_AFTER_EQ;
 }
 
+static void test_tlv_serialize_block()
+{
+    MEMORY_TRACE_BEFORE;
+
+    int result;
+    int length;
+    lwm2m_data_t *dataP;
+    lwm2m_data_t *tlvSubP;
+    lwm2m_data_t *tlvRscInstP;
+    uint8_t data[300] = {1, 2, 3, 4};
+    uint8_t* buffer;
+    uint8_t* blockP;
+    size_t blockSizes[] = {16, 64, 1024};
+    size_t total;
+    size_t offset;
+    size_t i;
+
+    tlvRscInstP = lwm2m_data_new(3);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tlvRscInstP);
+    for (i = 0; i < 3; i++)
+    {
+        tlvRscInstP[i].id = (uint16_t)i;
+        lwm2m_data_encode_int(-1000 * (int64_t)i, tlvRscInstP + i);
+    }
+
+    tlvSubP = lwm2m_data_new(3);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tlvSubP);
+    tlvSubP[0].id = 1;
+    lwm2m_data_encode_opaque(data, sizeof(data), tlvSubP);
+    tlvSubP[1].id = 2;
+    lwm2m_data_encode_instances(tlvRscInstP, 3, tlvSubP + 1);
+    tlvSubP[2].id = 300;
+    lwm2m_data_encode_float(1.5, tlvSubP + 2);
+
+    dataP = lwm2m_data_new(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    dataP->id = 3;
+    lwm2m_data_include(tlvSubP, 3, dataP);
+
+    length = tlv_serialize(false, 1, dataP, &buffer);
+    CU_ASSERT_FATAL(length > 0);
+
+    // the blocks put together give the full serialization
+    for (i = 0; i < sizeof(blockSizes) / sizeof(blockSizes[0]); i++)
+    {
+        offset = 0;
+        do
+        {
+            lwm2m_media_type_t media_type = LWM2M_CONTENT_TLV;
+
+            result = data_serializeBlock(NULL, 1, dataP, &media_type, offset, blockSizes[i], &blockP, &total);
+            CU_ASSERT_EQUAL_FATAL(total, length);
+            CU_ASSERT_FATAL(result > 0 && result <= (int)blockSizes[i]);
+            CU_ASSERT(0 == memcmp(buffer + offset, blockP, result));
+            lwm2m_free(blockP);
+            offset += result;
+        } while (offset < total);
+        CU_ASSERT_EQUAL(offset, length);
+    }
+
+    result = tlv_serializeBlock(false, 1, dataP, length, 16, &blockP, &total);
+    CU_ASSERT_EQUAL(result, 0);
+    CU_ASSERT_PTR_NULL(blockP);
+
+    lwm2m_data_free(1, dataP);
+    lwm2m_free(buffer);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
 static void test_tlv_int(void)
 {
    MEMORY_TRACE_BEFORE;
@@ -396,6 +466,7 @@ static struct TestTable table[] = {
         { "test of lwm2m_decodeTLV()", test_decodeTLV },
         { "test of lwm2m_data_parse()", test_tlv_parse },
         { "test of lwm2m_data_serialize()", test_tlv_serialize },
+        { "test of data_serializeBlock()", test_tlv_serialize_block },
         { "test of lwm2m_data_encode_int() and lwm2m_data_decode_int()", test_tlv_int },
         { "test of lwm2m_data_encode_bool()and lwm2m_data_decode_bool()", test_tlv_bool },
         { "test of lwm2m_data_encode_float() and lwm2m_data_decode_float()", test_tlv_float },
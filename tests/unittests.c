@@ -75,6 +75,14 @@ int main()
        goto exit;
     }
 
+    if (CUE_SUCCESS != create_deadline_suit()) {
+       goto exit;
+    }
+
+    if (CUE_SUCCESS != create_observe_suit()) {
+       goto exit;
+    }
+
    CU_basic_set_mode(CU_BRM_VERBOSE);
    CU_basic_run_tests();
 exit:
@@ -30,6 +30,8 @@ static void test_uri_decode(void)
     multi_option_t oID = { .next = &iID, .is_static = 1, .len = 4, .data = (uint8_t *) "9050" };
     multi_option_t location = { .next = NULL, .is_static = 1, .len = 4, .data = (uint8_t *) "5a3f" };
     multi_option_t locationDecimal = { .next = NULL, .is_static = 1, .len = 4, .data = (uint8_t *) "5312" };
+    multi_option_t locationLarge = { .next = NULL, .is_static = 1, .len = 10, .data = (uint8_t *) "4000000000" };
+    multi_option_t locationOverflow = { .next = NULL, .is_static = 1, .len = 10, .data = (uint8_t *) "4294967296" };
     multi_option_t reg = { .next = NULL, .is_static = 1, .len = 2, .data = (uint8_t *) "rd" };
     multi_option_t boot = { .next = NULL, .is_static = 1, .len = 2, .data = (uint8_t *) "bs" };
 
@@ -52,8 +54,26 @@ static void test_uri_decode(void)
     reg.next = &locationDecimal;
     uri = uri_decode(NULL, &reg);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
-    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION | LWM2M_URI_FLAG_OBJECT_ID);
-    CU_ASSERT_EQUAL(uri->objectId, 5312);
+    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION | LWM2M_URI_FLAG_REGISTRATION_ID);
+    CU_ASSERT_EQUAL(uri->registrationId, 5312);
+    CU_ASSERT_EQUAL(uri->objectId, 0);
+    CU_ASSERT_EQUAL(uri->instanceId, 0);
+    lwm2m_free(uri);
+
+    /* "/rd/4000000000" */
+    reg.next = &locationLarge;
+    uri = uri_decode(NULL, &reg);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
+    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION | LWM2M_URI_FLAG_REGISTRATION_ID);
+    CU_ASSERT_EQUAL(uri->registrationId, 4000000000u);
+    CU_ASSERT_EQUAL(uri->objectId, 0);
+    CU_ASSERT_EQUAL(uri->instanceId, 0);
+    lwm2m_free(uri);
+
+    /* "/rd/4294967296" */
+    reg.next = &locationOverflow;
+    uri = uri_decode(NULL, &reg);
+    CU_ASSERT_PTR_NULL(uri);
     lwm2m_free(uri);
 
     /* "/bs" */